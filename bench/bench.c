@@ -0,0 +1,160 @@
+/**********************************************************************
+ * Copyright (c) 2015 Jonas Schnelli                                  *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+#if defined HAVE_CONFIG_H
+#include "libbtc-config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+
+#define BENCH_WARMUP_NS  50000000ULL  /* 50ms warmup per benchmark */
+#define BENCH_SAMPLE_NS  10000000ULL  /* target duration of one sample */
+#define BENCH_SAMPLES    101
+
+extern void bench_sha2();
+extern void bench_ripemd160();
+extern void bench_base58();
+extern void bench_bip32();
+extern void bench_ecc();
+extern void bench_tx();
+extern void bench_block();
+extern void bench_utils();
+
+extern void ecc_start();
+extern void ecc_stop();
+
+static const char *bench_filter = NULL;
+
+#ifdef BENCH_COUNT_ALLOCS
+/* heap allocations (malloc, calloc, realloc), counted by linker wrappers.
+ * Atomic, benchmarks like btc_block_parse allocate from worker threads. */
+static uint64_t bench_allocs = 0;
+#define BENCH_COUNT_ALLOC() __atomic_fetch_add(&bench_allocs, 1, __ATOMIC_RELAXED)
+#define BENCH_ALLOCS() __atomic_load_n(&bench_allocs, __ATOMIC_RELAXED)
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    BENCH_COUNT_ALLOC();
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    BENCH_COUNT_ALLOC();
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    BENCH_COUNT_ALLOC();
+    return __real_realloc(ptr, size);
+}
+#endif
+
+static uint64_t bench_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int bench_cmp_double(const void *a, const void *b)
+{
+    double da = *(const double *)a, db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+void bench_fill(uint8_t *buf, size_t len, uint64_t seed)
+{
+    /* xorshift64*, good enough for reproducible input data */
+    uint64_t x = seed ? seed : 0x9e3779b97f4a7c15ULL;
+    size_t i;
+    for (i = 0; i < len; i++) {
+        x ^= x >> 12;
+        x ^= x << 25;
+        x ^= x >> 27;
+        buf[i] = (uint8_t)((x * 0x2545f4914f6cdd1dULL) >> 56);
+    }
+}
+
+void bench_run(const char *name, bench_fn fn, void *data, size_t bytes_per_op)
+{
+    double samples[BENCH_SAMPLES];
+    uint64_t iters = 1, done = 0, start, elapsed;
+    unsigned int i;
+
+    if (bench_filter && !strstr(name, bench_filter))
+        return;
+
+    /* warmup, doubling the batch size to calibrate the sample length */
+    start = bench_time_ns();
+    do {
+        fn(data, iters);
+        done += iters;
+        elapsed = bench_time_ns() - start;
+        if (elapsed < BENCH_WARMUP_NS / 2)
+            iters *= 2;
+    } while (elapsed < BENCH_WARMUP_NS);
+
+    iters = (uint64_t)((double)BENCH_SAMPLE_NS * done / elapsed);
+    if (iters == 0)
+        iters = 1;
+
+#ifdef BENCH_COUNT_ALLOCS
+    uint64_t allocs = BENCH_ALLOCS();
+#endif
+    for (i = 0; i < BENCH_SAMPLES; i++) {
+        start = bench_time_ns();
+        fn(data, iters);
+        samples[i] = (double)(bench_time_ns() - start) / iters;
+    }
+    qsort(samples, BENCH_SAMPLES, sizeof(samples[0]), bench_cmp_double);
+
+    double median = samples[BENCH_SAMPLES / 2];
+    double p99 = samples[(BENCH_SAMPLES * 99 + 99) / 100 - 1];
+
+    printf("%-32s %12.1f %12.1f %14.0f", name, median, p99, 1e9 / median);
+    if (bytes_per_op)
+        printf(" %12.2f", bytes_per_op * 1e9 / median / (1024.0 * 1024.0));
+    else
+        printf(" %12s", "-");
+#ifdef BENCH_COUNT_ALLOCS
+    printf(" %10.1f\n", (double)(BENCH_ALLOCS() - allocs) / ((double)iters * BENCH_SAMPLES));
+#else
+    printf(" %10s\n", "-");
+#endif
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        bench_filter = argv[1];
+
+    ecc_start();
+
+    printf("%-32s %12s %12s %14s %12s %10s\n", "benchmark", "ns/op(med)", "ns/op(p99)", "ops/s", "MiB/s", "allocs/op");
+
+    bench_sha2();
+    bench_ripemd160();
+    bench_base58();
+    bench_bip32();
+    bench_ecc();
+    bench_tx();
+    bench_block();
+    bench_utils();
+
+    ecc_stop();
+    return 0;
+}
@@ -0,0 +1,23 @@
+/**********************************************************************
+ * Copyright (c) 2015 Jonas Schnelli                                  *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+#ifndef __LIBBTC_BENCH_H__
+#define __LIBBTC_BENCH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+//!benchmark body, must perform exactly iters operations
+typedef void (*bench_fn)(void *data, uint64_t iters);
+
+//!warm up, sample and report ns/op, ops/s, bytes/s (if bytes_per_op > 0) and
+//!heap allocations per op (if the linker supports wrapping malloc)
+void bench_run(const char *name, bench_fn fn, void *data, size_t bytes_per_op);
+
+//!fill a buffer with deterministic pseudo random bytes derived from seed
+void bench_fill(uint8_t *buf, size_t len, uint64_t seed);
+
+#endif //__LIBBTC_BENCH_H__
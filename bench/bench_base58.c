@@ -0,0 +1,121 @@
+/**********************************************************************
+ * Copyright (c) 2015 Jonas Schnelli                                  *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include <btc/base58.h>
+
+#include "bench.h"
+
+struct bench_base58_data
+{
+    uint8_t payload[78];
+    int len;
+    char str[128];
+};
+
+static void bench_base58_encode(void *data, uint64_t iters)
+{
+    struct bench_base58_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        base58_encode_check(d->payload, d->len, d->str, sizeof(d->str));
+}
+
+static void bench_base58_decode(void *data, uint64_t iters)
+{
+    struct bench_base58_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        base58_decode_check(d->str, d->payload, d->len);
+}
+
+/* 256 addresses per op, one call each vs. the batch functions */
+#define BENCH_B58_N 256
+
+struct bench_base58_many_data
+{
+    uint8_t payload[BENCH_B58_N][21];
+    char str[BENCH_B58_N][40];
+    const uint8_t *payloads[BENCH_B58_N];
+    uint8_t *outs[BENCH_B58_N];
+    char *strs[BENCH_B58_N];
+    const char *cstrs[BENCH_B58_N];
+    int lens[BENCH_B58_N];
+    int results[BENCH_B58_N];
+};
+
+static void bench_base58_encode_loop(void *data, uint64_t iters)
+{
+    struct bench_base58_many_data *d = data;
+    uint64_t i;
+    int k;
+    for (i = 0; i < iters; i++)
+        for (k = 0; k < BENCH_B58_N; k++)
+            base58_encode_check(d->payload[k], 21, d->str[k], sizeof(d->str[k]));
+}
+
+static void bench_base58_encode_many(void *data, uint64_t iters)
+{
+    struct bench_base58_many_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        base58_encode_check_many(d->payloads, d->lens, BENCH_B58_N, d->strs, sizeof(d->str[0]), d->results);
+}
+
+static void bench_base58_decode_loop(void *data, uint64_t iters)
+{
+    struct bench_base58_many_data *d = data;
+    uint64_t i;
+    int k;
+    for (i = 0; i < iters; i++)
+        for (k = 0; k < BENCH_B58_N; k++)
+            base58_decode_check(d->str[k], d->payload[k], 21);
+}
+
+static void bench_base58_decode_many(void *data, uint64_t iters)
+{
+    struct bench_base58_many_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        base58_decode_check_many(d->cstrs, d->outs, d->lens, BENCH_B58_N, d->results);
+}
+
+void bench_base58()
+{
+    struct bench_base58_data d;
+    bench_fill(d.payload, sizeof(d.payload), 4);
+
+    /* version byte + hash160 (addresses) */
+    d.len = 21;
+    d.payload[0] = 0;
+    bench_run("base58_encode_check/21", bench_base58_encode, &d, d.len);
+    base58_encode_check(d.payload, d.len, d.str, sizeof(d.str));
+    bench_run("base58_decode_check/21", bench_base58_decode, &d, d.len);
+
+    /* serialized extended keys */
+    d.len = 78;
+    bench_run("base58_encode_check/78", bench_base58_encode, &d, d.len);
+    base58_encode_check(d.payload, d.len, d.str, sizeof(d.str));
+    bench_run("base58_decode_check/78", bench_base58_decode, &d, d.len);
+
+    static struct bench_base58_many_data m;
+    int k;
+    bench_fill(m.payload[0], sizeof(m.payload), 5);
+    for (k = 0; k < BENCH_B58_N; k++) {
+        m.payload[k][0] = 0;
+        m.payloads[k] = m.payload[k];
+        m.outs[k] = m.payload[k];
+        m.strs[k] = m.str[k];
+        m.cstrs[k] = m.str[k];
+        m.lens[k] = 21;
+    }
+    bench_run("base58_encode_check_loop/256x21", bench_base58_encode_loop, &m, BENCH_B58_N * 21);
+    bench_run("base58_encode_check_many/256x21", bench_base58_encode_many, &m, BENCH_B58_N * 21);
+    bench_run("base58_decode_check_loop/256x21", bench_base58_decode_loop, &m, BENCH_B58_N * 21);
+    bench_run("base58_decode_check_many/256x21", bench_base58_decode_many, &m, BENCH_B58_N * 21);
+}
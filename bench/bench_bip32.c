@@ -0,0 +1,74 @@
+/**********************************************************************
+ * Copyright (c) 2015 Jonas Schnelli                                  *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include <btc/bip32.h>
+
+#include "bench.h"
+
+#define BENCH_BIP32_BATCH 64
+
+struct bench_bip32_data
+{
+    HDNode parent;
+    HDNode child;
+    HDNode children[BENCH_BIP32_BATCH];
+    uint32_t indexes[BENCH_BIP32_BATCH];
+};
+
+static void bench_hdnode_private_ckd(void *data, uint64_t iters)
+{
+    struct bench_bip32_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++) {
+        memcpy(&d->child, &d->parent, sizeof(HDNode));
+        hdnode_private_ckd(&d->child, (uint32_t)i & 0x7fffffff);
+    }
+}
+
+static void bench_hdnode_public_ckd(void *data, uint64_t iters)
+{
+    struct bench_bip32_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++) {
+        memcpy(&d->child, &d->parent, sizeof(HDNode));
+        hdnode_public_ckd(&d->child, (uint32_t)i & 0x7fffffff);
+    }
+}
+
+static void bench_hdnode_private_ckd_many(void *data, uint64_t iters)
+{
+    struct bench_bip32_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        hdnode_private_ckd_many(&d->parent, d->indexes, BENCH_BIP32_BATCH, d->children);
+}
+
+static void bench_hdnode_public_ckd_many(void *data, uint64_t iters)
+{
+    struct bench_bip32_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        hdnode_public_ckd_many(&d->parent, d->indexes, BENCH_BIP32_BATCH, d->children);
+}
+
+void bench_bip32()
+{
+    struct bench_bip32_data d;
+    uint8_t seed[32];
+    uint32_t i;
+    bench_fill(seed, sizeof(seed), 5);
+    hdnode_from_seed(seed, sizeof(seed), &d.parent);
+    for (i = 0; i < BENCH_BIP32_BATCH; i++)
+        d.indexes[i] = i;
+
+    bench_run("hdnode_private_ckd", bench_hdnode_private_ckd, &d, 0);
+    bench_run("hdnode_public_ckd", bench_hdnode_public_ckd, &d, 0);
+    bench_run("hdnode_private_ckd_many/64", bench_hdnode_private_ckd_many, &d, 0);
+    bench_run("hdnode_public_ckd_many/64", bench_hdnode_public_ckd_many, &d, 0);
+}
@@ -0,0 +1,121 @@
+/**********************************************************************
+ * Copyright (c) 2015 Jonas Schnelli                                  *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <btc/block.h>
+#include <btc/blockfile.h>
+
+#include "bench.h"
+#include "sha2.h"
+
+#define BENCH_MERKLE_LEAVES 2000 /* roughly a full block */
+#define BENCH_BLOCKFILE_BLOCKS 2000
+#define BENCH_BLOCKFILE_BLOCK_SIZE 1024
+
+struct bench_block_data
+{
+    uint256 leaves[BENCH_MERKLE_LEAVES];
+    uint256 nodes[BENCH_MERKLE_LEAVES + 1];
+    uint256 root;
+};
+
+/* merkle root using sha256_Raw on each concatenated pair */
+static void bench_merkle_root_raw(void *data, uint64_t iters)
+{
+    struct bench_block_data *d = data;
+    uint8_t pair[64];
+    uint64_t it;
+    size_t i, n;
+    for (it = 0; it < iters; it++) {
+        memcpy(d->nodes, d->leaves, sizeof(d->leaves));
+        for (n = BENCH_MERKLE_LEAVES; n > 1; n = (n + 1) / 2) {
+            for (i = 0; i < n; i += 2) {
+                memcpy(pair, d->nodes[i], 32);
+                memcpy(pair + 32, d->nodes[i + 1 < n ? i + 1 : i], 32);
+                sha256_Raw(pair, 64, d->nodes[i / 2]);
+                sha256_Raw(d->nodes[i / 2], 32, d->nodes[i / 2]);
+            }
+        }
+        memcpy(d->root, d->nodes[0], 32);
+    }
+}
+
+static void bench_merkle_root(void *data, uint64_t iters)
+{
+    struct bench_block_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        btc_merkle_root((const uint256 *)d->leaves, BENCH_MERKLE_LEAVES, d->root, NULL);
+}
+
+/* open, walk all records and close a block file */
+static void bench_blockfile_scan(void *data, uint64_t iters)
+{
+    const char *path = data;
+    const uint8_t *block;
+    size_t len;
+    uint64_t i;
+    for (i = 0; i < iters; i++) {
+        btc_blockfile *file = btc_blockfile_open(path, BTC_BLOCKFILE_MAGIC_MAIN);
+        while (btc_blockfile_next(file, &block, &len, NULL))
+            ;
+        btc_blockfile_close(file);
+    }
+}
+
+/* a synthetic blk file in the page cache */
+static void bench_blockfile(void)
+{
+    char path[] = "/tmp/libbtc_bench_blkXXXXXX";
+    uint8_t record[8 + BENCH_BLOCKFILE_BLOCK_SIZE];
+    int fd = mkstemp(path);
+    int i;
+
+    if (fd < 0)
+        return;
+    bench_fill(record, sizeof(record), 3);
+    record[0] = 0xf9;
+    record[1] = 0xbe;
+    record[2] = 0xb4;
+    record[3] = 0xd9;
+    record[4] = BENCH_BLOCKFILE_BLOCK_SIZE & 0xff;
+    record[5] = BENCH_BLOCKFILE_BLOCK_SIZE >> 8;
+    record[6] = record[7] = 0;
+    for (i = 0; i < BENCH_BLOCKFILE_BLOCKS; i++)
+        if (write(fd, record, sizeof(record)) != (ssize_t)sizeof(record))
+            break;
+    close(fd);
+    if (i == BENCH_BLOCKFILE_BLOCKS)
+        bench_run("btc_blockfile_scan/2000x1k", bench_blockfile_scan, path, BENCH_BLOCKFILE_BLOCKS * sizeof(record));
+    unlink(path);
+}
+
+void bench_block()
+{
+    struct bench_block_data *d = malloc(sizeof(*d));
+    uint32_t features = sha2_get_features();
+
+    bench_fill((uint8_t *)d->leaves, sizeof(d->leaves), 7);
+    bench_run("merkle_root_Raw/2000", bench_merkle_root_raw, d, 0);
+    bench_run("btc_merkle_root/2000", bench_merkle_root, d, 0);
+
+    /* multi-lane vector code, used when SHA-NI is not available */
+    if (sha2_set_features(features & ~SHA2_CPU_SHANI) != features) {
+        bench_run("btc_merkle_root/2000 (no SHA-NI)", bench_merkle_root, d, 0);
+        sha2_set_features(features);
+    }
+    sha2_set_features(0);
+    bench_run("merkle_root_Raw/2000 (portable)", bench_merkle_root_raw, d, 0);
+    sha2_set_features(features);
+    free(d);
+
+    bench_blockfile();
+}
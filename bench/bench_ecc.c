@@ -0,0 +1,54 @@
+/**********************************************************************
+ * Copyright (c) 2015 Jonas Schnelli                                  *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include <btc/ecc.h>
+
+#include "bench.h"
+
+struct bench_ecc_data
+{
+    uint8_t privkey[32];
+    uint8_t pubkey[33];
+    uint8_t hash[32];
+    unsigned char sig[74];
+    size_t siglen;
+};
+
+static void bench_ecc_sign(void *data, uint64_t iters)
+{
+    struct bench_ecc_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++) {
+        d->siglen = sizeof(d->sig);
+        ecc_sign(d->privkey, d->hash, d->sig, &d->siglen);
+    }
+}
+
+static void bench_ecc_verify_sig(void *data, uint64_t iters)
+{
+    struct bench_ecc_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        ecc_verify_sig(d->pubkey, 1, d->hash, d->sig, d->siglen);
+}
+
+void bench_ecc()
+{
+    struct bench_ecc_data d;
+    uint64_t seed = 6;
+    do {
+        bench_fill(d.privkey, sizeof(d.privkey), seed++);
+    } while (!ecc_verify_privatekey(d.privkey));
+    ecc_get_public_key33(d.privkey, d.pubkey);
+    bench_fill(d.hash, sizeof(d.hash), 7);
+
+    bench_run("ecc_sign", bench_ecc_sign, &d, 0);
+    bench_ecc_sign(&d, 1);
+    bench_run("ecc_verify_sig", bench_ecc_verify_sig, &d, 0);
+}
@@ -0,0 +1,85 @@
+/**********************************************************************
+ * Copyright (c) 2015 Jonas Schnelli                                  *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "bench.h"
+#include "ripemd160.h"
+#include "sha2.h"
+
+struct bench_ripemd160_data
+{
+    uint8_t msg[1024];
+    uint32_t len;
+    uint8_t out[20];
+};
+
+static void bench_ripemd160_raw(void *data, uint64_t iters)
+{
+    struct bench_ripemd160_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        ripemd160(d->msg, d->len, d->out);
+}
+
+/* hash160 of a compressed pubkey: sha256_Raw + ripemd160 vs. btc_hash160 */
+static void bench_hash160_two_calls(void *data, uint64_t iters)
+{
+    struct bench_ripemd160_data *d = data;
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    uint64_t i;
+    for (i = 0; i < iters; i++) {
+        sha256_Raw(d->msg, d->len, digest);
+        ripemd160(digest, SHA256_DIGEST_LENGTH, d->out);
+    }
+}
+
+static void bench_hash160(void *data, uint64_t iters)
+{
+    struct bench_ripemd160_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        btc_hash160(d->msg, d->len, d->out);
+}
+
+/* hash160 of 16 compressed pubkeys, one by one vs. btc_hash160_many */
+static void bench_hash160_loop(void *data, uint64_t iters)
+{
+    struct bench_ripemd160_data *d = data;
+    const uint8_t (*keys)[33] = (const uint8_t (*)[33])d->msg;
+    uint64_t i;
+    int k;
+    for (i = 0; i < iters; i++)
+        for (k = 0; k < 16; k++)
+            btc_hash160(keys[k], 33, d->out);
+}
+
+static void bench_hash160_many(void *data, uint64_t iters)
+{
+    struct bench_ripemd160_data *d = data;
+    uint8_t out[16][RIPEMD160_DIGEST_LENGTH];
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        btc_hash160_many((const uint8_t (*)[33])d->msg, 16, out);
+    memcpy(d->out, out[15], sizeof(d->out));
+}
+
+void bench_ripemd160()
+{
+    struct bench_ripemd160_data d;
+    bench_fill(d.msg, sizeof(d.msg), 3);
+
+    d.len = 32;
+    bench_run("ripemd160/32", bench_ripemd160_raw, &d, d.len);
+    d.len = 1024;
+    bench_run("ripemd160/1024", bench_ripemd160_raw, &d, d.len);
+    d.len = 33;
+    bench_run("hash160_two_calls/33", bench_hash160_two_calls, &d, d.len);
+    bench_run("btc_hash160/33", bench_hash160, &d, d.len);
+    bench_run("btc_hash160_loop/16x33", bench_hash160_loop, &d, 16 * 33);
+    bench_run("btc_hash160_many/16x33", bench_hash160_many, &d, 16 * 33);
+}
@@ -0,0 +1,170 @@
+/**********************************************************************
+ * Copyright (c) 2015 Jonas Schnelli                                  *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "bench.h"
+#include "sha2.h"
+
+struct bench_sha2_data
+{
+    uint8_t msg[1024];
+    size_t len;
+    uint8_t key[32];
+    uint8_t out[SHA512_DIGEST_LENGTH];
+};
+
+static void bench_sha256_raw(void *data, uint64_t iters)
+{
+    struct bench_sha2_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        sha256_Raw(d->msg, d->len, d->out);
+}
+
+/* 8 x 64 byte messages, the AVX2 group size */
+static void bench_sha256_raw_many(void *data, uint64_t iters)
+{
+    struct bench_sha2_data *d = data;
+    const uint8_t *msgs[8];
+    size_t lens[8];
+    uint8_t digests[8][SHA256_DIGEST_LENGTH];
+    uint64_t i;
+    int j;
+    for (j = 0; j < 8; j++) {
+        msgs[j] = d->msg + 64 * j;
+        lens[j] = 64;
+    }
+    for (i = 0; i < iters; i++)
+        sha256_Raw_many(msgs, lens, 8, digests);
+    d->out[0] = digests[7][0];
+}
+
+/* 16 merkle nodes (1024 bytes) */
+static void bench_sha256d64_many(void *data, uint64_t iters)
+{
+    struct bench_sha2_data *d = data;
+    uint8_t digests[16 * SHA256_DIGEST_LENGTH];
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        sha256d64_many(d->msg, 16, digests);
+    d->out[0] = digests[0];
+}
+
+static void bench_sha256d64_scalar(void *data, uint64_t iters)
+{
+    struct bench_sha2_data *d = data;
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    uint64_t i;
+    int j;
+    for (i = 0; i < iters; i++) {
+        for (j = 0; j < 16; j++)
+            sha256d64(d->msg + 64 * j, digest);
+    }
+    d->out[0] = digest[0];
+}
+
+/* block header nonce scan: full hash vs. resuming after the first 64 bytes */
+static void bench_sha256_header(void *data, uint64_t iters)
+{
+    struct bench_sha2_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++) {
+        d->msg[76] = (uint8_t)i;
+        sha256_Raw(d->msg, 80, d->out);
+    }
+}
+
+static void bench_sha256_header_midstate(void *data, uint64_t iters)
+{
+    struct bench_sha2_data *d = data;
+    SHA256_CTX ctx;
+    SHA256_MIDSTATE midstate;
+    uint64_t i;
+
+    sha256_Init(&ctx);
+    sha256_Update(&ctx, d->msg, 64);
+    sha256_GetMidstate(&ctx, &midstate);
+    for (i = 0; i < iters; i++) {
+        d->msg[76] = (uint8_t)i;
+        sha256_SetMidstate(&ctx, &midstate);
+        sha256_Update(&ctx, d->msg + 64, 16);
+        sha256_Final(d->out, &ctx);
+    }
+}
+
+static void bench_sha512_raw(void *data, uint64_t iters)
+{
+    struct bench_sha2_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        sha512_Raw(d->msg, d->len, d->out);
+}
+
+static void bench_hmac_sha512(void *data, uint64_t iters)
+{
+    struct bench_sha2_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        hmac_sha512(d->key, sizeof(d->key), d->msg, d->len, d->out);
+}
+
+static void bench_hmac_sha512_ctx(void *data, uint64_t iters)
+{
+    struct bench_sha2_data *d = data;
+    HMAC_SHA512_CTX hctx;
+    uint64_t i;
+    hmac_sha512_Init(&hctx, d->key, sizeof(d->key));
+    for (i = 0; i < iters; i++)
+        hmac_sha512_Final(&hctx, d->msg, d->len, d->out);
+}
+
+/* 16 bip32 sized messages with one key */
+static void bench_hmac_sha512_many(void *data, uint64_t iters)
+{
+    struct bench_sha2_data *d = data;
+    HMAC_SHA512_CTX hctx;
+    const uint8_t *msgs[16];
+    uint32_t lens[16];
+    uint8_t hmacs[16][SHA512_DIGEST_LENGTH];
+    uint64_t i;
+    int j;
+    for (j = 0; j < 16; j++) {
+        msgs[j] = d->msg + 37 * j;
+        lens[j] = 37;
+    }
+    hmac_sha512_Init(&hctx, d->key, sizeof(d->key));
+    for (i = 0; i < iters; i++)
+        hmac_sha512_Final_many(&hctx, msgs, lens, 16, hmacs);
+    d->out[0] = hmacs[15][0];
+}
+
+void bench_sha2()
+{
+    struct bench_sha2_data d;
+    bench_fill(d.msg, sizeof(d.msg), 1);
+    bench_fill(d.key, sizeof(d.key), 2);
+
+    d.len = 32;
+    bench_run("sha256_Raw/32", bench_sha256_raw, &d, d.len);
+    d.len = 64;
+    bench_run("sha256_Raw/64", bench_sha256_raw, &d, d.len);
+    d.len = 1024;
+    bench_run("sha256_Raw/1024", bench_sha256_raw, &d, d.len);
+    bench_run("sha256_header/80", bench_sha256_header, &d, 80);
+    bench_run("sha256_header_midstate/80", bench_sha256_header_midstate, &d, 80);
+    bench_run("sha256_Raw_many/8x64", bench_sha256_raw_many, &d, 8 * 64);
+    bench_run("sha256d64/16x64", bench_sha256d64_scalar, &d, 16 * 64);
+    bench_run("sha256d64_many/16x64", bench_sha256d64_many, &d, 16 * 64);
+    bench_run("sha512_Raw/1024", bench_sha512_raw, &d, d.len);
+
+    /* bip32 child derivation message: 33 byte pubkey + 4 byte index */
+    d.len = 37;
+    bench_run("hmac_sha512/37", bench_hmac_sha512, &d, d.len);
+    bench_run("hmac_sha512_ctx/37", bench_hmac_sha512_ctx, &d, d.len);
+    bench_run("hmac_sha512_many/16x37", bench_hmac_sha512_many, &d, 16 * 37);
+}
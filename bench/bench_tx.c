@@ -0,0 +1,354 @@
+/**********************************************************************
+ * Copyright (c) 2015 Jonas Schnelli                                  *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <btc/arena.h>
+#include <btc/block.h>
+#include <btc/tx.h>
+#include <btc/txstore.h>
+
+#include "bench.h"
+#include "cstr.h"
+#include "script.h"
+#include "utils.h"
+
+/* two P2PKH inputs, one P2PKH output (taken from the tx_tests vectors) */
+static const char bench_tx_hex[] = "01000000023d6cf972d4dff9c519eff407ea800361dd0a121de1da8b6f4138a2f25de864b4000000008a4730440220ffda47bfc776bcd269da4832626ac332adfca6dd835e8ecd83cd1ebe7d709b0e022049cffa1cdc102a0b56e0e04913606c70af702a1149dc3b305ab9439288fee090014104266abb36d66eb4218a6dd31f09bb92cf3cfa803c7ea72c1fc80a50f919273e613f895b855fb7465ccbc8919ad1bd4a306c783f22cd3227327694c4fa4c1c439affffffff21ebc9ba20594737864352e95b727f1a565756f9d365083eb1a8596ec98c97b7010000008a4730440220503ff10e9f1e0de731407a4a245531c9ff17676eda461f8ceeb8c06049fa2c810220c008ac34694510298fa60b3f000df01caa244f165b727d4896eb84f81e46bcc4014104266abb36d66eb4218a6dd31f09bb92cf3cfa803c7ea72c1fc80a50f919273e613f895b855fb7465ccbc8919ad1bd4a306c783f22cd3227327694c4fa4c1c439affffffff01f0da5200000000001976a914857ccd42dded6df32949d4646dfa10a92458cfaa88ac00000000";
+static const char bench_tx_script_hex[] = "76a914bef80ecf3a44500fda1bc92176e442891662aed288ac";
+
+/* transactions in the "block" benchmarks */
+#define BENCH_TX_BLOCK_TXS 2000
+/* inputs of the consolidation sighash benchmark */
+#define BENCH_TX_CONSOLIDATION_INS 500
+/* value range of the scan benchmarks, no output of the block falls in it */
+#define BENCH_TX_SCAN_MIN 100000000LL
+#define BENCH_TX_SCAN_MAX 200000000LL
+
+struct bench_tx_data
+{
+    uint8_t raw[sizeof(bench_tx_hex) / 2];
+    int rawlen;
+    btc_tx *tx;
+    btc_tx *consolidation;
+    cstring *script;
+    uint8_t hash[32];
+    uint8_t *block;
+    size_t blocklen;
+    uint8_t *fullblock; /* header, tx count and block */
+    size_t fullblocklen;
+    unsigned int threads;
+    btc_arena *arena;
+    btc_tx **blocktxs; /* the block decoded */
+    btc_txstore store; /* the block in columns */
+    size_t found;
+};
+
+static void bench_tx_deserialize(void *data, uint64_t iters)
+{
+    struct bench_tx_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++) {
+        btc_tx *tx = btc_tx_new();
+        btc_tx_deserialize(d->raw, d->rawlen, tx);
+        btc_tx_free(tx);
+    }
+}
+
+static void bench_tx_deserialize_arena(void *data, uint64_t iters)
+{
+    struct bench_tx_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++) {
+        btc_tx_deserialize_arena(d->raw, d->rawlen, d->arena, NULL);
+        btc_arena_reset(d->arena);
+    }
+}
+
+/* parse BENCH_TX_BLOCK_TXS concatenated transactions, then release them */
+static void bench_tx_deserialize_block(void *data, uint64_t iters)
+{
+    struct bench_tx_data *d = data;
+    btc_tx *txs[BENCH_TX_BLOCK_TXS];
+    uint64_t i;
+    int k;
+    for (i = 0; i < iters; i++) {
+        for (k = 0; k < BENCH_TX_BLOCK_TXS; k++) {
+            txs[k] = btc_tx_new();
+            btc_tx_deserialize(d->block + k * d->rawlen, d->rawlen, txs[k]);
+        }
+        for (k = 0; k < BENCH_TX_BLOCK_TXS; k++)
+            btc_tx_free(txs[k]);
+    }
+}
+
+static void bench_tx_deserialize_block_arena(void *data, uint64_t iters)
+{
+    struct bench_tx_data *d = data;
+    size_t pos, consumed;
+    uint64_t i;
+    for (i = 0; i < iters; i++) {
+        for (pos = 0; pos < d->blocklen; pos += consumed)
+            btc_tx_deserialize_arena(d->block + pos, d->blocklen - pos, d->arena, &consumed);
+        btc_arena_reset(d->arena);
+    }
+}
+
+static void bench_tx_view_block(void *data, uint64_t iters)
+{
+    struct bench_tx_data *d = data;
+    btc_tx_view view;
+    size_t pos;
+    uint64_t i;
+    for (i = 0; i < iters; i++) {
+        for (pos = 0; pos < d->blocklen; pos += view.size)
+            btc_tx_view_parse(&view, d->block + pos, d->blocklen - pos, d->arena);
+        btc_arena_reset(d->arena);
+    }
+}
+
+static void bench_tx_serialize(void *data, uint64_t iters)
+{
+    struct bench_tx_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++) {
+        cstring *s = cstr_new_sz(0);
+        btc_tx_serialize(s, d->tx);
+        cstr_free(s, true);
+    }
+}
+
+/* serialize into a caller buffer, no allocation */
+static void bench_tx_serialize_buf(void *data, uint64_t iters)
+{
+    struct bench_tx_data *d = data;
+    uint8_t buf[sizeof(bench_tx_hex) / 2];
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        btc_tx_serialize_buf(d->tx, buf, sizeof(buf));
+}
+
+static void bench_tx_vsize(void *data, uint64_t iters)
+{
+    struct bench_tx_data *d = data;
+    volatile size_t vsize;
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        vsize = btc_tx_vsize(d->tx);
+    (void)vsize;
+}
+
+static void bench_tx_hash(void *data, uint64_t iters)
+{
+    struct bench_tx_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++) {
+        btc_tx_hash_invalidate(d->tx);
+        btc_tx_hash(d->tx, d->hash);
+    }
+}
+
+/* repeated lookups return the memoised hash */
+static void bench_tx_hash_cached(void *data, uint64_t iters)
+{
+    struct bench_tx_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        btc_tx_hash(d->tx, d->hash);
+}
+
+static void bench_tx_sighash(void *data, uint64_t iters)
+{
+    struct bench_tx_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        btc_tx_sighash(d->tx, d->script, 0, SIGHASH_ALL, d->hash);
+}
+
+/* sign every input of a BENCH_TX_CONSOLIDATION_INS input transaction */
+static void bench_tx_sighash_consolidation(void *data, uint64_t iters)
+{
+    struct bench_tx_data *d = data;
+    uint64_t i;
+    unsigned int k;
+    for (i = 0; i < iters; i++)
+        for (k = 0; k < BENCH_TX_CONSOLIDATION_INS; k++)
+            btc_tx_sighash(d->consolidation, d->script, k, SIGHASH_ALL, d->hash);
+}
+
+static void bench_tx_sighash_cached_consolidation(void *data, uint64_t iters)
+{
+    struct bench_tx_data *d = data;
+    uint64_t i;
+    unsigned int k;
+    for (i = 0; i < iters; i++) {
+        btc_tx_sighash_cache *cache = btc_tx_sighash_cache_new(d->consolidation);
+        for (k = 0; k < BENCH_TX_CONSOLIDATION_INS; k++)
+            btc_tx_sighash_cached(cache, d->script, k, SIGHASH_ALL, d->hash);
+        btc_tx_sighash_cache_free(cache);
+    }
+}
+
+static void bench_tx_sighash_v0_consolidation(void *data, uint64_t iters)
+{
+    struct bench_tx_data *d = data;
+    uint64_t i;
+    unsigned int k;
+    for (i = 0; i < iters; i++)
+        for (k = 0; k < BENCH_TX_CONSOLIDATION_INS; k++)
+            btc_tx_sighash_witness_v0(d->consolidation, d->script, k, SIGHASH_ALL, 5000, d->hash);
+}
+
+static void bench_tx_sighash_v0_cached_consolidation(void *data, uint64_t iters)
+{
+    struct bench_tx_data *d = data;
+    uint64_t i;
+    unsigned int k;
+    for (i = 0; i < iters; i++) {
+        btc_tx_sighash_cache *cache = btc_tx_sighash_cache_new(d->consolidation);
+        for (k = 0; k < BENCH_TX_CONSOLIDATION_INS; k++)
+            btc_tx_sighash_witness_v0_cached(cache, d->script, k, SIGHASH_ALL, 5000, d->hash);
+        btc_tx_sighash_cache_free(cache);
+    }
+}
+
+static void bench_block_parse(void *data, uint64_t iters)
+{
+    struct bench_tx_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        btc_block_free(btc_block_parse(d->fullblock, d->fullblocklen, d->threads));
+}
+
+static void bench_txstore_append(void *data, uint64_t iters)
+{
+    struct bench_tx_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++) {
+        btc_txstore_clear(&d->store);
+        btc_txstore_append(&d->store, d->block, d->blocklen, BENCH_TX_BLOCK_TXS);
+    }
+}
+
+/* outputs with a value in [BENCH_TX_SCAN_MIN, BENCH_TX_SCAN_MAX], through the decoded
+ * transactions or the value column */
+static void bench_scan_value_tx(void *data, uint64_t iters)
+{
+    struct bench_tx_data *d = data;
+    uint64_t i;
+    size_t k, n;
+    for (i = 0; i < iters; i++) {
+        size_t found = 0;
+        for (k = 0; k < BENCH_TX_BLOCK_TXS; k++) {
+            vector *vout = d->blocktxs[k]->vout;
+            for (n = 0; n < vout->len; n++) {
+                int64_t value = ((btc_tx_out *)vector_idx(vout, n))->value;
+                if (value >= BENCH_TX_SCAN_MIN && value <= BENCH_TX_SCAN_MAX)
+                    found++;
+            }
+        }
+        d->found = found;
+    }
+}
+
+static void bench_scan_value_txstore(void *data, uint64_t iters)
+{
+    struct bench_tx_data *d = data;
+    const btc_txstore *store = &d->store;
+    uint64_t i;
+    size_t n;
+    for (i = 0; i < iters; i++) {
+        size_t found = 0;
+        for (n = btc_txstore_next_value(store, BENCH_TX_SCAN_MIN, BENCH_TX_SCAN_MAX, 0); n < store->vout_count;
+             n = btc_txstore_next_value(store, BENCH_TX_SCAN_MIN, BENCH_TX_SCAN_MAX, n + 1))
+            found++;
+        d->found = found;
+    }
+}
+
+void bench_tx()
+{
+    struct bench_tx_data d;
+    uint8_t script[sizeof(bench_tx_script_hex) / 2];
+    int outlen;
+
+    utils_hex_to_bin(bench_tx_hex, d.raw, strlen(bench_tx_hex), &d.rawlen);
+    utils_hex_to_bin(bench_tx_script_hex, script, strlen(bench_tx_script_hex), &outlen);
+    d.script = cstr_new_buf(script, outlen);
+    d.tx = btc_tx_new();
+    btc_tx_deserialize(d.raw, d.rawlen, d.tx);
+
+    d.blocklen = (size_t)d.rawlen * BENCH_TX_BLOCK_TXS;
+    d.block = malloc(d.blocklen);
+    for (outlen = 0; outlen < BENCH_TX_BLOCK_TXS; outlen++)
+        memcpy(d.block + (size_t)outlen * d.rawlen, d.raw, d.rawlen);
+    d.arena = btc_arena_new(0);
+    btc_txstore_init(&d.store);
+
+    d.fullblocklen = BTC_BLOCK_HEADER_SIZE + 3 + d.blocklen;
+    d.fullblock = calloc(1, d.fullblocklen);
+    d.fullblock[BTC_BLOCK_HEADER_SIZE] = 253;
+    d.fullblock[BTC_BLOCK_HEADER_SIZE + 1] = BENCH_TX_BLOCK_TXS & 0xff;
+    d.fullblock[BTC_BLOCK_HEADER_SIZE + 2] = BENCH_TX_BLOCK_TXS >> 8;
+    memcpy(d.fullblock + BTC_BLOCK_HEADER_SIZE + 3, d.block, d.blocklen);
+
+    d.consolidation = btc_tx_new();
+    for (outlen = 0; outlen < BENCH_TX_CONSOLIDATION_INS; outlen++) {
+        btc_tx_in *tx_in = btc_tx_in_new();
+        btc_tx_in_copy(tx_in, vector_idx(d.tx->vin, 0));
+        tx_in->prevout.n = outlen;
+        vector_add(d.consolidation->vin, tx_in);
+    }
+    btc_tx_out *tx_out = btc_tx_out_new();
+    tx_out->value = 5000;
+    tx_out->script_pubkey = cstr_new_buf(d.script->str, d.script->len);
+    vector_add(d.consolidation->vout, tx_out);
+
+    bench_run("btc_tx_deserialize", bench_tx_deserialize, &d, d.rawlen);
+    bench_run("btc_tx_deserialize_arena", bench_tx_deserialize_arena, &d, d.rawlen);
+    bench_run("btc_tx_deser/block2000", bench_tx_deserialize_block, &d, d.blocklen);
+    bench_run("btc_tx_deser_arena/block2000", bench_tx_deserialize_block_arena, &d, d.blocklen);
+    bench_run("btc_tx_view/block2000", bench_tx_view_block, &d, d.blocklen);
+    d.threads = 1;
+    bench_run("btc_block_parse/2000 1 thread", bench_block_parse, &d, d.fullblocklen);
+    d.threads = 0;
+    bench_run("btc_block_parse/2000 all cpus", bench_block_parse, &d, d.fullblocklen);
+    bench_run("btc_txstore_append/block2000", bench_txstore_append, &d, d.blocklen);
+
+    d.blocktxs = malloc(BENCH_TX_BLOCK_TXS * sizeof(btc_tx *));
+    for (outlen = 0; outlen < BENCH_TX_BLOCK_TXS; outlen++) {
+        d.blocktxs[outlen] = btc_tx_new();
+        btc_tx_deserialize(d.raw, d.rawlen, d.blocktxs[outlen]);
+    }
+    btc_txstore_clear(&d.store);
+    btc_txstore_append(&d.store, d.block, d.blocklen, BENCH_TX_BLOCK_TXS);
+    bench_run("scan_value/btc_tx block2000", bench_scan_value_tx, &d, 0);
+    bench_run("scan_value/txstore block2000", bench_scan_value_txstore, &d, 0);
+    for (outlen = 0; outlen < BENCH_TX_BLOCK_TXS; outlen++)
+        btc_tx_free(d.blocktxs[outlen]);
+    free(d.blocktxs);
+
+    bench_run("btc_tx_serialize", bench_tx_serialize, &d, d.rawlen);
+    bench_run("btc_tx_serialize_buf", bench_tx_serialize_buf, &d, d.rawlen);
+    bench_run("btc_tx_vsize", bench_tx_vsize, &d, d.rawlen);
+    bench_run("btc_tx_hash", bench_tx_hash, &d, d.rawlen);
+    bench_run("btc_tx_hash/cached", bench_tx_hash_cached, &d, d.rawlen);
+    bench_run("btc_tx_sighash", bench_tx_sighash, &d, 0);
+    bench_run("btc_tx_sighash/500in_all", bench_tx_sighash_consolidation, &d, 0);
+    bench_run("btc_tx_sighash_cached/500in_all", bench_tx_sighash_cached_consolidation, &d, 0);
+    bench_run("btc_tx_sighash_v0/500in_all", bench_tx_sighash_v0_consolidation, &d, 0);
+    bench_run("btc_tx_sighash_v0/500in_cached", bench_tx_sighash_v0_cached_consolidation, &d, 0);
+
+    btc_tx_free(d.tx);
+    btc_tx_free(d.consolidation);
+    cstr_free(d.script, true);
+    btc_arena_free(d.arena);
+    btc_txstore_free(&d.store);
+    free(d.block);
+    free(d.fullblock);
+}
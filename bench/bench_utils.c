@@ -0,0 +1,62 @@
+/**********************************************************************
+ * Copyright (c) 2015 Jonas Schnelli                                  *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "bench.h"
+#include "utils.h"
+
+struct bench_utils_data
+{
+    uint8_t bin[1024];
+    char hex[2 * 1024 + 1];
+};
+
+static void bench_uint8_to_hex(void *data, uint64_t iters)
+{
+    struct bench_utils_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        utils_uint8_to_hex(d->bin, 1000);
+}
+
+static void bench_hex_encode(void *data, uint64_t iters)
+{
+    struct bench_utils_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        utils_hex_encode(d->bin, sizeof(d->bin), d->hex);
+}
+
+static void bench_hex_to_uint8(void *data, uint64_t iters)
+{
+    struct bench_utils_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        utils_hex_to_uint8(d->hex + 2 * 1024 - 2000);
+}
+
+static void bench_hex_decode(void *data, uint64_t iters)
+{
+    struct bench_utils_data *d = data;
+    uint64_t i;
+    for (i = 0; i < iters; i++)
+        utils_hex_decode(d->hex, 2 * sizeof(d->bin), d->bin);
+}
+
+void bench_utils()
+{
+    struct bench_utils_data d;
+    bench_fill(d.bin, sizeof(d.bin), 6);
+    utils_hex_encode(d.bin, sizeof(d.bin), d.hex);
+
+    /* a raw transaction's worth of hex, the static buffer functions are capped below 1 KiB */
+    bench_run("utils_uint8_to_hex/1000", bench_uint8_to_hex, &d, 1000);
+    bench_run("utils_hex_encode/1024", bench_hex_encode, &d, sizeof(d.bin));
+    bench_run("utils_hex_to_uint8/1000", bench_hex_to_uint8, &d, 1000);
+    bench_run("utils_hex_decode/1024", bench_hex_decode, &d, sizeof(d.bin));
+}
@@ -0,0 +1,51 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Jonas Schnelli
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#ifndef __LIBBTC_ARENA_H__
+#define __LIBBTC_ARENA_H__
+
+#include "btc.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+//!bump allocator: many small allocations, released together with one reset
+typedef struct btc_arena_ btc_arena;
+
+//!create an arena, chunk_size is the size of the memory blocks it takes from the heap (0 for a default)
+LIBBTC_API btc_arena* btc_arena_new(size_t chunk_size);
+LIBBTC_API void btc_arena_free(btc_arena *arena);
+
+//!allocate size bytes (16 byte aligned, not zeroed), NULL if out of memory
+LIBBTC_API void* btc_arena_alloc(btc_arena *arena, size_t size);
+
+//!release all allocations at once, the memory is kept for reuse in a single block
+LIBBTC_API void btc_arena_reset(btc_arena *arena);
+
+//!bytes handed out since the last reset
+LIBBTC_API size_t btc_arena_used(const btc_arena *arena);
+
+#endif //__LIBBTC_ARENA_H__
@@ -26,9 +26,23 @@
 
 #include "btc.h"
 
+#include <stddef.h>
 #include <stdint.h>
 
 LIBBTC_API int base58_encode_check(const uint8_t *data, int len, char *str, int strsize);
 LIBBTC_API int base58_decode_check(const char *str, uint8_t *data, int datalen);
+//!base58_decode_check of the first len characters of str (no terminator required)
+//!21 byte (address) and 78 byte (extended key) payloads use specialised fast paths
+LIBBTC_API int base58_decode_check_len(const char *str, size_t len, uint8_t *data, int datalen);
+
+//!base58_encode_check of count payloads data[i] (len[i] bytes) into str[i] (strsize bytes each)
+//!checksums are computed with the multi-buffer sha256, results[i] is what base58_encode_check returns
+//!returns the number of successfully encoded payloads
+LIBBTC_API size_t base58_encode_check_many(const uint8_t *const *data, const int *len, size_t count,
+                                           char *const *str, int strsize, int *results);
+//!base58_decode_check of count strings str[i] into data[i] (datalen[i] bytes expected)
+//!results[i] is what base58_decode_check returns, returns the number of valid strings
+LIBBTC_API size_t base58_decode_check_many(const char *const *str, uint8_t *const *data, const int *datalen,
+                                           size_t count, int *results);
 
 #endif //__LIBBTC_BASE58_H__
@@ -30,6 +30,7 @@
 #include "btc.h"
 
 #include <stdint.h>
+#include <stddef.h>
 
 
 typedef struct {
@@ -48,6 +49,12 @@ typedef struct {
 LIBBTC_API bool hdnode_public_ckd(HDNode *inout, uint32_t i);
 LIBBTC_API bool hdnode_from_seed(const uint8_t *seed, int seed_len, HDNode *out);
 LIBBTC_API bool hdnode_private_ckd(HDNode *inout, uint32_t i);
+
+//!derive the children indexes[0..n-1] of parent into children[0..n-1]
+//!the HMAC key setup for the parent chain code is done only once
+//!returns false if any child could not be derived
+LIBBTC_API bool hdnode_public_ckd_many(const HDNode *parent, const uint32_t *indexes, size_t n, HDNode *children);
+LIBBTC_API bool hdnode_private_ckd_many(const HDNode *parent, const uint32_t *indexes, size_t n, HDNode *children);
 LIBBTC_API void hdnode_fill_public_key(HDNode *node);
 LIBBTC_API void hdnode_serialize_public(const HDNode *node, char *str, int strsize);
 LIBBTC_API void hdnode_serialize_private(const HDNode *node, char *str, int strsize);
@@ -0,0 +1,82 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Jonas Schnelli
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+
+#ifndef __LIBBTC_BLOCK_H__
+#define __LIBBTC_BLOCK_H__
+
+#include "btc.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "tx.h"
+
+#include "arena.h"
+
+#define BTC_BLOCK_HEADER_SIZE 80
+
+//!block header, hashes in internal byte order
+typedef struct btc_block_header_
+{
+    int32_t version;
+    uint256 prev_block;
+    uint256 merkle_root;
+    uint32_t timestamp;
+    uint32_t bits;
+    uint32_t nonce;
+} btc_block_header;
+
+//!a parsed block, the transactions are read only like those of btc_tx_deserialize_arena
+typedef struct btc_block_
+{
+    btc_block_header header;
+    uint256 hash;       //double sha256 of the header
+    bool merkle_valid;  //the header merkle root matches the txids, and their tree is not mutated
+    size_t size;        //bytes the block takes in the parsed buffer
+    size_t tx_count;
+    btc_tx **txs;       //txids and wtxids are memoised, btc_tx_hash/btc_tx_witness_hash only read them
+    btc_arena **arenas; //transaction memory, one arena per decoding thread
+    size_t arena_count;
+} btc_block;
+
+//!read/write the 80 byte header serialization
+LIBBTC_API bool btc_block_header_deserialize(btc_block_header *header, const uint8_t *data, size_t len);
+LIBBTC_API void btc_block_header_serialize(const btc_block_header *header, uint8_t *out);
+LIBBTC_API void btc_block_header_hash(const btc_block_header *header, uint256 hash);
+
+//!parse the block at the start of data, decoding its transactions on up to threads threads
+//!(0 for one per CPU, 1 for the calling thread only), NULL if it is malformed or out of memory
+LIBBTC_API btc_block* btc_block_parse(const uint8_t *data, size_t len, unsigned int threads);
+LIBBTC_API void btc_block_free(btc_block *block);
+
+//!compute the merkle root of n leaf hashes (txids), an odd last node is paired with itself
+//!mutated (if not NULL) is set if two sibling nodes are identical: duplicating trailing
+//!transactions then gives the same root (CVE-2012-2459), such a block is invalid
+//!returns false if the working buffer could not be allocated (out is zero for n == 0)
+LIBBTC_API bool btc_merkle_root(const uint256 *leaves, size_t n, uint256 out, bool *mutated);
+
+#endif //__LIBBTC_BLOCK_H__
@@ -0,0 +1,58 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Jonas Schnelli
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#ifndef __LIBBTC_BLOCKFILE_H__
+#define __LIBBTC_BLOCKFILE_H__
+
+#include "btc.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+//!network magic of the block file records (little endian)
+#define BTC_BLOCKFILE_MAGIC_MAIN 0xd9b4bef9
+#define BTC_BLOCKFILE_MAGIC_TESTNET3 0x0709110b
+#define BTC_BLOCKFILE_MAGIC_REGTEST 0xdab5bffa
+
+//!read only mapping of a bitcoin core blkNNNNN.dat file
+typedef struct btc_blockfile_ btc_blockfile;
+
+//!map the file at path for sequential reading, NULL if it cannot be opened
+LIBBTC_API btc_blockfile* btc_blockfile_open(const char *path, uint32_t magic);
+LIBBTC_API void btc_blockfile_close(btc_blockfile *file);
+
+//!next block in the file: block points into the mapping (valid until close), offset (optional)
+//!is its position in the file. Zero padding is skipped, after a damaged record the next
+//!magic is searched. false at the end of the file or on a truncated record.
+LIBBTC_API bool btc_blockfile_next(btc_blockfile *file, const uint8_t **block, size_t *len, size_t *offset);
+
+//!ask the OS to start reading a file that will be opened soon (e.g. the next blk file)
+LIBBTC_API void btc_blockfile_prefetch(const char *path);
+
+//!datadir/blocks/blkNNNNN.dat style name of file number n in dir, false if outlen is too small
+LIBBTC_API bool btc_blockfile_path(char *out, size_t outlen, const char *dir, unsigned int n);
+
+#endif //__LIBBTC_BLOCKFILE_H__
@@ -34,6 +34,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "arena.h"
 #include "cstr.h"
 #include "vector.h"
 
@@ -58,6 +59,7 @@ typedef struct btc_tx_in_
     btc_tx_outpoint prevout;
     cstring *script_sig;
     uint32_t sequence;
+    vector *witness_stack; //BIP141 witness items (cstring*), NULL or empty without witness
 } btc_tx_in;
 
 typedef struct btc_tx_out_
@@ -72,9 +74,38 @@ typedef struct btc_tx_
     vector *vin;
     vector *vout;
     uint32_t locktime;
+
+    //memoised btc_tx_hash/btc_tx_witness_hash results, see btc_tx_hash_invalidate
+    uint8_t hash_cached;
+    uint256 txid;
+    uint256 wtxid;
 } btc_tx;
 
 
+//!location of an input or output inside a serialized transaction (byte offsets from its start)
+typedef struct btc_tx_view_item_
+{
+    uint32_t offset;        //prevout (input) or value (output)
+    uint32_t script_offset; //script_sig or script_pubkey, after its length prefix
+    uint32_t script_len;
+    uint32_t witness_offset; //input witness stack (its item count), 0 without witness
+} btc_tx_view_item;
+
+//!read only, zero-copy view of a serialized transaction, the bytes must outlive the view
+typedef struct btc_tx_view_
+{
+    const uint8_t *data;
+    size_t size; //bytes the transaction takes in data
+    uint32_t version;
+    uint32_t locktime;
+    size_t vin_count;
+    size_t vout_count;
+    btc_tx_view_item *vin;
+    btc_tx_view_item *vout;
+    bool has_witness;
+    bool items_on_heap;
+} btc_tx_view;
+
 //!create a new tx input
 LIBBTC_API btc_tx_in* btc_tx_in_new();
 LIBBTC_API void btc_tx_in_free(btc_tx_in *tx_in);
@@ -90,12 +121,82 @@ LIBBTC_API btc_tx* btc_tx_new();
 LIBBTC_API void btc_tx_free(btc_tx *tx);
 LIBBTC_API void btc_tx_copy(btc_tx *dest, const btc_tx *src);
 
-//!deserialize/parse a p2p serialized bitcoin transaction
+//!deserialize/parse a p2p serialized bitcoin transaction, in the legacy or the BIP144 witness format
 LIBBTC_API int btc_tx_deserialize(const unsigned char *tx_serialized, size_t inlen, btc_tx *tx);
 
+//!deserialize a transaction with all its memory (structs, vectors and scripts) taken from arena
+//!returns NULL on a parse error, consumed_length (optional) is set to the bytes read
+//!the result is read only: do not free it (btc_arena_reset releases it) or grow its vectors
+LIBBTC_API btc_tx* btc_tx_deserialize_arena(const unsigned char *tx_serialized, size_t inlen, btc_arena *arena, size_t *consumed_length);
+
+//!validate the transaction at the start of data (trailing bytes are ignored) and record where its fields are
+//!the item tables come from arena, or from the heap if arena is NULL (release them with btc_tx_view_free)
+LIBBTC_API bool btc_tx_view_parse(btc_tx_view *view, const uint8_t *data, size_t len, btc_arena *arena);
+LIBBTC_API void btc_tx_view_free(btc_tx_view *view);
+
+//!bytes taken by the transaction at the start of data without decoding it, 0 if it is malformed
+LIBBTC_API size_t btc_tx_skip(const uint8_t *data, size_t len);
+
+//!field accessors, returned pointers point into the viewed buffer
+LIBBTC_API const uint8_t* btc_tx_view_prevout_hash(const btc_tx_view *view, size_t in_num);
+LIBBTC_API uint32_t btc_tx_view_prevout_n(const btc_tx_view *view, size_t in_num);
+LIBBTC_API const uint8_t* btc_tx_view_script_sig(const btc_tx_view *view, size_t in_num, size_t *len);
+LIBBTC_API uint32_t btc_tx_view_sequence(const btc_tx_view *view, size_t in_num);
+LIBBTC_API int64_t btc_tx_view_value(const btc_tx_view *view, size_t out_num);
+LIBBTC_API const uint8_t* btc_tx_view_script_pubkey(const btc_tx_view *view, size_t out_num, size_t *len);
+//!serialized witness stack of an input (item count, then the length prefixed items),
+//!NULL (and len 0) if the transaction has no witness or the input's stack is empty
+LIBBTC_API const uint8_t* btc_tx_view_witness(const btc_tx_view *view, size_t in_num, size_t *len);
+
 //!serialize a lbc bitcoin data structure into a p2p serialized buffer
+//!(BIP144 format with witness data if any input has a witness)
 LIBBTC_API void btc_tx_serialize(cstring *s, const btc_tx *tx);
 
+//!exact size of the p2p serialization of tx
+LIBBTC_API size_t btc_tx_serialized_size(const btc_tx *tx);
+
+//!true if any input has witness data
+LIBBTC_API bool btc_tx_has_witness(const btc_tx *tx);
+
+//!txid (double sha256 of the serialization without witness) and wtxid (with witness),
+//!in internal byte order, hashed without serializing into a buffer
+//!the result is memoised on tx, later calls only copy it
+//!these write to tx: not thread-safe on a tx shared between threads unless already memoised
+LIBBTC_API void btc_tx_hash(btc_tx *tx, uint8_t *hashout);
+LIBBTC_API void btc_tx_witness_hash(btc_tx *tx, uint8_t *hashout);
+
+//!drop the memoised hashes, needed after changing the fields of tx directly
+//!(btc_tx_deserialize and btc_tx_copy keep them up to date)
+LIBBTC_API void btc_tx_hash_invalidate(btc_tx *tx);
+
+//!txid and wtxid hashed on every call without reading or writing the memoised values,
+//!safe for concurrent readers of a shared tx
+LIBBTC_API void btc_tx_hash_compute(const btc_tx *tx, uint8_t *hashout);
+LIBBTC_API void btc_tx_witness_hash_compute(const btc_tx *tx, uint8_t *hashout);
+
+//!serialize into a caller buffer, returns the bytes written or 0 if buflen is too small
+LIBBTC_API size_t btc_tx_serialize_buf(const btc_tx *tx, uint8_t *buf, size_t buflen);
+
+//!BIP141 weight and virtual size (for fee estimation), computed without serializing
+LIBBTC_API size_t btc_tx_weight(const btc_tx *tx);
+LIBBTC_API size_t btc_tx_vsize(const btc_tx *tx);
+
 LIBBTC_API bool btc_tx_sighash(const btc_tx *tx_to, const cstring *fromPubKey, unsigned int in_num, int hashtype, uint8_t *hash);
 
+//!precomputed sighash data of one transaction, shared by all its inputs
+typedef struct btc_tx_sighash_cache_ btc_tx_sighash_cache;
+
+//!build the cache for tx (NULL if out of memory), tx must not change while the cache is in use
+LIBBTC_API btc_tx_sighash_cache* btc_tx_sighash_cache_new(const btc_tx *tx);
+LIBBTC_API void btc_tx_sighash_cache_free(btc_tx_sighash_cache *cache);
+
+//!same result as btc_tx_sighash for the cached transaction
+LIBBTC_API bool btc_tx_sighash_cached(const btc_tx_sighash_cache *cache, const cstring *fromPubKey, unsigned int in_num, int hashtype, uint8_t *hash);
+
+//!BIP143 signature hash of a segwit v0 input spending amount (satoshis), script_code is used as given
+LIBBTC_API bool btc_tx_sighash_witness_v0(const btc_tx *tx_to, const cstring *script_code, unsigned int in_num, int hashtype, int64_t amount, uint8_t *hash);
+
+//!BIP143 signature hash reusing the cached hashPrevouts, hashSequence and hashOutputs
+LIBBTC_API bool btc_tx_sighash_witness_v0_cached(const btc_tx_sighash_cache *cache, const cstring *script_code, unsigned int in_num, int hashtype, int64_t amount, uint8_t *hash);
+
 #endif //__LIBBTC_TX_H__
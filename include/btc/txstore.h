@@ -0,0 +1,85 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Jonas Schnelli
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#ifndef __LIBBTC_TXSTORE_H__
+#define __LIBBTC_TXSTORE_H__
+
+#include "btc.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "arena.h"
+#include "tx.h"
+
+//!columnar (structure of arrays) store of many transactions for scans,
+//!all columns are contiguous and indexed by transaction, input or output number
+typedef struct btc_txstore_
+{
+    size_t tx_count;
+    uint256 *txid;
+    uint32_t *version;
+    uint32_t *locktime;
+    size_t *tx_vin_start;  //first input of each transaction, tx_count + 1 entries
+    size_t *tx_vout_start; //first output of each transaction, tx_count + 1 entries
+
+    size_t vin_count;
+    uint256 *prevout_hash;
+    uint32_t *prevout_n;
+    uint32_t *sequence;
+
+    size_t vout_count;
+    int64_t *value;
+    size_t *script_start;  //output scripts in script_bytes, vout_count + 1 entries
+    uint8_t *script_bytes;
+
+    //capacities and parser scratch memory
+    size_t tx_alloc, vin_alloc, vout_alloc, script_alloc;
+    btc_arena *scratch;
+} btc_txstore;
+
+//!initialize an empty store, false if out of memory
+LIBBTC_API bool btc_txstore_init(btc_txstore *store);
+LIBBTC_API void btc_txstore_free(btc_txstore *store);
+//!drop all transactions but keep the memory
+LIBBTC_API void btc_txstore_clear(btc_txstore *store);
+
+//!append count concatenated serialized transactions (e.g. the body of a block)
+//!returns the bytes consumed, 0 if one is malformed or out of memory (the store is left unchanged)
+LIBBTC_API size_t btc_txstore_append(btc_txstore *store, const uint8_t *data, size_t len, size_t count);
+
+//!output script, its transaction (binary search) and the transaction of an input
+LIBBTC_API const uint8_t* btc_txstore_script_pubkey(const btc_txstore *store, size_t out_num, size_t *len);
+LIBBTC_API size_t btc_txstore_output_tx(const btc_txstore *store, size_t out_num);
+LIBBTC_API size_t btc_txstore_input_tx(const btc_txstore *store, size_t in_num);
+
+//!iteration: first output/input at or after from that matches, vout_count/vin_count if none
+//!for (i = btc_txstore_next_value(s, min, max, 0); i < s->vout_count; i = btc_txstore_next_value(s, min, max, i + 1))
+LIBBTC_API size_t btc_txstore_next_value(const btc_txstore *store, int64_t min, int64_t max, size_t from);
+LIBBTC_API size_t btc_txstore_next_script(const btc_txstore *store, const uint8_t *script, size_t len, size_t from);
+LIBBTC_API size_t btc_txstore_next_prevout(const btc_txstore *store, const uint256 hash, uint32_t n, size_t from);
+
+#endif //__LIBBTC_TXSTORE_H__
@@ -0,0 +1,151 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Jonas Schnelli
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "btc/arena.h"
+
+#define BTC_ARENA_ALIGN 16
+#define BTC_ARENA_DEFAULT_CHUNK (64 * 1024)
+
+/* a heap block, allocations are bumped from cur towards end */
+typedef struct btc_arena_chunk_
+{
+    struct btc_arena_chunk_ *next;
+    size_t size;
+    uint8_t *cur;
+    uint8_t *end;
+} btc_arena_chunk;
+
+/* larger sizes overflow the rounding or the chunk header */
+#define BTC_ARENA_MAX_ALLOC (SIZE_MAX - sizeof(btc_arena_chunk) - 2 * BTC_ARENA_ALIGN)
+
+struct btc_arena_
+{
+    btc_arena_chunk *head; /* the chunk in use, older ones follow */
+    size_t chunk_size;
+    size_t used;
+    size_t capacity; /* total size of all chunks */
+};
+
+static btc_arena_chunk* btc_arena_chunk_new(size_t size)
+{
+    btc_arena_chunk *chunk;
+
+    if (size > BTC_ARENA_MAX_ALLOC)
+        return NULL;
+    chunk = malloc(sizeof(*chunk) + size + BTC_ARENA_ALIGN);
+    if (!chunk)
+        return NULL;
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->cur = (uint8_t *)(((uintptr_t)(chunk + 1) + BTC_ARENA_ALIGN - 1) & ~(uintptr_t)(BTC_ARENA_ALIGN - 1));
+    chunk->end = chunk->cur + size;
+    return chunk;
+}
+
+btc_arena* btc_arena_new(size_t chunk_size)
+{
+    btc_arena *arena = calloc(1, sizeof(*arena));
+    if (!arena)
+        return NULL;
+    arena->chunk_size = chunk_size ? chunk_size : BTC_ARENA_DEFAULT_CHUNK;
+    return arena;
+}
+
+static void btc_arena_free_chunks(btc_arena *arena)
+{
+    btc_arena_chunk *chunk = arena->head, *next;
+    while (chunk) {
+        next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->head = NULL;
+    arena->capacity = 0;
+}
+
+void btc_arena_free(btc_arena *arena)
+{
+    if (!arena)
+        return;
+    btc_arena_free_chunks(arena);
+    free(arena);
+}
+
+void* btc_arena_alloc(btc_arena *arena, size_t size)
+{
+    btc_arena_chunk *chunk = arena->head;
+    uint8_t *p;
+
+    if (size > BTC_ARENA_MAX_ALLOC)
+        return NULL;
+    size = (size + BTC_ARENA_ALIGN - 1) & ~(size_t)(BTC_ARENA_ALIGN - 1);
+    if (!chunk || (size_t)(chunk->end - chunk->cur) < size) {
+        /* chunks double up to the high water mark, oversized requests get their own */
+        size_t chunk_size = arena->capacity > arena->chunk_size ? arena->capacity : arena->chunk_size;
+        if (chunk_size < size)
+            chunk_size = size;
+        chunk = btc_arena_chunk_new(chunk_size);
+        if (!chunk)
+            return NULL;
+        chunk->next = arena->head;
+        arena->head = chunk;
+        arena->capacity += chunk_size;
+    }
+    p = chunk->cur;
+    chunk->cur += size;
+    arena->used += size;
+    return p;
+}
+
+void btc_arena_reset(btc_arena *arena)
+{
+    btc_arena_chunk *chunk = arena->head;
+
+    arena->used = 0;
+    if (!chunk)
+        return;
+    if (chunk->next) {
+        /* coalesce into one chunk of the total size, later cycles then need no heap calls */
+        size_t capacity = arena->capacity;
+        btc_arena_free_chunks(arena);
+        chunk = btc_arena_chunk_new(capacity);
+        if (!chunk)
+            return;
+        arena->head = chunk;
+        arena->capacity = capacity;
+        return;
+    }
+    chunk->cur = chunk->end - chunk->size;
+}
+
+size_t btc_arena_used(const btc_arena *arena)
+{
+    return arena->used;
+}
@@ -40,53 +40,74 @@ static const int8_t b58digits_map[] = {
     47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, -1, -1, -1, -1, -1,
 };
 
-static int b58tobin(void *bin, size_t *binszp, const char *b58)
+/* Both conversions work on limbs of 5 base58 digits: 58^5 fits in 30 bits,
+ * so a limb times 2^32 plus a carry still fits in 64 bits. This replaces
+ * the per digit/per byte carry loops by one pass per 4 bytes/5 digits. */
+#define B58_LIMB 656356768 /* 58^5 */
+#define B58_LIMB_DIGITS 5
+/* largest binary handled: 128 bytes of payload plus a 4 byte checksum */
+#define B58_MAX_BINSZ (128 + 4)
+#define B58_MAX_LIMBS ((B58_MAX_BINSZ * 138 / 100 + 1) / B58_LIMB_DIGITS + 1)
+
+/* binsz is passed separately from *binszp so the fixed size callers below
+ * get the word loops specialised (and unrolled) for a constant size */
+static inline int b58tobin_sized(void *bin, size_t binsz, size_t *binszp, const char *b58, size_t b58sz)
 {
-    size_t binsz = *binszp;
     const unsigned char *b58u = (const void *)b58;
     unsigned char *binu = bin;
     size_t outisz = (binsz + 3) / 4;
-    uint32_t outi[outisz];
-    uint64_t t;
+    uint32_t outi[(B58_MAX_BINSZ + 3) / 4];
+    uint64_t t, mul;
     uint32_t c;
-    size_t i, j;
+    size_t i, j, n, high = outisz;
     uint8_t bytesleft = binsz % 4;
     uint32_t zeromask = bytesleft ? (0xffffffff << (bytesleft * 8)) : 0;
     unsigned zerocount = 0;
-    size_t b58sz;
 
-    b58sz = strlen(b58);
+    if (binsz > B58_MAX_BINSZ) {
+        return false;
+    }
 
-    memset(outi, 0, outisz * sizeof(*outi));
+    memset(outi, 0, sizeof(outi));
 
     // Leading zeros, just count
-    for (i = 0; i < b58sz && !b58digits_map[b58u[i]]; ++i) {
+    for (i = 0; i < b58sz && b58u[i] == '1'; ++i) {
         ++zerocount;
     }
 
-    for ( ; i < b58sz; ++i) {
-        if (b58u[i] & 0x80) {
-            // High-bit set on invalid digit
-            return false;
+    // Remaining digits in chunks of up to 5, the first one takes the remainder
+    for (n = (b58sz - i) % B58_LIMB_DIGITS; i < b58sz; i += n, n = B58_LIMB_DIGITS) {
+        if (!n) {
+            n = B58_LIMB_DIGITS;
         }
-        if (b58digits_map[b58u[i]] == -1) {
-            // Invalid base58 digit
-            return false;
+        for (c = 0, mul = 1, j = i; j < i + n; ++j, mul *= 58) {
+            if (b58u[j] & 0x80) {
+                // High-bit set on invalid digit
+                return false;
+            }
+            if (b58digits_map[b58u[j]] == -1) {
+                // Invalid base58 digit
+                return false;
+            }
+            c = c * 58 + (unsigned)b58digits_map[b58u[j]];
         }
-        c = (unsigned)b58digits_map[b58u[i]];
-        for (j = outisz; j--; ) {
-            t = ((uint64_t)outi[j]) * 58 + c;
-            c = (t & 0x3f00000000) >> 32;
+        // Words above high are still zero, the carry (< 58^5) fits in one
+        for (j = outisz; j-- > high; ) {
+            t = ((uint64_t)outi[j]) * mul + c;
+            c = t >> 32;
             outi[j] = t & 0xffffffff;
         }
         if (c) {
-            // Output number too big (carry to the next int32)
-            memset(outi, 0, outisz * sizeof(*outi));
-            return false;
+            if (!high) {
+                // Output number too big (carry to the next int32)
+                memset(outi, 0, sizeof(outi));
+                return false;
+            }
+            outi[--high] = c;
         }
         if (outi[0] & zeromask) {
             // Output number too big (last int32 filled too far)
-            memset(outi, 0, outisz * sizeof(*outi));
+            memset(outi, 0, sizeof(outi));
             return false;
         }
     }
@@ -121,78 +142,127 @@ static int b58tobin(void *bin, size_t *binszp, const char *b58)
     }
     *binszp += zerocount;
 
-    memset(outi, 0, outisz * sizeof(*outi));
+    memset(outi, 0, sizeof(outi));
     return true;
 }
 
-static int b58check(const void *bin, size_t binsz, const char *base58str)
+/* decode b58sz digits (no terminator needed) into *binszp bytes, with
+ * fast paths for 25 byte addresses and 82 byte extended keys */
+static int b58tobin(void *bin, size_t *binszp, const char *b58, size_t b58sz)
+{
+    switch (*binszp) {
+        case 21 + 4:
+            return b58tobin_sized(bin, 21 + 4, binszp, b58, b58sz);
+        case 78 + 4:
+            return b58tobin_sized(bin, 78 + 4, binszp, b58, b58sz);
+        default:
+            return b58tobin_sized(bin, *binszp, binszp, b58, b58sz);
+    }
+}
+
+/* check the checksum of bin against its double sha256 digest */
+static int b58check_hashed(const void *bin, size_t binsz, const uint8_t *hash, const char *base58str, size_t b58sz)
 {
-    unsigned char buf[32];
     const uint8_t *binc = bin;
     unsigned i;
-    if (binsz < 4) {
-        return -4;
-    }
-    sha256_Raw(bin, binsz - 4, buf);
-    sha256_Raw(buf, 32, buf);
-    if (memcmp(&binc[binsz - 4], buf, 4)) {
+    if (memcmp(&binc[binsz - 4], hash, 4)) {
         return -1;
     }
 
     // Check number of zeros is correct AFTER verifying checksum (to avoid possibility of accessing base58str beyond the end)
-    for (i = 0; binc[i] == '\0' && base58str[i] == '1'; ++i) {
+    for (i = 0; i < b58sz && binc[i] == '\0' && base58str[i] == '1'; ++i) {
     }  // Just finding the end of zeros, nothing to do in loop
-    if (binc[i] == '\0' || base58str[i] == '1') {
+    if (binc[i] == '\0' || (i < b58sz && base58str[i] == '1')) {
         return -3;
     }
 
     return binc[0];
 }
 
+static int b58check(const void *bin, size_t binsz, const char *base58str, size_t b58sz)
+{
+    unsigned char buf[32];
+    if (binsz < 4) {
+        return -4;
+    }
+    sha256_Raw(bin, binsz - 4, buf);
+    sha256_Raw(buf, 32, buf);
+    return b58check_hashed(bin, binsz, buf, base58str, b58sz);
+}
+
 static const char b58digits_ordered[] =
     "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
 
 static int b58enc(char *b58, size_t *b58sz, const void *data, size_t binsz)
 {
     const uint8_t *bin = data;
-    int carry;
-    ssize_t i, j, high, zcount = 0;
-    size_t size;
+    uint32_t limbs[B58_MAX_LIMBS];
+    uint32_t word, limb;
+    uint64_t t, mul;
+    size_t i, j, n, nlimbs = 0, zcount = 0, size;
 
-    while (zcount < (ssize_t)binsz && !bin[zcount]) {
-        ++zcount;
+    if (binsz > B58_MAX_BINSZ) {
+        return false;
     }
 
-    size = (binsz - zcount) * 138 / 100 + 1;
-    uint8_t buf[size];
-    memset(buf, 0, size);
+    while (zcount < binsz && !bin[zcount]) {
+        ++zcount;
+    }
 
-    for (i = zcount, high = size - 1; i < (ssize_t)binsz; ++i, high = j) {
-        for (carry = bin[i], j = size - 1; (j > high) || carry; --j) {
-            carry += 256 * buf[j];
-            buf[j] = carry % 58;
-            carry /= 58;
+    // Big endian 32 bit words, the first one takes the remaining bytes;
+    // limbs are stored least significant first and only grow as needed
+    for (i = zcount, n = (binsz - zcount) % 4; i < binsz; n = 4) {
+        if (!n) {
+            n = 4;
+        }
+        for (word = 0, j = 0; j < n; ++j) {
+            word = (word << 8) | bin[i++];
+        }
+        mul = (uint64_t)1 << (8 * n);
+        for (j = 0; j < nlimbs; ++j) {
+            t = limbs[j] * mul + word;
+            limbs[j] = t % B58_LIMB;
+            word = t / B58_LIMB;
+        }
+        for (; word; word /= B58_LIMB) {
+            limbs[nlimbs++] = word % B58_LIMB;
         }
     }
 
-    for (j = 0; j < (ssize_t)size && !buf[j]; ++j);
+    // Every limb but the most significant one has exactly five digits
+    size = zcount;
+    if (nlimbs) {
+        size += (nlimbs - 1) * B58_LIMB_DIGITS;
+        for (limb = limbs[nlimbs - 1]; limb; limb /= 58) {
+            ++size;
+        }
+    }
 
-    if (*b58sz <= zcount + size - j) {
-        *b58sz = zcount + size - j + 1;
-        memset(buf, 0, size);
+    if (*b58sz <= size) {
+        *b58sz = size + 1;
+        memset(limbs, 0, sizeof(limbs));
         return false;
     }
 
     if (zcount) {
         memset(b58, '1', zcount);
     }
-    for (i = zcount; j < (ssize_t)size; ++i, ++j) {
-        b58[i] = b58digits_ordered[buf[j]];
+    b58[size] = '\0';
+    for (i = size, j = 0; j < nlimbs; ++j) {
+        limb = limbs[j];
+        if (j + 1 < nlimbs) {
+            for (n = 0; n < B58_LIMB_DIGITS; ++n, limb /= 58) {
+                b58[--i] = b58digits_ordered[limb % 58];
+            }
+        } else {
+            for (; limb; limb /= 58) {
+                b58[--i] = b58digits_ordered[limb % 58];
+            }
+        }
     }
-    b58[i] = '\0';
-    *b58sz = i + 1;
+    *b58sz = size + 1;
 
-    memset(buf, 0, size);
+    memset(limbs, 0, sizeof(limbs));
     return true;
 }
 
@@ -218,19 +288,24 @@ int base58_encode_check(const uint8_t *data, int datalen, char *str, int strsize
 }
 
 int base58_decode_check(const char *str, uint8_t *data, int datalen)
+{
+    return base58_decode_check_len(str, strlen(str), data, datalen);
+}
+
+int base58_decode_check_len(const char *str, size_t len, uint8_t *data, int datalen)
 {
     int ret;
 
-    if (datalen > 128) {
+    if (datalen < 0 || datalen > 128) {
         return 0;
     }
-    uint8_t d[datalen + 4];
+    uint8_t d[B58_MAX_BINSZ];
     size_t res = datalen + 4;
-    if (b58tobin(d, &res, str) != true) {
+    if (b58tobin(d, &res, str, len) != true) {
         ret = 0;
     } else if (res != (size_t)datalen + 4) {
         ret = 0;
-    } else if (b58check(d, res, str) < 0) {
+    } else if (b58check(d, res, str, len) < 0) {
         ret = 0;
     } else {
         memcpy(data, d, datalen);
@@ -239,3 +314,106 @@ int base58_decode_check(const char *str, uint8_t *data, int datalen)
     memset(d, 0, sizeof(d));
     return ret;
 }
+
+/* payloads per batch, sized for the stack (~20KB) */
+#define B58_BATCH 64
+
+/* double sha256 of n messages with the multi-buffer code */
+static void b58_hash_many(const uint8_t *const *msgs, const size_t *lens, size_t n,
+                          uint8_t (*digests)[SHA256_DIGEST_LENGTH])
+{
+    uint8_t first[B58_BATCH][SHA256_DIGEST_LENGTH];
+    const uint8_t *ptrs[B58_BATCH];
+    size_t lens32[B58_BATCH];
+    size_t i;
+
+    sha256_Raw_many(msgs, lens, n, first);
+    for (i = 0; i < n; i++) {
+        ptrs[i] = first[i];
+        lens32[i] = SHA256_DIGEST_LENGTH;
+    }
+    sha256_Raw_many(ptrs, lens32, n, digests);
+    memset(first, 0, sizeof(first));
+}
+
+size_t base58_encode_check_many(const uint8_t *const *data, const int *len, size_t count,
+                                char *const *str, int strsize, int *results)
+{
+    uint8_t bufs[B58_BATCH][B58_MAX_BINSZ];
+    uint8_t digests[B58_BATCH][SHA256_DIGEST_LENGTH];
+    const uint8_t *msgs[B58_BATCH];
+    size_t lens[B58_BATCH], idx[B58_BATCH];
+    size_t done, batch, n, i, ok = 0;
+
+    for (done = 0; done < count; done += batch) {
+        batch = count - done < B58_BATCH ? count - done : B58_BATCH;
+
+        /* payloads too long (or negative) fail like base58_encode_check */
+        for (i = 0, n = 0; i < batch; i++) {
+            results[done + i] = 0;
+            if (len[done + i] < 0 || len[done + i] > 128) {
+                continue;
+            }
+            msgs[n] = data[done + i];
+            lens[n] = len[done + i];
+            idx[n++] = done + i;
+        }
+        b58_hash_many(msgs, lens, n, digests);
+
+        for (i = 0; i < n; i++) {
+            size_t res = strsize;
+            memcpy(bufs[i], msgs[i], lens[i]);
+            memcpy(bufs[i] + lens[i], digests[i], 4);
+            if (b58enc(str[idx[i]], &res, bufs[i], lens[i] + 4) == true) {
+                results[idx[i]] = res;
+                ok++;
+            }
+        }
+    }
+    memset(bufs, 0, sizeof(bufs));
+    memset(digests, 0, sizeof(digests));
+    return ok;
+}
+
+size_t base58_decode_check_many(const char *const *str, uint8_t *const *data, const int *datalen,
+                                size_t count, int *results)
+{
+    uint8_t bufs[B58_BATCH][B58_MAX_BINSZ];
+    uint8_t digests[B58_BATCH][SHA256_DIGEST_LENGTH];
+    const uint8_t *msgs[B58_BATCH];
+    size_t lens[B58_BATCH], idx[B58_BATCH], slens[B58_BATCH];
+    size_t done, batch, n, i, ok = 0;
+
+    for (done = 0; done < count; done += batch) {
+        batch = count - done < B58_BATCH ? count - done : B58_BATCH;
+
+        /* radix conversion first, only well formed strings get hashed */
+        for (i = 0, n = 0; i < batch; i++) {
+            int dlen = datalen[done + i];
+            size_t res = dlen + 4;
+            results[done + i] = 0;
+            if (dlen < 0 || dlen > 128) {
+                continue;
+            }
+            slens[n] = strlen(str[done + i]);
+            if (b58tobin(bufs[n], &res, str[done + i], slens[n]) != true || res != (size_t)dlen + 4) {
+                continue;
+            }
+            msgs[n] = bufs[n];
+            lens[n] = dlen;
+            idx[n++] = done + i;
+        }
+        b58_hash_many(msgs, lens, n, digests);
+
+        for (i = 0; i < n; i++) {
+            if (b58check_hashed(bufs[i], lens[i] + 4, digests[i], str[idx[i]], slens[i]) < 0) {
+                continue;
+            }
+            memcpy(data[idx[i]], bufs[i], lens[i]);
+            results[idx[i]] = lens[i];
+            ok++;
+        }
+    }
+    memset(bufs, 0, sizeof(bufs));
+    return ok;
+}
@@ -80,83 +80,76 @@ bool hdnode_from_seed(const uint8_t *seed, int seed_len, HDNode *out)
 }
 
 
-bool hdnode_public_ckd(HDNode *inout, uint32_t i)
+// fingerprint of a node, stored in its children
+static uint32_t hdnode_fingerprint(const HDNode *node)
 {
-    uint8_t data[1 + 32 + 4];
-    uint8_t I[32 + 32];
-    uint8_t fingerprint[32];
+    uint8_t fingerprint[RIPEMD160_DIGEST_LENGTH];
+    uint32_t fp;
+
+    btc_hash160(node->public_key, 33, fingerprint);
+    fp = read_be(fingerprint);
+    memset(fingerprint, 0, sizeof(fingerprint));
+    return fp;
+}
 
+
+// child derivation message: serP(K) or 0x00 || ser256(k), followed by ser32(i)
+static bool hdnode_ckd_data(const HDNode *node, uint32_t i, bool private_ckd, uint8_t *data)
+{
     if (i & 0x80000000) { // private derivation
-        return false;
+        if (!private_ckd)
+            return false;
+        data[0] = 0;
+        memcpy(data + 1, node->private_key, 32);
     } else { // public derivation
-        memcpy(data, inout->public_key, 33);
+        memcpy(data, node->public_key, 33);
     }
     write_be(data + 33, i);
+    return true;
+}
+
 
-    sha256_Raw(inout->public_key, 33, fingerprint);
-    ripemd160(fingerprint, 32, fingerprint);
-    inout->fingerprint = (fingerprint[0] << 24) + (fingerprint[1] << 16) + (fingerprint[2] << 8) + fingerprint[3];
+// apply I = HMAC-SHA512(parent chain code, data) to the parent copy in inout
+static bool hdnode_public_ckd_apply(HDNode *inout, uint32_t i, const uint8_t *I,
+                                    uint32_t fingerprint)
+{
+    inout->fingerprint = fingerprint;
 
     memset(inout->private_key, 0, 32);
 
     int failed = 0;
-    hmac_sha512(inout->chain_code, 32, data, sizeof(data), I);
     memcpy(inout->chain_code, I + 32, 32);
 
 
     if (!ecc_public_key_tweak_add(inout->public_key, I))
-        failed = false;
+        failed = 1;
 
     if (!failed) {
         inout->depth++;
         inout->child_num = i;
     }
 
-    // Wipe all stack data.
-    memset(data, 0, sizeof(data));
-    memset(I, 0, sizeof(I));
-    memset(fingerprint, 0, sizeof(fingerprint));
-    
     return failed ? false : true;
 }
 
 
-bool hdnode_private_ckd(HDNode *inout, uint32_t i)
+static bool hdnode_private_ckd_apply(HDNode *inout, uint32_t i, const uint8_t *I,
+                                     uint32_t fingerprint)
 {
-    uint8_t data[1 + 32 + 4];
-    uint8_t I[32 + 32];
-    uint8_t fingerprint[32];
-    uint8_t p[32], z[32];
+    uint8_t z[32];
 
-    if (i & 0x80000000) { // private derivation
-        data[0] = 0;
-        memcpy(data + 1, inout->private_key, 32);
-    } else { // public derivation
-        memcpy(data, inout->public_key, 33);
-    }
-    write_be(data + 33, i);
+    inout->fingerprint = fingerprint;
 
-    sha256_Raw(inout->public_key, 33, fingerprint);
-    ripemd160(fingerprint, 32, fingerprint);
-    inout->fingerprint = (fingerprint[0] << 24) + (fingerprint[1] << 16) +
-                         (fingerprint[2] << 8) + fingerprint[3];
-
-    memset(fingerprint, 0, sizeof(fingerprint));
-    memcpy(p, inout->private_key, 32);
-
-    hmac_sha512(inout->chain_code, 32, data, sizeof(data), I);
     memcpy(inout->chain_code, I + 32, 32);
-    memcpy(inout->private_key, I, 32);
-
-    memcpy(z, inout->private_key, 32);
+    memcpy(z, I, 32);
 
     int failed = 0;
     if (!ecc_verify_privatekey(z)) {
         failed = 1;
+        memset(z, 0, sizeof(z));
         return false;
     }
 
-    memcpy(inout->private_key, p, 32);
     if (!ecc_private_key_tweak_add(inout->private_key, z)) {
         failed = 1;
     }
@@ -168,11 +161,108 @@ bool hdnode_private_ckd(HDNode *inout, uint32_t i)
         hdnode_fill_public_key(inout);
     }
 
+    memset(z, 0, sizeof(z));
+    return !failed;
+}
+
+
+static bool hdnode_ckd(HDNode *inout, uint32_t i, bool private_ckd)
+{
+    uint8_t data[1 + 32 + 4];
+    uint8_t I[32 + 32];
+    bool ret;
+
+    if (!hdnode_ckd_data(inout, i, private_ckd, data))
+        return false;
+
+    uint32_t fingerprint = hdnode_fingerprint(inout);
+    hmac_sha512(inout->chain_code, 32, data, sizeof(data), I);
+    if (private_ckd)
+        ret = hdnode_private_ckd_apply(inout, i, I, fingerprint);
+    else
+        ret = hdnode_public_ckd_apply(inout, i, I, fingerprint);
+
+    // Wipe all stack data.
+    memset(data, 0, sizeof(data));
+    memset(I, 0, sizeof(I));
+    return ret;
+}
+
+
+bool hdnode_public_ckd(HDNode *inout, uint32_t i)
+{
+    return hdnode_ckd(inout, i, false);
+}
+
+
+bool hdnode_private_ckd(HDNode *inout, uint32_t i)
+{
+    return hdnode_ckd(inout, i, true);
+}
+
+
+#define HDNODE_CKD_BATCH 16
+
+// the parent chain code and fingerprint are shared by all children,
+// the HMACs of a batch are computed together (multi-lane where available)
+static bool hdnode_ckd_many(const HDNode *parent, const uint32_t *indexes, size_t n,
+                            HDNode *children, bool private_ckd)
+{
+    HMAC_SHA512_CTX hctx;
+    uint8_t data[HDNODE_CKD_BATCH][1 + 32 + 4];
+    uint8_t I[HDNODE_CKD_BATCH][32 + 32];
+    const uint8_t *msg[HDNODE_CKD_BATCH];
+    uint32_t msglen[HDNODE_CKD_BATCH];
+    uint32_t fingerprint = hdnode_fingerprint(parent);
+    bool valid[HDNODE_CKD_BATCH];
+    bool ret = true;
+    size_t k, j, batch;
+
+    for (j = 0; j < HDNODE_CKD_BATCH; j++) {
+        msg[j] = data[j];
+        msglen[j] = sizeof(data[j]);
+    }
+
+    hmac_sha512_Init(&hctx, parent->chain_code, 32);
+    for (k = 0; k < n; k += batch) {
+        batch = n - k < HDNODE_CKD_BATCH ? n - k : HDNODE_CKD_BATCH;
+        for (j = 0; j < batch; j++) {
+            valid[j] = hdnode_ckd_data(parent, indexes[k + j], private_ckd, data[j]);
+            if (!valid[j])
+                memset(data[j], 0, sizeof(data[j]));
+        }
+        hmac_sha512_Final_many(&hctx, msg, msglen, batch, I);
+        for (j = 0; j < batch; j++) {
+            children[k + j] = *parent;
+            if (!valid[j]) {
+                ret = false;
+                continue;
+            }
+            if (private_ckd) {
+                if (!hdnode_private_ckd_apply(&children[k + j], indexes[k + j], I[j], fingerprint))
+                    ret = false;
+            } else {
+                if (!hdnode_public_ckd_apply(&children[k + j], indexes[k + j], I[j], fingerprint))
+                    ret = false;
+            }
+        }
+    }
+    memset(&hctx, 0, sizeof(hctx));
     memset(data, 0, sizeof(data));
     memset(I, 0, sizeof(I));
-    memset(p, 0, sizeof(p));
-    memset(z, 0, sizeof(z));
-    return true;
+    return ret;
+}
+
+
+bool hdnode_public_ckd_many(const HDNode *parent, const uint32_t *indexes, size_t n, HDNode *children)
+{
+    return hdnode_ckd_many(parent, indexes, n, children, false);
+}
+
+
+bool hdnode_private_ckd_many(const HDNode *parent, const uint32_t *indexes, size_t n, HDNode *children)
+{
+    return hdnode_ckd_many(parent, indexes, n, children, true);
 }
 
 
@@ -243,26 +333,20 @@ bool hdnode_deserialize(const char *str, HDNode *node)
 bool hd_generate_key(HDNode *node, const char *keypath, const uint8_t *privkeymaster,
                         const uint8_t *chaincode)
 {
-    static char delim[] = "/";
-    static char prime[] = "phH\'";
-    static char digits[] = "0123456789";
+    static const char delim[] = "/";
+    static const char prime[] = "phH\'";
+    static const char digits[] = "0123456789";
     uint64_t idx = 0;
     assert(strlens(keypath) < 1024);
-    char *pch, *kp = malloc(strlens(keypath) + 1);
-
-    if (!kp) {
-        return false;
-    }
+    const char *pch;
+    size_t toklen;
 
     if (strlens(keypath) < strlens("m/")) {
-        goto err;
+        return false;
     }
 
-    memset(kp, 0, strlens(keypath) + 1);
-    memcpy(kp, keypath, strlens(keypath));
-
-    if (kp[0] != 'm' || kp[1] != '/') {
-        goto err;
+    if (keypath[0] != 'm' || keypath[1] != '/') {
+        return false;
     }
 
     node->depth = 0;
@@ -272,41 +356,40 @@ bool hd_generate_key(HDNode *node, const char *keypath, const uint8_t *privkeyma
     memcpy(node->private_key, privkeymaster, 32);
     hdnode_fill_public_key(node);
 
-    pch = strtok(kp + 2, delim);
-    while (pch != NULL) {
+    /* walk the path in place (strtok is not reentrant), empty elements are skipped */
+    for (pch = keypath + 2; *pch; pch += toklen) {
         size_t i = 0;
         int prm = 0;
-        for ( ; i < strlens(pch); i++) {
+        toklen = strcspn(pch, delim);
+        if (toklen == 0) {
+            toklen = 1;
+            continue;
+        }
+        for ( ; i < toklen; i++) {
             if (strchr(prime, pch[i])) {
-                if (i != strlens(pch) - 1) {
-                    goto err;
+                if (i != toklen - 1) {
+                    return false;
                 }
                 prm = 1;
             } else if (!strchr(digits, pch[i])) {
-                goto err;
+                return false;
             }
         }
 
         idx = strtoull(pch, NULL, 10);
         if (idx > UINT32_MAX) {
-            goto err;
+            return false;
         }
 
         if (prm) {
             if (hdnode_private_ckd_prime(node, idx) != true) {
-                goto err;
+                return false;
             }
         } else {
             if (hdnode_private_ckd(node, idx) != true) {
-                goto err;
+                return false;
             }
         }
-        pch = strtok(NULL, delim);
     }
-    free(kp);
     return true;
-
-err:
-    free(kp);
-    return false;
 }
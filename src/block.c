@@ -0,0 +1,307 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Jonas Schnelli
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#if defined HAVE_CONFIG_H
+#include "libbtc-config.h"
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "btc/block.h"
+
+#include "serialize.h"
+#include "sha2.h"
+
+/* smallest transaction: version, empty input and output lists, locktime */
+#define BTC_BLOCK_MIN_TX_SIZE 10
+/* fewer transactions per thread are not worth starting it */
+#define BTC_BLOCK_MIN_THREAD_TXS 64
+#define BTC_BLOCK_MAX_THREADS 64
+
+bool btc_merkle_root(const uint256 *leaves, size_t n, uint256 out, bool *mutated)
+{
+    uint8_t *level;
+    size_t i;
+
+    if (mutated)
+        *mutated = false;
+    if (n == 0) {
+        memset(out, 0, sizeof(uint256));
+        return true;
+    }
+
+    /* one spare node to duplicate an odd last entry */
+    level = malloc((n + 1) * sizeof(uint256));
+    if (!level)
+        return false;
+    memcpy(level, leaves, n * sizeof(uint256));
+
+    /* each level is hashed in place, pairs of nodes are one 64 byte input */
+    while (n > 1) {
+        /* identical siblings, before an odd last node is duplicated (as Core checks it) */
+        if (mutated) {
+            for (i = 0; i + 1 < n; i += 2) {
+                if (memcmp(level + i * sizeof(uint256), level + (i + 1) * sizeof(uint256), sizeof(uint256)) == 0)
+                    *mutated = true;
+            }
+        }
+        if (n & 1) {
+            memcpy(level + n * sizeof(uint256), level + (n - 1) * sizeof(uint256), sizeof(uint256));
+            n++;
+        }
+        n /= 2;
+        sha256d64_many(level, n, level);
+    }
+
+    memcpy(out, level, sizeof(uint256));
+    free(level);
+    return true;
+}
+
+bool btc_block_header_deserialize(btc_block_header *header, const uint8_t *data, size_t len)
+{
+    struct const_buffer buf = { data, len };
+    uint32_t version;
+
+    if (!deser_u32(&version, &buf)) return false;
+    header->version = (int32_t)version;
+    if (!deser_u256(header->prev_block, &buf)) return false;
+    if (!deser_u256(header->merkle_root, &buf)) return false;
+    if (!deser_u32(&header->timestamp, &buf)) return false;
+    if (!deser_u32(&header->bits, &buf)) return false;
+    if (!deser_u32(&header->nonce, &buf)) return false;
+    return true;
+}
+
+static uint8_t* btc_block_write_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+    return p + 4;
+}
+
+void btc_block_header_serialize(const btc_block_header *header, uint8_t *out)
+{
+    uint8_t *p = btc_block_write_u32(out, (uint32_t)header->version);
+    memcpy(p, header->prev_block, 32);
+    memcpy(p + 32, header->merkle_root, 32);
+    p = btc_block_write_u32(p + 64, header->timestamp);
+    p = btc_block_write_u32(p, header->bits);
+    btc_block_write_u32(p, header->nonce);
+}
+
+void btc_block_header_hash(const btc_block_header *header, uint256 hash)
+{
+    uint8_t data[BTC_BLOCK_HEADER_SIZE];
+    btc_block_header_serialize(header, data);
+    sha256_Raw(data, sizeof(data), hash);
+    sha256_Raw(hash, SHA256_DIGEST_LENGTH, hash);
+}
+
+/* a range of transactions decoded by one thread into its own arena */
+struct btc_block_job
+{
+    btc_block *block;
+    const uint8_t *data;
+    const size_t *offsets;
+    uint256 *txids;
+    size_t first, last;
+    btc_arena *arena;
+    bool ok;
+};
+
+static void* btc_block_decode(void *arg)
+{
+    struct btc_block_job *job = arg;
+    size_t i, consumed;
+
+    for (i = job->first; i < job->last; i++) {
+        size_t len = job->offsets[i + 1] - job->offsets[i];
+        btc_tx *tx = btc_tx_deserialize_arena(job->data + job->offsets[i], len, job->arena, &consumed);
+        if (!tx || consumed != len)
+            return NULL;
+        btc_tx_hash(tx, job->txids[i]);
+        /* memoised up front, so readers of the shared block never write to a tx */
+        btc_tx_witness_hash(tx, tx->wtxid);
+        job->block->txs[i] = tx;
+    }
+    job->ok = true;
+    return NULL;
+}
+
+static unsigned int btc_block_threads(unsigned int threads, size_t tx_count)
+{
+#ifdef HAVE_PTHREAD
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (unsigned int)cpus : 1;
+    }
+    if (threads > BTC_BLOCK_MAX_THREADS)
+        threads = BTC_BLOCK_MAX_THREADS;
+    if (threads > tx_count / BTC_BLOCK_MIN_THREAD_TXS)
+        threads = (unsigned int)(tx_count / BTC_BLOCK_MIN_THREAD_TXS);
+    return threads ? threads : 1;
+#else
+    (void)threads;
+    (void)tx_count;
+    return 1;
+#endif
+}
+
+/* decode the jobs, all but the first on their own threads */
+static void btc_block_run_jobs(struct btc_block_job *jobs, unsigned int count)
+{
+    unsigned int i;
+#ifdef HAVE_PTHREAD
+    pthread_t thread[BTC_BLOCK_MAX_THREADS];
+    bool started[BTC_BLOCK_MAX_THREADS];
+
+    for (i = 1; i < count; i++)
+        started[i] = pthread_create(&thread[i], NULL, btc_block_decode, &jobs[i]) == 0;
+    btc_block_decode(&jobs[0]);
+    for (i = 1; i < count; i++) {
+        if (started[i])
+            pthread_join(thread[i], NULL);
+        else
+            btc_block_decode(&jobs[i]);
+    }
+#else
+    for (i = 0; i < count; i++)
+        btc_block_decode(&jobs[i]);
+#endif
+}
+
+btc_block* btc_block_parse(const uint8_t *data, size_t len, unsigned int threads)
+{
+    struct const_buffer buf = { data, len };
+    struct btc_block_job jobs[BTC_BLOCK_MAX_THREADS];
+    size_t *offsets = NULL;
+    uint256 *txids = NULL;
+    uint256 merkle_root;
+    bool mutated;
+    btc_block *block;
+    uint64_t count;
+    uint32_t tx_count;
+    size_t i, pos, tx_len;
+    unsigned int t;
+
+    block = calloc(1, sizeof(*block));
+    if (!block)
+        return NULL;
+    if (!btc_block_header_deserialize(&block->header, data, len))
+        goto fail;
+    btc_block_header_hash(&block->header, block->hash);
+    buf.p = data + BTC_BLOCK_HEADER_SIZE;
+    buf.len = len - BTC_BLOCK_HEADER_SIZE;
+    if (!deser_varlen64(&count, &buf))
+        goto fail;
+    if (count > buf.len / BTC_BLOCK_MIN_TX_SIZE)
+        goto fail;
+    tx_count = (uint32_t)count;
+
+    /* one pass over the lengths gives the transaction boundaries */
+    offsets = malloc((tx_count + 1) * sizeof(*offsets));
+    txids = malloc((tx_count ? tx_count : 1) * sizeof(*txids));
+    block->txs = calloc(tx_count ? tx_count : 1, sizeof(*block->txs));
+    if (!offsets || !txids || !block->txs)
+        goto fail;
+    pos = len - buf.len;
+    for (i = 0; i < tx_count; i++) {
+        offsets[i] = pos;
+        tx_len = btc_tx_skip(data + pos, len - pos);
+        if (!tx_len)
+            goto fail;
+        pos += tx_len;
+    }
+    offsets[tx_count] = pos;
+    block->size = pos;
+    block->tx_count = tx_count;
+
+    /* split the transactions into ranges of about the same size */
+    threads = btc_block_threads(threads, tx_count);
+    block->arenas = calloc(threads, sizeof(*block->arenas));
+    if (!block->arenas)
+        goto fail;
+    block->arena_count = threads;
+    for (t = 0, i = 0; t < threads; t++) {
+        size_t end = offsets[0] + (pos - offsets[0]) * (t + 1) / threads;
+        jobs[t].block = block;
+        jobs[t].data = data;
+        jobs[t].offsets = offsets;
+        jobs[t].txids = txids;
+        jobs[t].first = i;
+        while (i < tx_count && (offsets[i] < end || t + 1 == threads))
+            i++;
+        jobs[t].last = i;
+        jobs[t].ok = false;
+        /* decoded transactions take about twice their serialized size */
+        jobs[t].arena = block->arenas[t] = btc_arena_new(2 * (offsets[i] - offsets[jobs[t].first]) + 1024);
+        if (!jobs[t].arena)
+            goto fail;
+    }
+    btc_block_run_jobs(jobs, threads);
+    for (t = 0; t < threads; t++)
+        if (!jobs[t].ok)
+            goto fail;
+
+    if (!btc_merkle_root((const uint256 *)txids, tx_count, merkle_root, &mutated))
+        goto fail;
+    block->merkle_valid = !mutated && memcmp(merkle_root, block->header.merkle_root, sizeof(uint256)) == 0;
+
+    free(offsets);
+    free(txids);
+    return block;
+
+fail:
+    free(offsets);
+    free(txids);
+    btc_block_free(block);
+    return NULL;
+}
+
+void btc_block_free(btc_block *block)
+{
+    size_t i;
+
+    if (!block)
+        return;
+    for (i = 0; i < block->arena_count; i++)
+        btc_arena_free(block->arenas[i]);
+    free(block->arenas);
+    free(block->txs);
+    free(block);
+}
@@ -0,0 +1,228 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Jonas Schnelli
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#if defined HAVE_CONFIG_H
+#include "libbtc-config.h"
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#include "btc/blockfile.h"
+
+#include "serialize.h"
+
+struct btc_blockfile_
+{
+    struct const_buffer buf; /* the part not read yet */
+    const uint8_t *data;
+    size_t size;
+    uint32_t magic;
+    bool mapped; /* data is a mapping, otherwise a heap copy */
+};
+
+/* map (or read) the whole file */
+static bool btc_blockfile_load(btc_blockfile *file, int fd)
+{
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || st.st_size < 0)
+        return false;
+    file->size = (size_t)st.st_size;
+    if (file->size == 0)
+        return true;
+
+#ifdef HAVE_SYS_MMAN_H
+    void *map = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+#ifdef HAVE_MADVISE
+        madvise(map, file->size, MADV_SEQUENTIAL);
+#endif
+        file->data = map;
+        file->mapped = true;
+        return true;
+    }
+#endif
+
+    uint8_t *copy = malloc(file->size);
+    size_t done = 0;
+    if (!copy)
+        return false;
+    while (done < file->size) {
+        ssize_t n = read(fd, copy + done, file->size - done);
+        if (n <= 0) {
+            free(copy);
+            return false;
+        }
+        done += (size_t)n;
+    }
+    file->data = copy;
+    return true;
+}
+
+btc_blockfile* btc_blockfile_open(const char *path, uint32_t magic)
+{
+    btc_blockfile *file = calloc(1, sizeof(*file));
+    int fd;
+
+    if (!file)
+        return NULL;
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        free(file);
+        return NULL;
+    }
+    /* a mapping stays valid after closing the descriptor */
+    if (!btc_blockfile_load(file, fd)) {
+        close(fd);
+        free(file);
+        return NULL;
+    }
+    close(fd);
+
+    file->magic = magic;
+    file->buf.p = file->data;
+    file->buf.len = file->size;
+    return file;
+}
+
+void btc_blockfile_close(btc_blockfile *file)
+{
+    if (!file)
+        return;
+#ifdef HAVE_SYS_MMAN_H
+    if (file->mapped)
+        munmap((void *)file->data, file->size);
+    else
+#endif
+        free((void *)file->data);
+    free(file);
+}
+
+/* skip to the next occurrence of the magic (or the end) */
+static void btc_blockfile_resync(btc_blockfile *file)
+{
+    const uint8_t *p = file->buf.p;
+    const uint8_t *end = p + file->buf.len;
+    uint8_t magic[4];
+
+    magic[0] = file->magic;
+    magic[1] = file->magic >> 8;
+    magic[2] = file->magic >> 16;
+    magic[3] = file->magic >> 24;
+    for (p++; end - p >= 4; p++) {
+        p = memchr(p, magic[0], end - p - 3);
+        if (!p)
+            break;
+        if (memcmp(p, magic, 4) == 0) {
+            file->buf.len = end - p;
+            file->buf.p = p;
+            return;
+        }
+    }
+    file->buf.p = end;
+    file->buf.len = 0;
+}
+
+static void btc_blockfile_skip_zeros(btc_blockfile *file)
+{
+    const uint8_t *p = file->buf.p;
+    const uint8_t *end = p + file->buf.len;
+    uint64_t word;
+
+    while (end - p >= 8) {
+        memcpy(&word, p, 8);
+        if (word)
+            break;
+        p += 8;
+    }
+    while (p < end && *p == 0)
+        p++;
+    deser_skip(&file->buf, p - (const uint8_t *)file->buf.p);
+}
+
+bool btc_blockfile_next(btc_blockfile *file, const uint8_t **block, size_t *len, size_t *offset)
+{
+    uint32_t magic, size;
+
+    while (file->buf.len >= 8) {
+        /* bitcoin core preallocates the files with zeros */
+        if (*(const uint8_t *)file->buf.p == 0) {
+            btc_blockfile_skip_zeros(file);
+            continue;
+        }
+
+        struct const_buffer record = file->buf;
+        deser_u32(&magic, &record);
+        deser_u32(&size, &record);
+        if (magic != file->magic) {
+            btc_blockfile_resync(file);
+            continue;
+        }
+        /* truncated record (e.g. a file still being written) */
+        if (size > record.len)
+            return false;
+
+        *block = record.p;
+        *len = size;
+        if (offset)
+            *offset = (const uint8_t *)record.p - file->data;
+        deser_skip(&record, size);
+        file->buf = record;
+        return true;
+    }
+    return false;
+}
+
+void btc_blockfile_prefetch(const char *path)
+{
+#ifdef HAVE_POSIX_FADVISE
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+#else
+    (void)path;
+#endif
+}
+
+bool btc_blockfile_path(char *out, size_t outlen, const char *dir, unsigned int n)
+{
+    int written = snprintf(out, outlen, "%s/blk%05u.dat", dir, n);
+    return written >= 0 && (size_t)written < outlen;
+}
@@ -7,11 +7,14 @@
 #include "btc/btc.h"
 
 #include "random.h"
+#include "sha2.h"
 
 static secp256k1_context* secp256k1_ctx = NULL;
 
 void ecc_start(void)
 {
+    sha2_auto_detect();
+
     secp256k1_ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
     assert(secp256k1_ctx != NULL);
 
@@ -120,7 +123,7 @@ bool ecc_sign(const uint8_t *private_key, const uint8_t *hash, unsigned char *si
     if (!secp256k1_ecdsa_sign(secp256k1_ctx, &sig, hash, private_key, secp256k1_nonce_function_rfc6979, NULL))
         return false;
 
-    if (secp256k1_ecdsa_signature_serialize_der(secp256k1_ctx, sigder, outlen, &sig))
+    if (!secp256k1_ecdsa_signature_serialize_der(secp256k1_ctx, sigder, outlen, &sig))
         return false;
 
     return true;
@@ -22,9 +22,14 @@
  */
 
 
+#if defined HAVE_CONFIG_H
+#include "libbtc-config.h"
+#endif
+
 #include <string.h>
 
 #include "ripemd160.h"
+#include "sha2.h"
 
 #define ROL(x, n)   (((x) << (n)) | ((x) >> (32-(n))))
 
@@ -279,6 +284,97 @@ static void compress(uint32_t *MDbuf, uint32_t *X)
     MDbuf[0] = ddd;
 }
 
+/* multi-buffer backends, selected with the sha2 CPU features */
+#ifdef ENABLE_SSE41
+void ripemd160_Transform_4way(uint32_t *state, const uint32_t *x);
+#endif
+#ifdef ENABLE_AVX2
+void ripemd160_Transform_8way(uint32_t *state, const uint32_t *x);
+#endif
+
+static const uint32_t ripemd160_initial_state[5] = {
+    0x67452301UL, 0xefcdab89UL, 0x98badcfeUL, 0x10325476UL, 0xc3d2e1f0UL
+};
+
+static void ripemd160_compress_bytes(uint32_t *state, const uint8_t *block)
+{
+    uint32_t chunk[16];
+    int j;
+
+    for (j = 0; j < 16; ++j, block += 4) {
+        chunk[j] = (uint32_t)block[0] | ((uint32_t)block[1] << 8) |
+                   ((uint32_t)block[2] << 16) | ((uint32_t)block[3] << 24);
+    }
+    compress(state, chunk);
+}
+
+static void ripemd160_write_digest(const uint32_t *state, uint8_t *hash)
+{
+    int i;
+    for (i = 0; i < 5; ++i) {
+        *(hash++) = state[i];
+        *(hash++) = state[i] >> 8;
+        *(hash++) = state[i] >> 16;
+        *(hash++) = state[i] >> 24;
+    }
+}
+
+void ripemd160_Init(RIPEMD160_CTX *ctx)
+{
+    memcpy(ctx->state, ripemd160_initial_state, sizeof(ctx->state));
+    memset(ctx->buffer, 0, sizeof(ctx->buffer));
+    ctx->bytecount = 0;
+}
+
+void ripemd160_Update(RIPEMD160_CTX *ctx, const uint8_t *msg, size_t msg_len)
+{
+    size_t used = ctx->bytecount & 63;
+
+    ctx->bytecount += msg_len;
+    if (used) {
+        size_t fill = RIPEMD160_BLOCK_LENGTH - used;
+        if (msg_len < fill) {
+            memcpy(ctx->buffer + used, msg, msg_len);
+            return;
+        }
+        memcpy(ctx->buffer + used, msg, fill);
+        ripemd160_compress_bytes(ctx->state, ctx->buffer);
+        msg += fill;
+        msg_len -= fill;
+    }
+    for (; msg_len >= RIPEMD160_BLOCK_LENGTH; msg_len -= RIPEMD160_BLOCK_LENGTH) {
+        ripemd160_compress_bytes(ctx->state, msg);
+        msg += RIPEMD160_BLOCK_LENGTH;
+    }
+    if (msg_len) {
+        memcpy(ctx->buffer, msg, msg_len);
+    }
+}
+
+void ripemd160_Final(uint8_t hash[RIPEMD160_DIGEST_LENGTH], RIPEMD160_CTX *ctx)
+{
+    uint32_t chunk[16] = {0};
+    uint64_t bytecount = ctx->bytecount;
+    size_t used = bytecount & 63, i;
+
+    for (i = 0; i < used; ++i) {
+        chunk[i >> 2] ^= (uint32_t)ctx->buffer[i] << ((i & 3) << 3);
+    }
+    chunk[used >> 2] ^= (uint32_t)1 << (8 * (used & 3) + 7);
+
+    if (used > 55) {
+        compress(ctx->state, chunk);
+        memset(chunk, 0, 64);
+    }
+
+    chunk[14] = (uint32_t)(bytecount << 3);
+    chunk[15] = (uint32_t)(bytecount >> 29);
+    compress(ctx->state, chunk);
+
+    ripemd160_write_digest(ctx->state, hash);
+    memset(ctx, 0, sizeof(*ctx));
+}
+
 void ripemd160(const uint8_t *msg, uint32_t msg_len, uint8_t *hash)
 {
     uint32_t i;
@@ -318,10 +414,120 @@ void ripemd160(const uint8_t *msg, uint32_t msg_len, uint8_t *hash)
         compress (digest, chunk);
     }
 
-    for (i = 0; i < 5; ++i) {
-        *(hash++) = digest[i];
-        *(hash++) = digest[i] >> 8;
-        *(hash++) = digest[i] >> 16;
-        *(hash++) = digest[i] >> 24;
+    ripemd160_write_digest(digest, hash);
+}
+
+/* ripemd160 of a 32 byte digest, a single pre-padded block */
+static void ripemd160_digest32(const uint8_t *digest, uint8_t hash[RIPEMD160_DIGEST_LENGTH])
+{
+    uint32_t state[5], chunk[16];
+    int j;
+
+    /* the 32 byte digest, the padding bit and a bit length of 256 */
+    for (j = 0; j < 8; ++j) {
+        chunk[j] = (uint32_t)digest[4 * j] | ((uint32_t)digest[4 * j + 1] << 8) |
+                   ((uint32_t)digest[4 * j + 2] << 16) | ((uint32_t)digest[4 * j + 3] << 24);
+    }
+    chunk[8] = 0x80;
+    memset(&chunk[9], 0, 5 * sizeof(uint32_t));
+    chunk[14] = SHA256_DIGEST_LENGTH << 3;
+    chunk[15] = 0;
+
+    memcpy(state, ripemd160_initial_state, sizeof(state));
+    compress(state, chunk);
+    ripemd160_write_digest(state, hash);
+}
+
+void btc_hash160(const uint8_t *data, size_t len, uint8_t hash[RIPEMD160_DIGEST_LENGTH])
+{
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+
+    sha256_Raw(data, len, digest);
+    ripemd160_digest32(digest, hash);
+    memset(digest, 0, sizeof(digest));
+}
+
+#define HASH160_MAX_LANES 8
+#define HASH160_BATCH 64
+
+/* hash lanes 32 byte digests with one multi-buffer ripemd160 block */
+static void ripemd160_digest32_lanes(void (*transform)(uint32_t *, const uint32_t *), size_t lanes,
+                                     uint8_t (*digests)[SHA256_DIGEST_LENGTH],
+                                     uint8_t (*out)[RIPEMD160_DIGEST_LENGTH])
+{
+    uint32_t state[5 * HASH160_MAX_LANES], x[16 * HASH160_MAX_LANES];
+    size_t lane;
+    int j;
+
+    memset(x, 0, sizeof(x));
+    for (lane = 0; lane < lanes; lane++) {
+        const uint8_t *d = digests[lane];
+        for (j = 0; j < 8; j++, d += 4) {
+            x[lanes * j + lane] = (uint32_t)d[0] | ((uint32_t)d[1] << 8) |
+                                  ((uint32_t)d[2] << 16) | ((uint32_t)d[3] << 24);
+        }
+        x[lanes * 8 + lane] = 0x80;
+        x[lanes * 14 + lane] = SHA256_DIGEST_LENGTH << 3;
+        for (j = 0; j < 5; j++) {
+            state[lanes * j + lane] = ripemd160_initial_state[j];
+        }
+    }
+    transform(state, x);
+    for (lane = 0; lane < lanes; lane++) {
+        uint8_t *h = out[lane];
+        for (j = 0; j < 5; j++) {
+            uint32_t w = state[lanes * j + lane];
+            *(h++) = w;
+            *(h++) = w >> 8;
+            *(h++) = w >> 16;
+            *(h++) = w >> 24;
+        }
+    }
+}
+
+void btc_hash160_many(const uint8_t pubkeys[][33], size_t n, uint8_t out[][RIPEMD160_DIGEST_LENGTH])
+{
+    const uint8_t *msgs[HASH160_BATCH];
+    size_t lens[HASH160_BATCH];
+    uint8_t digests[HASH160_BATCH][SHA256_DIGEST_LENGTH];
+    void (*transform)(uint32_t *, const uint32_t *) = NULL;
+    size_t lanes = 0, done, batch, i;
+#if defined(ENABLE_SSE41) || defined(ENABLE_AVX2)
+    uint32_t features = sha2_get_features();
+#endif
+
+#ifdef ENABLE_SSE41
+    if (features & SHA2_CPU_SSE41) {
+        transform = ripemd160_Transform_4way;
+        lanes = 4;
+    }
+#endif
+#ifdef ENABLE_AVX2
+    if (features & SHA2_CPU_AVX2) {
+        transform = ripemd160_Transform_8way;
+        lanes = 8;
+    }
+#endif
+
+    for (done = 0; done < n; done += batch) {
+        batch = n - done < HASH160_BATCH ? n - done : HASH160_BATCH;
+
+        /* sha256 with the fastest available (multi-buffer) code */
+        for (i = 0; i < batch; i++) {
+            msgs[i] = pubkeys[done + i];
+            lens[i] = 33;
+        }
+        sha256_Raw_many(msgs, lens, batch, digests);
+
+        i = 0;
+        if (transform) {
+            for (; i + lanes <= batch; i += lanes) {
+                ripemd160_digest32_lanes(transform, lanes, digests + i, out + done + i);
+            }
+        }
+        for (; i < batch; i++) {
+            ripemd160_digest32(digests[i], out[done + i]);
+        }
     }
+    memset(digests, 0, sizeof(digests));
 }
@@ -26,7 +26,25 @@
 #define __RIPEMD160_H__
 
 #include <stdint.h>
+#include <stddef.h>
 
+#define RIPEMD160_BLOCK_LENGTH   64
+#define RIPEMD160_DIGEST_LENGTH  20
+
+typedef struct _RIPEMD160_CTX {
+    uint32_t    state[5];
+    uint64_t    bytecount;
+    uint8_t     buffer[RIPEMD160_BLOCK_LENGTH];
+} RIPEMD160_CTX;
+
+void ripemd160_Init(RIPEMD160_CTX *ctx);
+void ripemd160_Update(RIPEMD160_CTX *ctx, const uint8_t *msg, size_t msg_len);
+void ripemd160_Final(uint8_t hash[RIPEMD160_DIGEST_LENGTH], RIPEMD160_CTX *ctx);
 void ripemd160(const uint8_t *msg, uint32_t msg_len, uint8_t *hash);
 
+/* ripemd160(sha256(data)), hashing the sha256 digest as one pre-padded block */
+void btc_hash160(const uint8_t *data, size_t len, uint8_t hash[RIPEMD160_DIGEST_LENGTH]);
+/* hash160 of n compressed public keys, 4 or 8 at a time with SSE4.1/AVX2 */
+void btc_hash160_many(const uint8_t pubkeys[][33], size_t n, uint8_t out[][RIPEMD160_DIGEST_LENGTH]);
+
 #endif
@@ -0,0 +1,282 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Jonas Schnelli
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+/*
+ * 8-way RIPEMD-160 compression function using AVX2. Each 32-bit lane of
+ * the vectors holds the state of an independent message. This file is
+ * compiled with -mavx -mavx2 and must only be called after
+ * sha2_auto_detect() has confirmed CPU and OS support.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <immintrin.h>
+
+#include "ripemd160.h"
+
+#define ADD(a, b)       _mm256_add_epi32((a), (b))
+#define XOR(a, b)       _mm256_xor_si256((a), (b))
+#define AND(a, b)       _mm256_and_si256((a), (b))
+#define OR(a, b)        _mm256_or_si256((a), (b))
+#define NOT(x)          XOR((x), _mm256_set1_epi32(-1))
+#define ROL(x, n)       OR(_mm256_slli_epi32((x), (n)), _mm256_srli_epi32((x), 32 - (n)))
+#define K(k)            _mm256_set1_epi32((int)(k))
+
+#define F(x, y, z)      XOR((x), XOR((y), (z)))
+#define G(x, y, z)      XOR((z), AND((x), XOR((y), (z))))
+#define H(x, y, z)      XOR(OR((x), NOT(y)), (z))
+#define IQ(x, y, z)     XOR((y), AND((z), XOR((x), (y))))
+#define J(x, y, z)      XOR((x), OR((y), NOT(z)))
+
+#define STEP(f, a, b, c, d, e, x, s, k) do { \
+    (a) = ADD(ADD((a), f((b), (c), (d))), ADD((x), K(k))); \
+    (a) = ADD(ROL((a), (s)), (e)); \
+    (c) = ROL((c), 10); \
+} while (0)
+
+#define FF(a, b, c, d, e, x, s)     STEP(F, a, b, c, d, e, x, s, 0)
+#define GG(a, b, c, d, e, x, s)     STEP(G, a, b, c, d, e, x, s, 0x5a827999UL)
+#define HH(a, b, c, d, e, x, s)     STEP(H, a, b, c, d, e, x, s, 0x6ed9eba1UL)
+#define II(a, b, c, d, e, x, s)     STEP(IQ, a, b, c, d, e, x, s, 0x8f1bbcdcUL)
+#define JJ(a, b, c, d, e, x, s)     STEP(J, a, b, c, d, e, x, s, 0xa953fd4eUL)
+#define FFF(a, b, c, d, e, x, s)    STEP(F, a, b, c, d, e, x, s, 0)
+#define GGG(a, b, c, d, e, x, s)    STEP(G, a, b, c, d, e, x, s, 0x7a6d76e9UL)
+#define HHH(a, b, c, d, e, x, s)    STEP(H, a, b, c, d, e, x, s, 0x6d703ef3UL)
+#define III(a, b, c, d, e, x, s)    STEP(IQ, a, b, c, d, e, x, s, 0x5c4dd124UL)
+#define JJJ(a, b, c, d, e, x, s)    STEP(J, a, b, c, d, e, x, s, 0x50a28be6UL)
+
+/* state and message words are interleaved: state[8 * i + lane], x[8 * j + lane] */
+void ripemd160_Transform_8way(uint32_t *state, const uint32_t *x)
+{
+    __m256i X[16], h[5];
+    __m256i aa, bb, cc, dd, ee, aaa, bbb, ccc, ddd, eee;
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        X[i] = _mm256_loadu_si256((const __m256i *)&x[8 * i]);
+    }
+    for (i = 0; i < 5; i++) {
+        h[i] = _mm256_loadu_si256((const __m256i *)&state[8 * i]);
+    }
+    aa = aaa = h[0];
+    bb = bbb = h[1];
+    cc = ccc = h[2];
+    dd = ddd = h[3];
+    ee = eee = h[4];
+
+    /* round 1 */
+    FF(aa, bb, cc, dd, ee, X[0], 11);
+    FF(ee, aa, bb, cc, dd, X[1], 14);
+    FF(dd, ee, aa, bb, cc, X[2], 15);
+    FF(cc, dd, ee, aa, bb, X[3], 12);
+    FF(bb, cc, dd, ee, aa, X[4],  5);
+    FF(aa, bb, cc, dd, ee, X[5],  8);
+    FF(ee, aa, bb, cc, dd, X[6],  7);
+    FF(dd, ee, aa, bb, cc, X[7],  9);
+    FF(cc, dd, ee, aa, bb, X[8], 11);
+    FF(bb, cc, dd, ee, aa, X[9], 13);
+    FF(aa, bb, cc, dd, ee, X[10], 14);
+    FF(ee, aa, bb, cc, dd, X[11], 15);
+    FF(dd, ee, aa, bb, cc, X[12],  6);
+    FF(cc, dd, ee, aa, bb, X[13],  7);
+    FF(bb, cc, dd, ee, aa, X[14],  9);
+    FF(aa, bb, cc, dd, ee, X[15],  8);
+
+    /* round 2 */
+    GG(ee, aa, bb, cc, dd, X[7],  7);
+    GG(dd, ee, aa, bb, cc, X[4],  6);
+    GG(cc, dd, ee, aa, bb, X[13],  8);
+    GG(bb, cc, dd, ee, aa, X[1], 13);
+    GG(aa, bb, cc, dd, ee, X[10], 11);
+    GG(ee, aa, bb, cc, dd, X[6],  9);
+    GG(dd, ee, aa, bb, cc, X[15],  7);
+    GG(cc, dd, ee, aa, bb, X[3], 15);
+    GG(bb, cc, dd, ee, aa, X[12],  7);
+    GG(aa, bb, cc, dd, ee, X[0], 12);
+    GG(ee, aa, bb, cc, dd, X[9], 15);
+    GG(dd, ee, aa, bb, cc, X[5],  9);
+    GG(cc, dd, ee, aa, bb, X[2], 11);
+    GG(bb, cc, dd, ee, aa, X[14],  7);
+    GG(aa, bb, cc, dd, ee, X[11], 13);
+    GG(ee, aa, bb, cc, dd, X[8], 12);
+
+    /* round 3 */
+    HH(dd, ee, aa, bb, cc, X[3], 11);
+    HH(cc, dd, ee, aa, bb, X[10], 13);
+    HH(bb, cc, dd, ee, aa, X[14],  6);
+    HH(aa, bb, cc, dd, ee, X[4],  7);
+    HH(ee, aa, bb, cc, dd, X[9], 14);
+    HH(dd, ee, aa, bb, cc, X[15],  9);
+    HH(cc, dd, ee, aa, bb, X[8], 13);
+    HH(bb, cc, dd, ee, aa, X[1], 15);
+    HH(aa, bb, cc, dd, ee, X[2], 14);
+    HH(ee, aa, bb, cc, dd, X[7],  8);
+    HH(dd, ee, aa, bb, cc, X[0], 13);
+    HH(cc, dd, ee, aa, bb, X[6],  6);
+    HH(bb, cc, dd, ee, aa, X[13],  5);
+    HH(aa, bb, cc, dd, ee, X[11], 12);
+    HH(ee, aa, bb, cc, dd, X[5],  7);
+    HH(dd, ee, aa, bb, cc, X[12],  5);
+
+    /* round 4 */
+    II(cc, dd, ee, aa, bb, X[1], 11);
+    II(bb, cc, dd, ee, aa, X[9], 12);
+    II(aa, bb, cc, dd, ee, X[11], 14);
+    II(ee, aa, bb, cc, dd, X[10], 15);
+    II(dd, ee, aa, bb, cc, X[0], 14);
+    II(cc, dd, ee, aa, bb, X[8], 15);
+    II(bb, cc, dd, ee, aa, X[12],  9);
+    II(aa, bb, cc, dd, ee, X[4],  8);
+    II(ee, aa, bb, cc, dd, X[13],  9);
+    II(dd, ee, aa, bb, cc, X[3], 14);
+    II(cc, dd, ee, aa, bb, X[7],  5);
+    II(bb, cc, dd, ee, aa, X[15],  6);
+    II(aa, bb, cc, dd, ee, X[14],  8);
+    II(ee, aa, bb, cc, dd, X[5],  6);
+    II(dd, ee, aa, bb, cc, X[6],  5);
+    II(cc, dd, ee, aa, bb, X[2], 12);
+
+    /* round 5 */
+    JJ(bb, cc, dd, ee, aa, X[4],  9);
+    JJ(aa, bb, cc, dd, ee, X[0], 15);
+    JJ(ee, aa, bb, cc, dd, X[5],  5);
+    JJ(dd, ee, aa, bb, cc, X[9], 11);
+    JJ(cc, dd, ee, aa, bb, X[7],  6);
+    JJ(bb, cc, dd, ee, aa, X[12],  8);
+    JJ(aa, bb, cc, dd, ee, X[2], 13);
+    JJ(ee, aa, bb, cc, dd, X[10], 12);
+    JJ(dd, ee, aa, bb, cc, X[14],  5);
+    JJ(cc, dd, ee, aa, bb, X[1], 12);
+    JJ(bb, cc, dd, ee, aa, X[3], 13);
+    JJ(aa, bb, cc, dd, ee, X[8], 14);
+    JJ(ee, aa, bb, cc, dd, X[11], 11);
+    JJ(dd, ee, aa, bb, cc, X[6],  8);
+    JJ(cc, dd, ee, aa, bb, X[15],  5);
+    JJ(bb, cc, dd, ee, aa, X[13],  6);
+
+    /* parallel round 1 */
+    JJJ(aaa, bbb, ccc, ddd, eee, X[5],  8);
+    JJJ(eee, aaa, bbb, ccc, ddd, X[14],  9);
+    JJJ(ddd, eee, aaa, bbb, ccc, X[7],  9);
+    JJJ(ccc, ddd, eee, aaa, bbb, X[0], 11);
+    JJJ(bbb, ccc, ddd, eee, aaa, X[9], 13);
+    JJJ(aaa, bbb, ccc, ddd, eee, X[2], 15);
+    JJJ(eee, aaa, bbb, ccc, ddd, X[11], 15);
+    JJJ(ddd, eee, aaa, bbb, ccc, X[4],  5);
+    JJJ(ccc, ddd, eee, aaa, bbb, X[13],  7);
+    JJJ(bbb, ccc, ddd, eee, aaa, X[6],  7);
+    JJJ(aaa, bbb, ccc, ddd, eee, X[15],  8);
+    JJJ(eee, aaa, bbb, ccc, ddd, X[8], 11);
+    JJJ(ddd, eee, aaa, bbb, ccc, X[1], 14);
+    JJJ(ccc, ddd, eee, aaa, bbb, X[10], 14);
+    JJJ(bbb, ccc, ddd, eee, aaa, X[3], 12);
+    JJJ(aaa, bbb, ccc, ddd, eee, X[12],  6);
+
+    /* parallel round 2 */
+    III(eee, aaa, bbb, ccc, ddd, X[6],  9);
+    III(ddd, eee, aaa, bbb, ccc, X[11], 13);
+    III(ccc, ddd, eee, aaa, bbb, X[3], 15);
+    III(bbb, ccc, ddd, eee, aaa, X[7],  7);
+    III(aaa, bbb, ccc, ddd, eee, X[0], 12);
+    III(eee, aaa, bbb, ccc, ddd, X[13],  8);
+    III(ddd, eee, aaa, bbb, ccc, X[5],  9);
+    III(ccc, ddd, eee, aaa, bbb, X[10], 11);
+    III(bbb, ccc, ddd, eee, aaa, X[14],  7);
+    III(aaa, bbb, ccc, ddd, eee, X[15],  7);
+    III(eee, aaa, bbb, ccc, ddd, X[8], 12);
+    III(ddd, eee, aaa, bbb, ccc, X[12],  7);
+    III(ccc, ddd, eee, aaa, bbb, X[4],  6);
+    III(bbb, ccc, ddd, eee, aaa, X[9], 15);
+    III(aaa, bbb, ccc, ddd, eee, X[1], 13);
+    III(eee, aaa, bbb, ccc, ddd, X[2], 11);
+
+    /* parallel round 3 */
+    HHH(ddd, eee, aaa, bbb, ccc, X[15],  9);
+    HHH(ccc, ddd, eee, aaa, bbb, X[5],  7);
+    HHH(bbb, ccc, ddd, eee, aaa, X[1], 15);
+    HHH(aaa, bbb, ccc, ddd, eee, X[3], 11);
+    HHH(eee, aaa, bbb, ccc, ddd, X[7],  8);
+    HHH(ddd, eee, aaa, bbb, ccc, X[14],  6);
+    HHH(ccc, ddd, eee, aaa, bbb, X[6],  6);
+    HHH(bbb, ccc, ddd, eee, aaa, X[9], 14);
+    HHH(aaa, bbb, ccc, ddd, eee, X[11], 12);
+    HHH(eee, aaa, bbb, ccc, ddd, X[8], 13);
+    HHH(ddd, eee, aaa, bbb, ccc, X[12],  5);
+    HHH(ccc, ddd, eee, aaa, bbb, X[2], 14);
+    HHH(bbb, ccc, ddd, eee, aaa, X[10], 13);
+    HHH(aaa, bbb, ccc, ddd, eee, X[0], 13);
+    HHH(eee, aaa, bbb, ccc, ddd, X[4],  7);
+    HHH(ddd, eee, aaa, bbb, ccc, X[13],  5);
+
+    /* parallel round 4 */
+    GGG(ccc, ddd, eee, aaa, bbb, X[8], 15);
+    GGG(bbb, ccc, ddd, eee, aaa, X[6],  5);
+    GGG(aaa, bbb, ccc, ddd, eee, X[4],  8);
+    GGG(eee, aaa, bbb, ccc, ddd, X[1], 11);
+    GGG(ddd, eee, aaa, bbb, ccc, X[3], 14);
+    GGG(ccc, ddd, eee, aaa, bbb, X[11], 14);
+    GGG(bbb, ccc, ddd, eee, aaa, X[15],  6);
+    GGG(aaa, bbb, ccc, ddd, eee, X[0], 14);
+    GGG(eee, aaa, bbb, ccc, ddd, X[5],  6);
+    GGG(ddd, eee, aaa, bbb, ccc, X[12],  9);
+    GGG(ccc, ddd, eee, aaa, bbb, X[2], 12);
+    GGG(bbb, ccc, ddd, eee, aaa, X[13],  9);
+    GGG(aaa, bbb, ccc, ddd, eee, X[9], 12);
+    GGG(eee, aaa, bbb, ccc, ddd, X[7],  5);
+    GGG(ddd, eee, aaa, bbb, ccc, X[10], 15);
+    GGG(ccc, ddd, eee, aaa, bbb, X[14],  8);
+
+    /* parallel round 5 */
+    FFF(bbb, ccc, ddd, eee, aaa, X[12] ,  8);
+    FFF(aaa, bbb, ccc, ddd, eee, X[15] ,  5);
+    FFF(eee, aaa, bbb, ccc, ddd, X[10] , 12);
+    FFF(ddd, eee, aaa, bbb, ccc, X[4] ,  9);
+    FFF(ccc, ddd, eee, aaa, bbb, X[1] , 12);
+    FFF(bbb, ccc, ddd, eee, aaa, X[5] ,  5);
+    FFF(aaa, bbb, ccc, ddd, eee, X[8] , 14);
+    FFF(eee, aaa, bbb, ccc, ddd, X[7] ,  6);
+    FFF(ddd, eee, aaa, bbb, ccc, X[6] ,  8);
+    FFF(ccc, ddd, eee, aaa, bbb, X[2] , 13);
+    FFF(bbb, ccc, ddd, eee, aaa, X[13] ,  6);
+    FFF(aaa, bbb, ccc, ddd, eee, X[14] ,  5);
+    FFF(eee, aaa, bbb, ccc, ddd, X[0] , 15);
+    FFF(ddd, eee, aaa, bbb, ccc, X[3] , 13);
+    FFF(ccc, ddd, eee, aaa, bbb, X[9] , 11);
+    FFF(bbb, ccc, ddd, eee, aaa, X[11] , 11);
+
+    /* combine results */
+    ddd = ADD(ddd, ADD(cc, h[1]));
+    h[1] = ADD(h[2], ADD(dd, eee));
+    h[2] = ADD(h[3], ADD(ee, aaa));
+    h[3] = ADD(h[4], ADD(aa, bbb));
+    h[4] = ADD(h[0], ADD(bb, ccc));
+    h[0] = ddd;
+
+    for (i = 0; i < 5; i++) {
+        _mm256_storeu_si256((__m256i *)&state[8 * i], h[i]);
+    }
+    _mm256_zeroupper();
+}
@@ -174,6 +174,34 @@ bool deser_varlen(uint32_t *lo, struct const_buffer *buf)
 	return true;
 }
 
+/* like deser_varlen, without truncating the 0xff form */
+bool deser_varlen64(uint64_t *lo, struct const_buffer *buf)
+{
+	uint64_t len;
+
+	unsigned char c;
+	if (!deser_bytes(&c, buf, 1)) return false;
+
+	if (c == 253) {
+		uint16_t v16;
+		if (!deser_u16(&v16, buf)) return false;
+		len = v16;
+	}
+	else if (c == 254) {
+		uint32_t v32;
+		if (!deser_u32(&v32, buf)) return false;
+		len = v32;
+	}
+	else if (c == 255) {
+		if (!deser_u64(&len, buf)) return false;
+	}
+	else
+		len = c;
+
+	*lo = len;
+	return true;
+}
+
 bool deser_str(char *so, struct const_buffer *buf, size_t maxlen)
 {
 	uint32_t len;
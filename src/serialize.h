@@ -75,6 +75,7 @@ static inline bool deser_u256(uint8_t *vo, struct const_buffer *buf)
 }
 
 extern bool deser_varlen(uint32_t *lo, struct const_buffer *buf);
+extern bool deser_varlen64(uint64_t *lo, struct const_buffer *buf);
 extern bool deser_str(char *so, struct const_buffer *buf, size_t maxlen);
 extern bool deser_varstr(cstring **so, struct const_buffer *buf);
 
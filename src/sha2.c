@@ -29,10 +29,20 @@
  * SUCH DAMAGE.
  */
 
+#if defined HAVE_CONFIG_H
+#include "libbtc-config.h"
+#endif
+
 #include <string.h>
 #include <stdint.h>
 #include "sha2.h"
 
+#if (defined(ENABLE_SHANI) || defined(ENABLE_SSE41) || defined(ENABLE_AVX2)) && \
+    defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define SHA2_HAVE_CPUID 1
+#endif
+
 /*
  * ASSERT NOTE:
  * Some sanity checking code is included using assert().  On my FreeBSD
@@ -179,10 +189,36 @@ void sha512_Last(SHA512_CTX *);
 void sha256_Transform(SHA256_CTX *, const sha2_word32 *);
 void sha512_Transform(SHA512_CTX *, const sha2_word64 *);
 
+/* Compression function backends, processing one or more full blocks */
+typedef void (*sha256_transform_fn)(sha2_word32 *, const sha2_byte *, size_t);
+static void sha256_Transform_generic(sha2_word32 *, const sha2_byte *, size_t);
+#ifdef ENABLE_SHANI
+void sha256_Transform_shani(sha2_word32 *, const sha2_byte *, size_t);
+#endif
+
+/* Multi-buffer backends, one block per lane with an interleaved state */
+#define SHA256_MAX_LANES 8
+typedef void (*sha256_transform_many_fn)(sha2_word32 *, const sha2_byte *const *);
+#ifdef ENABLE_SSE41
+void sha256_Transform_4way(sha2_word32 *, const sha2_byte *const *);
+#endif
+#ifdef ENABLE_AVX2
+void sha256_Transform_8way(sha2_word32 *, const sha2_byte *const *);
+#endif
+
+typedef void (*sha512_transform_fn)(sha2_word64 *, const sha2_byte *, size_t);
+static void sha512_Transform_generic(sha2_word64 *, const sha2_byte *, size_t);
+#define SHA512_MAX_LANES 4
+typedef void (*sha512_transform_many_fn)(sha2_word64 *, const sha2_byte *const *);
+#ifdef ENABLE_AVX2
+void sha512_Transform_avx2(sha2_word64 *, const sha2_byte *, size_t);
+void sha512_Transform_4way(sha2_word64 *, const sha2_byte *const *);
+#endif
+
 
 /*** SHA-XYZ INITIAL HASH VALUES AND CONSTANTS ************************/
 /* Hash constant words K for SHA-256: */
-static const sha2_word32 K256[64] = {
+const sha2_word32 sha256_K[64] = {
     0x428a2f98UL, 0x71374491UL, 0xb5c0fbcfUL, 0xe9b5dba5UL,
     0x3956c25bUL, 0x59f111f1UL, 0x923f82a4UL, 0xab1c5ed5UL,
     0xd807aa98UL, 0x12835b01UL, 0x243185beUL, 0x550c7dc3UL,
@@ -214,7 +250,7 @@ static const sha2_word32 sha256_initial_hash_value[8] = {
 };
 
 /* Hash constant words K for SHA-384 and SHA-512: */
-static const sha2_word64 K512[80] = {
+const sha2_word64 sha512_K[80] = {
     0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL,
     0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
     0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
@@ -290,7 +326,7 @@ void sha256_Init(SHA256_CTX *context)
 #define ROUND256_0_TO_15(a,b,c,d,e,f,g,h)   \
     REVERSE32(*data++, W256[j]); \
     T1 = (h) + Sigma1_256(e) + Ch((e), (f), (g)) + \
-             K256[j] + W256[j]; \
+             sha256_K[j] + W256[j]; \
     (d) += T1; \
     (h) = T1 + Sigma0_256(a) + Maj((a), (b), (c)); \
     j++
@@ -300,7 +336,7 @@ void sha256_Init(SHA256_CTX *context)
 
 #define ROUND256_0_TO_15(a,b,c,d,e,f,g,h)   \
     T1 = (h) + Sigma1_256(e) + Ch((e), (f), (g)) + \
-         K256[j] + (W256[j] = *data++); \
+         sha256_K[j] + (W256[j] = *data++); \
     (d) += T1; \
     (h) = T1 + Sigma0_256(a) + Maj((a), (b), (c)); \
     j++
@@ -312,29 +348,27 @@ void sha256_Init(SHA256_CTX *context)
     s0 = sigma0_256(s0); \
     s1 = W256[(j+14)&0x0f]; \
     s1 = sigma1_256(s1); \
-    T1 = (h) + Sigma1_256(e) + Ch((e), (f), (g)) + K256[j] + \
+    T1 = (h) + Sigma1_256(e) + Ch((e), (f), (g)) + sha256_K[j] + \
          (W256[j&0x0f] += s1 + W256[(j+9)&0x0f] + s0); \
     (d) += T1; \
     (h) = T1 + Sigma0_256(a) + Maj((a), (b), (c)); \
     j++
 
-void sha256_Transform(SHA256_CTX *context, const sha2_word32 *data)
+static void sha256_Transform_block(sha2_word32 *state, const sha2_word32 *data)
 {
     sha2_word32 a, b, c, d, e, f, g, h, s0, s1;
-    sha2_word32 T1, *W256;
+    sha2_word32 T1, W256[16];
     int     j;
 
-    W256 = (sha2_word32 *)context->buffer;
-
     /* Initialize registers with the prev. intermediate value */
-    a = context->state[0];
-    b = context->state[1];
-    c = context->state[2];
-    d = context->state[3];
-    e = context->state[4];
-    f = context->state[5];
-    g = context->state[6];
-    h = context->state[7];
+    a = state[0];
+    b = state[1];
+    c = state[2];
+    d = state[3];
+    e = state[4];
+    f = state[5];
+    g = state[6];
+    h = state[7];
 
     j = 0;
     do {
@@ -362,14 +396,14 @@ void sha256_Transform(SHA256_CTX *context, const sha2_word32 *data)
     } while (j < 64);
 
     /* Compute the current intermediate hash value */
-    context->state[0] += a;
-    context->state[1] += b;
-    context->state[2] += c;
-    context->state[3] += d;
-    context->state[4] += e;
-    context->state[5] += f;
-    context->state[6] += g;
-    context->state[7] += h;
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
 
     /* Clean up */
     a = b = c = d = e = f = g = h = T1 = 0;
@@ -377,23 +411,21 @@ void sha256_Transform(SHA256_CTX *context, const sha2_word32 *data)
 
 #else /* SHA2_UNROLL_TRANSFORM */
 
-void sha256_Transform(SHA256_CTX *context, const sha2_word32 *data)
+static void sha256_Transform_block(sha2_word32 *state, const sha2_word32 *data)
 {
     sha2_word32 a, b, c, d, e, f, g, h, s0, s1;
-    sha2_word32 T1, T2, *W256;
+    sha2_word32 T1, T2, W256[16];
     int     j;
 
-    W256 = (sha2_word32 *)context->buffer;
-
     /* Initialize registers with the prev. intermediate value */
-    a = context->state[0];
-    b = context->state[1];
-    c = context->state[2];
-    d = context->state[3];
-    e = context->state[4];
-    f = context->state[5];
-    g = context->state[6];
-    h = context->state[7];
+    a = state[0];
+    b = state[1];
+    c = state[2];
+    d = state[3];
+    e = state[4];
+    f = state[5];
+    g = state[6];
+    h = state[7];
 
     j = 0;
     do {
@@ -401,10 +433,10 @@ void sha256_Transform(SHA256_CTX *context, const sha2_word32 *data)
         /* Copy data while converting to host byte order */
         REVERSE32(*data++, W256[j]);
         /* Apply the SHA-256 compression function to update a..h */
-        T1 = h + Sigma1_256(e) + Ch(e, f, g) + K256[j] + W256[j];
+        T1 = h + Sigma1_256(e) + Ch(e, f, g) + sha256_K[j] + W256[j];
 #else /* BYTE_ORDER == LITTLE_ENDIAN */
         /* Apply the SHA-256 compression function to update a..h with copy */
-        T1 = h + Sigma1_256(e) + Ch(e, f, g) + K256[j] + (W256[j] = *data++);
+        T1 = h + Sigma1_256(e) + Ch(e, f, g) + sha256_K[j] + (W256[j] = *data++);
 #endif /* BYTE_ORDER == LITTLE_ENDIAN */
         T2 = Sigma0_256(a) + Maj(a, b, c);
         h = g;
@@ -427,7 +459,7 @@ void sha256_Transform(SHA256_CTX *context, const sha2_word32 *data)
         s1 = sigma1_256(s1);
 
         /* Apply the SHA-256 compression function to update a..h */
-        T1 = h + Sigma1_256(e) + Ch(e, f, g) + K256[j] +
+        T1 = h + Sigma1_256(e) + Ch(e, f, g) + sha256_K[j] +
              (W256[j & 0x0f] += s1 + W256[(j + 9) & 0x0f] + s0);
         T2 = Sigma0_256(a) + Maj(a, b, c);
         h = g;
@@ -443,14 +475,14 @@ void sha256_Transform(SHA256_CTX *context, const sha2_word32 *data)
     } while (j < 64);
 
     /* Compute the current intermediate hash value */
-    context->state[0] += a;
-    context->state[1] += b;
-    context->state[2] += c;
-    context->state[3] += d;
-    context->state[4] += e;
-    context->state[5] += f;
-    context->state[6] += g;
-    context->state[7] += h;
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
 
     /* Clean up */
     a = b = c = d = e = f = g = h = T1 = T2 = 0;
@@ -458,6 +490,128 @@ void sha256_Transform(SHA256_CTX *context, const sha2_word32 *data)
 
 #endif /* SHA2_UNROLL_TRANSFORM */
 
+static void sha256_Transform_generic(sha2_word32 *state, const sha2_byte *data, size_t blocks)
+{
+    for (; blocks > 0; blocks--, data += SHA256_BLOCK_LENGTH) {
+        sha256_Transform_block(state, (const sha2_word32 *)data);
+    }
+}
+
+static sha256_transform_fn sha256_transform = sha256_Transform_generic;
+static sha256_transform_many_fn sha256_transform_many = NULL;
+static size_t sha256_many_lanes = 0;
+static sha512_transform_fn sha512_transform = sha512_Transform_generic;
+static sha512_transform_many_fn sha512_transform_many = NULL;
+static size_t sha512_many_lanes = 0;
+static uint32_t sha2_features_cpu = 0;
+static uint32_t sha2_features_active = 0;
+static int sha2_features_detected = 0;
+
+static uint32_t sha2_detect_cpu(void)
+{
+    uint32_t features = 0;
+#ifdef SHA2_HAVE_CPUID
+    unsigned int eax, ebx, ecx, edx;
+    int have_sse41 = 0, have_ssse3 = 0, have_avx = 0;
+
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        have_ssse3 = (ecx >> 9) & 1;
+        have_sse41 = (ecx >> 19) & 1;
+        /* AVX also requires the OS to save the ymm registers (XCR0) */
+        if (((ecx >> 27) & 1) && ((ecx >> 28) & 1)) {
+            uint32_t xcr0_lo, xcr0_hi;
+            __asm__ ("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+            have_avx = (xcr0_lo & 6) == 6;
+        }
+    }
+#ifdef ENABLE_SSE41
+    if (have_ssse3 && have_sse41) {
+        features |= SHA2_CPU_SSE41;
+    }
+#endif
+    if (__get_cpuid_max(0, NULL) >= 7) {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+#ifdef ENABLE_SHANI
+        if (((ebx >> 29) & 1) && have_ssse3 && have_sse41) {
+            features |= SHA2_CPU_SHANI;
+        }
+#endif
+#ifdef ENABLE_AVX2
+        if (((ebx >> 5) & 1) && have_avx) {
+            features |= SHA2_CPU_AVX2;
+        }
+#endif
+    }
+    (void)have_avx;
+#endif
+    return features;
+}
+
+uint32_t sha2_set_features(uint32_t features)
+{
+    if (!sha2_features_detected) {
+        sha2_features_cpu = sha2_detect_cpu();
+        sha2_features_detected = 1;
+    }
+    features &= sha2_features_cpu;
+
+    sha256_transform = sha256_Transform_generic;
+#ifdef ENABLE_SHANI
+    if (features & SHA2_CPU_SHANI) {
+        sha256_transform = sha256_Transform_shani;
+    }
+#endif
+
+    sha512_transform = sha512_Transform_generic;
+    sha512_transform_many = NULL;
+    sha512_many_lanes = 0;
+#ifdef ENABLE_AVX2
+    if (features & SHA2_CPU_AVX2) {
+        sha512_transform = sha512_Transform_avx2;
+        sha512_transform_many = sha512_Transform_4way;
+        sha512_many_lanes = 4;
+    }
+#endif
+
+    /* SHA-NI hashes a single stream at least as fast as the vector units
+     * hash eight, so the multi-buffer code is only used without it */
+    sha256_transform_many = NULL;
+    sha256_many_lanes = 0;
+    if (features & SHA2_CPU_SHANI) {
+        sha2_features_active = features;
+        return features;
+    }
+#ifdef ENABLE_SSE41
+    if (features & SHA2_CPU_SSE41) {
+        sha256_transform_many = sha256_Transform_4way;
+        sha256_many_lanes = 4;
+    }
+#endif
+#ifdef ENABLE_AVX2
+    if (features & SHA2_CPU_AVX2) {
+        sha256_transform_many = sha256_Transform_8way;
+        sha256_many_lanes = 8;
+    }
+#endif
+    sha2_features_active = features;
+    return features;
+}
+
+uint32_t sha2_auto_detect(void)
+{
+    return sha2_set_features(0xffffffff);
+}
+
+uint32_t sha2_get_features(void)
+{
+    return sha2_features_active;
+}
+
+void sha256_Transform(SHA256_CTX *context, const sha2_word32 *data)
+{
+    sha256_transform(context->state, (const sha2_byte *)data, 1);
+}
+
 void sha256_Update(SHA256_CTX *context, const sha2_byte *data, size_t len)
 {
     unsigned int    freespace, usedspace;
@@ -478,7 +632,7 @@ void sha256_Update(SHA256_CTX *context, const sha2_byte *data, size_t len)
             context->bitcount += freespace << 3;
             len -= freespace;
             data += freespace;
-            sha256_Transform(context, (sha2_word32 *)context->buffer);
+            sha256_transform(context->state, context->buffer, 1);
         } else {
             /* The buffer is not yet full */
             MEMCPY_BCOPY(&context->buffer[usedspace], data, len);
@@ -488,12 +642,13 @@ void sha256_Update(SHA256_CTX *context, const sha2_byte *data, size_t len)
             return;
         }
     }
-    while (len >= SHA256_BLOCK_LENGTH) {
+    if (len >= SHA256_BLOCK_LENGTH) {
         /* Process as many complete blocks as we can */
-        sha256_Transform(context, (const sha2_word32 *)data);
-        context->bitcount += SHA256_BLOCK_LENGTH << 3;
-        len -= SHA256_BLOCK_LENGTH;
-        data += SHA256_BLOCK_LENGTH;
+        size_t blocks = len / SHA256_BLOCK_LENGTH;
+        sha256_transform(context->state, data, blocks);
+        context->bitcount += (sha2_word64)blocks * (SHA256_BLOCK_LENGTH << 3);
+        len -= blocks * SHA256_BLOCK_LENGTH;
+        data += blocks * SHA256_BLOCK_LENGTH;
     }
     if (len > 0) {
         /* There's left-overs, so save 'em */
@@ -528,7 +683,7 @@ void sha256_Final(sha2_byte digest[], SHA256_CTX *context)
                     MEMSET_BZERO(&context->buffer[usedspace], SHA256_BLOCK_LENGTH - usedspace);
                 }
                 /* Do second-to-last transform: */
-                sha256_Transform(context, (sha2_word32 *)context->buffer);
+                sha256_transform(context->state, context->buffer, 1);
 
                 /* And set-up for the last transform: */
                 MEMSET_BZERO(context->buffer, SHA256_SHORT_BLOCK_LENGTH);
@@ -541,11 +696,10 @@ void sha256_Final(sha2_byte digest[], SHA256_CTX *context)
             *context->buffer = 0x80;
         }
         /* Set the bit count: */
-        sha2_word64 *t = (sha2_word64 *)&context->buffer[SHA256_SHORT_BLOCK_LENGTH];
-        *t = context->bitcount;
+        MEMCPY_BCOPY(&context->buffer[SHA256_SHORT_BLOCK_LENGTH], &context->bitcount, sizeof(sha2_word64));
 
         /* Final transform: */
-        sha256_Transform(context, (sha2_word32 *)context->buffer);
+        sha256_transform(context->state, context->buffer, 1);
 
 #if BYTE_ORDER == LITTLE_ENDIAN
         {
@@ -566,6 +720,24 @@ void sha256_Final(sha2_byte digest[], SHA256_CTX *context)
     usedspace = 0;
 }
 
+int sha256_GetMidstate(const SHA256_CTX *context, SHA256_MIDSTATE *midstate)
+{
+    if ((context->bitcount >> 3) % SHA256_BLOCK_LENGTH != 0) {
+        /* buffered bytes are not part of the state yet */
+        return 0;
+    }
+    MEMCPY_BCOPY(midstate->state, context->state, sizeof(midstate->state));
+    midstate->bitcount = context->bitcount;
+    return 1;
+}
+
+void sha256_SetMidstate(SHA256_CTX *context, const SHA256_MIDSTATE *midstate)
+{
+    MEMCPY_BCOPY(context->state, midstate->state, sizeof(context->state));
+    MEMSET_BZERO(context->buffer, SHA256_BLOCK_LENGTH);
+    context->bitcount = midstate->bitcount;
+}
+
 void sha256_Raw(const sha2_byte *data, size_t len, uint8_t digest[SHA256_DIGEST_LENGTH])
 {
     SHA256_CTX  context;
@@ -575,6 +747,173 @@ void sha256_Raw(const sha2_byte *data, size_t len, uint8_t digest[SHA256_DIGEST_
 }
 
 
+/*** SHA-256 double hash and multi-buffer: ****************************/
+/* constant second block of a 64 byte message */
+static const sha2_byte sha256_pad64[SHA256_BLOCK_LENGTH] = {
+    0x80, [62] = 0x02, [63] = 0x00
+};
+/* constant second half of the block hashing a 32 byte digest */
+static const sha2_byte sha256_pad32[SHA256_BLOCK_LENGTH - SHA256_DIGEST_LENGTH] = {
+    0x80, [30] = 0x01, [31] = 0x00
+};
+static const sha2_byte sha256_zero_block[SHA256_BLOCK_LENGTH];
+
+static void sha256_many_init(sha2_word32 *state, size_t lanes)
+{
+    size_t i, lane;
+    for (i = 0; i < 8; i++) {
+        for (lane = 0; lane < lanes; lane++) {
+            state[i * lanes + lane] = sha256_initial_hash_value[i];
+        }
+    }
+}
+
+static void sha256_many_digest(const sha2_word32 *state, size_t lanes, size_t lane, sha2_byte *digest)
+{
+    size_t i;
+    for (i = 0; i < 8; i++) {
+        sha2_word32 w = state[i * lanes + lane];
+        *digest++ = w >> 24;
+        *digest++ = w >> 16;
+        *digest++ = w >> 8;
+        *digest++ = w;
+    }
+}
+
+void sha256d64(const sha2_byte *data, uint8_t digest[SHA256_DIGEST_LENGTH])
+{
+    sha2_word32 state[8];
+    sha2_byte block[SHA256_BLOCK_LENGTH];
+
+    MEMCPY_BCOPY(state, sha256_initial_hash_value, SHA256_DIGEST_LENGTH);
+    sha256_transform(state, data, 1);
+    sha256_transform(state, sha256_pad64, 1);
+
+    sha256_many_digest(state, 1, 0, block);
+    MEMCPY_BCOPY(block + SHA256_DIGEST_LENGTH, sha256_pad32, sizeof(sha256_pad32));
+    MEMCPY_BCOPY(state, sha256_initial_hash_value, SHA256_DIGEST_LENGTH);
+    sha256_transform(state, block, 1);
+    sha256_many_digest(state, 1, 0, digest);
+}
+
+/* hash one message per lane; messages may differ in length */
+static void sha256_Raw_lanes(sha256_transform_many_fn transform, size_t lanes,
+                             const sha2_byte *const *data, const size_t *len,
+                             sha2_byte (*digests)[SHA256_DIGEST_LENGTH])
+{
+    sha2_word32 state[8 * SHA256_MAX_LANES];
+    sha2_byte tail[SHA256_MAX_LANES][2 * SHA256_BLOCK_LENGTH];
+    const sha2_byte *blocks[SHA256_MAX_LANES];
+    size_t full[SHA256_MAX_LANES], total[SHA256_MAX_LANES];
+    size_t lane, b, maxblocks = 0;
+
+    for (lane = 0; lane < lanes; lane++) {
+        size_t rem = len[lane] % SHA256_BLOCK_LENGTH;
+        sha2_word64 bits = (sha2_word64)len[lane] << 3;
+        sha2_byte *end;
+        int i;
+
+        full[lane] = len[lane] / SHA256_BLOCK_LENGTH;
+        total[lane] = full[lane] + (rem < SHA256_SHORT_BLOCK_LENGTH ? 1 : 2);
+        if (total[lane] > maxblocks) {
+            maxblocks = total[lane];
+        }
+
+        /* pre-pad the last one or two blocks of this lane */
+        MEMSET_BZERO(tail[lane], sizeof(tail[lane]));
+        MEMCPY_BCOPY(tail[lane], data[lane] + full[lane] * SHA256_BLOCK_LENGTH, rem);
+        tail[lane][rem] = 0x80;
+        end = tail[lane] + (total[lane] - full[lane]) * SHA256_BLOCK_LENGTH;
+        for (i = 1; i <= 8; i++, bits >>= 8) {
+            end[-i] = (sha2_byte)bits;
+        }
+    }
+
+    sha256_many_init(state, lanes);
+    for (b = 0; b < maxblocks; b++) {
+        for (lane = 0; lane < lanes; lane++) {
+            if (b < full[lane]) {
+                blocks[lane] = data[lane] + b * SHA256_BLOCK_LENGTH;
+            } else if (b < total[lane]) {
+                blocks[lane] = tail[lane] + (b - full[lane]) * SHA256_BLOCK_LENGTH;
+            } else {
+                /* lane already finished, keep it busy */
+                blocks[lane] = sha256_zero_block;
+            }
+        }
+        transform(state, blocks);
+        for (lane = 0; lane < lanes; lane++) {
+            if (b == total[lane] - 1) {
+                sha256_many_digest(state, lanes, lane, digests[lane]);
+            }
+        }
+    }
+    MEMSET_BZERO(tail, sizeof(tail));
+}
+
+void sha256_Raw_many(const sha2_byte *const *data, const size_t *len, size_t count,
+                     uint8_t (*digests)[SHA256_DIGEST_LENGTH])
+{
+    sha256_transform_many_fn transform = sha256_transform_many;
+    size_t lanes = sha256_many_lanes;
+    size_t i = 0;
+
+    if (transform) {
+        for (; i + lanes <= count; i += lanes) {
+            sha256_Raw_lanes(transform, lanes, data + i, len + i, digests + i);
+        }
+    }
+    /* scalar tail */
+    for (; i < count; i++) {
+        sha256_Raw(data[i], len[i], digests[i]);
+    }
+}
+
+void sha256d64_many(const sha2_byte *data, size_t count, uint8_t *digests)
+{
+    sha256_transform_many_fn transform = sha256_transform_many;
+    size_t lanes = sha256_many_lanes;
+    size_t i = 0, lane;
+
+    if (transform) {
+        sha2_word32 state[8 * SHA256_MAX_LANES];
+        sha2_byte second[SHA256_MAX_LANES][SHA256_BLOCK_LENGTH];
+        const sha2_byte *blocks[SHA256_MAX_LANES];
+
+        /* second hash: 32 byte digest followed by constant padding */
+        for (lane = 0; lane < lanes; lane++) {
+            MEMCPY_BCOPY(second[lane] + SHA256_DIGEST_LENGTH, sha256_pad32, sizeof(sha256_pad32));
+        }
+
+        for (; i + lanes <= count; i += lanes) {
+            sha256_many_init(state, lanes);
+            for (lane = 0; lane < lanes; lane++) {
+                blocks[lane] = data + (i + lane) * SHA256_BLOCK_LENGTH;
+            }
+            transform(state, blocks);
+            for (lane = 0; lane < lanes; lane++) {
+                blocks[lane] = sha256_pad64;
+            }
+            transform(state, blocks);
+
+            for (lane = 0; lane < lanes; lane++) {
+                sha256_many_digest(state, lanes, lane, second[lane]);
+                blocks[lane] = second[lane];
+            }
+            sha256_many_init(state, lanes);
+            transform(state, blocks);
+            for (lane = 0; lane < lanes; lane++) {
+                sha256_many_digest(state, lanes, lane, digests + (i + lane) * SHA256_DIGEST_LENGTH);
+            }
+        }
+    }
+    /* scalar tail */
+    for (; i < count; i++) {
+        sha256d64(data + i * SHA256_BLOCK_LENGTH, digests + i * SHA256_DIGEST_LENGTH);
+    }
+}
+
+
 /*** SHA-512: *********************************************************/
 void sha512_Init(SHA512_CTX *context)
 {
@@ -594,7 +933,7 @@ void sha512_Init(SHA512_CTX *context)
 #define ROUND512_0_TO_15(a,b,c,d,e,f,g,h)   \
     REVERSE64(*data++, W512[j]); \
     T1 = (h) + Sigma1_512(e) + Ch((e), (f), (g)) + \
-             K512[j] + W512[j]; \
+             sha512_K[j] + W512[j]; \
     (d) += T1, \
     (h) = T1 + Sigma0_512(a) + Maj((a), (b), (c)), \
     j++
@@ -604,7 +943,7 @@ void sha512_Init(SHA512_CTX *context)
 
 #define ROUND512_0_TO_15(a,b,c,d,e,f,g,h)   \
     T1 = (h) + Sigma1_512(e) + Ch((e), (f), (g)) + \
-             K512[j] + (W512[j] = *data++); \
+             sha512_K[j] + (W512[j] = *data++); \
     (d) += T1; \
     (h) = T1 + Sigma0_512(a) + Maj((a), (b), (c)); \
     j++
@@ -616,27 +955,27 @@ void sha512_Init(SHA512_CTX *context)
     s0 = sigma0_512(s0); \
     s1 = W512[(j+14)&0x0f]; \
     s1 = sigma1_512(s1); \
-    T1 = (h) + Sigma1_512(e) + Ch((e), (f), (g)) + K512[j] + \
+    T1 = (h) + Sigma1_512(e) + Ch((e), (f), (g)) + sha512_K[j] + \
              (W512[j&0x0f] += s1 + W512[(j+9)&0x0f] + s0); \
     (d) += T1; \
     (h) = T1 + Sigma0_512(a) + Maj((a), (b), (c)); \
     j++
 
-void sha512_Transform(SHA512_CTX *context, const sha2_word64 *data)
+static void sha512_Transform_block(sha2_word64 *state, const sha2_word64 *data)
 {
     sha2_word64 a, b, c, d, e, f, g, h, s0, s1;
-    sha2_word64 T1, *W512 = (sha2_word64 *)context->buffer;
+    sha2_word64 T1, W512[16];
     int     j;
 
     /* Initialize registers with the prev. intermediate value */
-    a = context->state[0];
-    b = context->state[1];
-    c = context->state[2];
-    d = context->state[3];
-    e = context->state[4];
-    f = context->state[5];
-    g = context->state[6];
-    h = context->state[7];
+    a = state[0];
+    b = state[1];
+    c = state[2];
+    d = state[3];
+    e = state[4];
+    f = state[5];
+    g = state[6];
+    h = state[7];
 
     j = 0;
     do {
@@ -663,14 +1002,14 @@ void sha512_Transform(SHA512_CTX *context, const sha2_word64 *data)
     } while (j < 80);
 
     /* Compute the current intermediate hash value */
-    context->state[0] += a;
-    context->state[1] += b;
-    context->state[2] += c;
-    context->state[3] += d;
-    context->state[4] += e;
-    context->state[5] += f;
-    context->state[6] += g;
-    context->state[7] += h;
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
 
     /* Clean up */
     a = b = c = d = e = f = g = h = T1 = 0;
@@ -678,21 +1017,21 @@ void sha512_Transform(SHA512_CTX *context, const sha2_word64 *data)
 
 #else /* SHA2_UNROLL_TRANSFORM */
 
-void sha512_Transform(SHA512_CTX *context, const sha2_word64 *data)
+static void sha512_Transform_block(sha2_word64 *state, const sha2_word64 *data)
 {
     sha2_word64 a, b, c, d, e, f, g, h, s0, s1;
-    sha2_word64 T1, T2, *W512 = (sha2_word64 *)context->buffer;
+    sha2_word64 T1, T2, W512[16];
     int     j;
 
     /* Initialize registers with the prev. intermediate value */
-    a = context->state[0];
-    b = context->state[1];
-    c = context->state[2];
-    d = context->state[3];
-    e = context->state[4];
-    f = context->state[5];
-    g = context->state[6];
-    h = context->state[7];
+    a = state[0];
+    b = state[1];
+    c = state[2];
+    d = state[3];
+    e = state[4];
+    f = state[5];
+    g = state[6];
+    h = state[7];
 
     j = 0;
     do {
@@ -700,10 +1039,10 @@ void sha512_Transform(SHA512_CTX *context, const sha2_word64 *data)
         /* Convert TO host byte order */
         REVERSE64(*data++, W512[j]);
         /* Apply the SHA-512 compression function to update a..h */
-        T1 = h + Sigma1_512(e) + Ch(e, f, g) + K512[j] + W512[j];
+        T1 = h + Sigma1_512(e) + Ch(e, f, g) + sha512_K[j] + W512[j];
 #else /* BYTE_ORDER == LITTLE_ENDIAN */
         /* Apply the SHA-512 compression function to update a..h with copy */
-        T1 = h + Sigma1_512(e) + Ch(e, f, g) + K512[j] + (W512[j] = *data++);
+        T1 = h + Sigma1_512(e) + Ch(e, f, g) + sha512_K[j] + (W512[j] = *data++);
 #endif /* BYTE_ORDER == LITTLE_ENDIAN */
         T2 = Sigma0_512(a) + Maj(a, b, c);
         h = g;
@@ -726,7 +1065,7 @@ void sha512_Transform(SHA512_CTX *context, const sha2_word64 *data)
         s1 =  sigma1_512(s1);
 
         /* Apply the SHA-512 compression function to update a..h */
-        T1 = h + Sigma1_512(e) + Ch(e, f, g) + K512[j] +
+        T1 = h + Sigma1_512(e) + Ch(e, f, g) + sha512_K[j] +
              (W512[j & 0x0f] += s1 + W512[(j + 9) & 0x0f] + s0);
         T2 = Sigma0_512(a) + Maj(a, b, c);
         h = g;
@@ -742,14 +1081,14 @@ void sha512_Transform(SHA512_CTX *context, const sha2_word64 *data)
     } while (j < 80);
 
     /* Compute the current intermediate hash value */
-    context->state[0] += a;
-    context->state[1] += b;
-    context->state[2] += c;
-    context->state[3] += d;
-    context->state[4] += e;
-    context->state[5] += f;
-    context->state[6] += g;
-    context->state[7] += h;
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
 
     /* Clean up */
     a = b = c = d = e = f = g = h = T1 = T2 = 0;
@@ -757,6 +1096,18 @@ void sha512_Transform(SHA512_CTX *context, const sha2_word64 *data)
 
 #endif /* SHA2_UNROLL_TRANSFORM */
 
+static void sha512_Transform_generic(sha2_word64 *state, const sha2_byte *data, size_t blocks)
+{
+    for (; blocks > 0; blocks--, data += SHA512_BLOCK_LENGTH) {
+        sha512_Transform_block(state, (const sha2_word64 *)data);
+    }
+}
+
+void sha512_Transform(SHA512_CTX *context, const sha2_word64 *data)
+{
+    sha512_transform(context->state, (const sha2_byte *)data, 1);
+}
+
 void sha512_Update(SHA512_CTX *context, const sha2_byte *data, size_t len)
 {
     unsigned int    freespace, usedspace;
@@ -777,7 +1128,7 @@ void sha512_Update(SHA512_CTX *context, const sha2_byte *data, size_t len)
             ADDINC128(context->bitcount, freespace << 3);
             len -= freespace;
             data += freespace;
-            sha512_Transform(context, (sha2_word64 *)context->buffer);
+            sha512_transform(context->state, context->buffer, 1);
         } else {
             /* The buffer is not yet full */
             MEMCPY_BCOPY(&context->buffer[usedspace], data, len);
@@ -787,12 +1138,13 @@ void sha512_Update(SHA512_CTX *context, const sha2_byte *data, size_t len)
             return;
         }
     }
-    while (len >= SHA512_BLOCK_LENGTH) {
+    if (len >= SHA512_BLOCK_LENGTH) {
         /* Process as many complete blocks as we can */
-        sha512_Transform(context, (const sha2_word64 *)data);
-        ADDINC128(context->bitcount, SHA512_BLOCK_LENGTH << 3);
-        len -= SHA512_BLOCK_LENGTH;
-        data += SHA512_BLOCK_LENGTH;
+        size_t blocks = len / SHA512_BLOCK_LENGTH;
+        sha512_transform(context->state, data, blocks);
+        ADDINC128(context->bitcount, (sha2_word64)blocks * (SHA512_BLOCK_LENGTH << 3));
+        len -= blocks * SHA512_BLOCK_LENGTH;
+        data += blocks * SHA512_BLOCK_LENGTH;
     }
     if (len > 0) {
         /* There's left-overs, so save 'em */
@@ -825,7 +1177,7 @@ void sha512_Last(SHA512_CTX *context)
                 MEMSET_BZERO(&context->buffer[usedspace], SHA512_BLOCK_LENGTH - usedspace);
             }
             /* Do second-to-last transform: */
-            sha512_Transform(context, (sha2_word64 *)context->buffer);
+            sha512_transform(context->state, context->buffer, 1);
 
             /* And set-up for the last transform: */
             MEMSET_BZERO(context->buffer, SHA512_BLOCK_LENGTH - 2);
@@ -838,14 +1190,11 @@ void sha512_Last(SHA512_CTX *context)
         *context->buffer = 0x80;
     }
     /* Store the length of input data (in bits): */
-    sha2_word64 *t;
-    t = (sha2_word64 *)&context->buffer[SHA512_SHORT_BLOCK_LENGTH];
-    *t = context->bitcount[1];
-    t = (sha2_word64 *)&context->buffer[SHA512_SHORT_BLOCK_LENGTH + 8];
-    *t = context->bitcount[0];
+    MEMCPY_BCOPY(&context->buffer[SHA512_SHORT_BLOCK_LENGTH], &context->bitcount[1], sizeof(sha2_word64));
+    MEMCPY_BCOPY(&context->buffer[SHA512_SHORT_BLOCK_LENGTH + 8], &context->bitcount[0], sizeof(sha2_word64));
 
     /* Final transform: */
-    sha512_Transform(context, (sha2_word64 *)context->buffer);
+    sha512_transform(context->state, context->buffer, 1);
 }
 
 void sha512_Final(sha2_byte digest[], SHA512_CTX *context)
@@ -914,8 +1263,7 @@ void hmac_sha256(const uint8_t *key, const uint32_t keylen, const uint8_t *msg,
     sha256_Final(hmac, &ctx);
 }
 
-void hmac_sha512(const uint8_t *key, const uint32_t keylen, const uint8_t *msg,
-                 const uint32_t msglen, uint8_t *hmac)
+void hmac_sha512_Init(HMAC_SHA512_CTX *hctx, const uint8_t *key, const uint32_t keylen)
 {
     int i;
     uint8_t buf[SHA512_BLOCK_LENGTH], o_key_pad[SHA512_BLOCK_LENGTH],
@@ -934,13 +1282,149 @@ void hmac_sha512(const uint8_t *key, const uint32_t keylen, const uint8_t *msg,
         i_key_pad[i] = buf[i] ^ 0x36;
     }
 
+    /* both pads are exactly one block, keep the resulting states */
     sha512_Init(&ctx);
     sha512_Update(&ctx, i_key_pad, SHA512_BLOCK_LENGTH);
-    sha512_Update(&ctx, msg, msglen);
-    sha512_Final(buf, &ctx);
+    memcpy(hctx->inner, ctx.state, sizeof(hctx->inner));
 
     sha512_Init(&ctx);
     sha512_Update(&ctx, o_key_pad, SHA512_BLOCK_LENGTH);
+    memcpy(hctx->outer, ctx.state, sizeof(hctx->outer));
+
+    memset(buf, 0, sizeof(buf));
+    memset(o_key_pad, 0, sizeof(o_key_pad));
+    memset(i_key_pad, 0, sizeof(i_key_pad));
+    memset(&ctx, 0, sizeof(ctx));
+}
+
+void hmac_sha512_Final(const HMAC_SHA512_CTX *hctx, const uint8_t *msg,
+                       const uint32_t msglen, uint8_t *hmac)
+{
+    uint8_t buf[SHA512_DIGEST_LENGTH];
+    SHA512_CTX ctx;
+
+    memcpy(ctx.state, hctx->inner, sizeof(ctx.state));
+    ctx.bitcount[0] = SHA512_BLOCK_LENGTH << 3;
+    ctx.bitcount[1] = 0;
+    sha512_Update(&ctx, msg, msglen);
+    sha512_Final(buf, &ctx);
+
+    memcpy(ctx.state, hctx->outer, sizeof(ctx.state));
+    ctx.bitcount[0] = SHA512_BLOCK_LENGTH << 3;
+    ctx.bitcount[1] = 0;
     sha512_Update(&ctx, buf, SHA512_DIGEST_LENGTH);
     sha512_Final(hmac, &ctx);
+
+    memset(buf, 0, sizeof(buf));
+}
+
+void hmac_sha512(const uint8_t *key, const uint32_t keylen, const uint8_t *msg,
+                 const uint32_t msglen, uint8_t *hmac)
+{
+    HMAC_SHA512_CTX hctx;
+    hmac_sha512_Init(&hctx, key, keylen);
+    hmac_sha512_Final(&hctx, msg, msglen, hmac);
+    memset(&hctx, 0, sizeof(hctx));
+}
+
+/* hash one message per lane, all lanes continue from the state init after
+ * prefix bytes (a multiple of the block length) */
+static void sha512_lanes(sha512_transform_many_fn transform, size_t lanes,
+                         const sha2_word64 *init, sha2_word64 prefix,
+                         const sha2_byte *const *data, const size_t *len,
+                         sha2_byte (*digests)[SHA512_DIGEST_LENGTH])
+{
+    sha2_word64 state[8 * SHA512_MAX_LANES];
+    sha2_byte tail[SHA512_MAX_LANES][2 * SHA512_BLOCK_LENGTH];
+    const sha2_byte *blocks[SHA512_MAX_LANES];
+    size_t full[SHA512_MAX_LANES], total[SHA512_MAX_LANES];
+    size_t lane, b, i, maxblocks = 0;
+
+    for (lane = 0; lane < lanes; lane++) {
+        size_t rem = len[lane] % SHA512_BLOCK_LENGTH;
+        sha2_word64 bits = (prefix + len[lane]) << 3;
+        sha2_byte *end;
+
+        full[lane] = len[lane] / SHA512_BLOCK_LENGTH;
+        total[lane] = full[lane] + (rem < SHA512_SHORT_BLOCK_LENGTH ? 1 : 2);
+        if (total[lane] > maxblocks) {
+            maxblocks = total[lane];
+        }
+
+        /* pre-pad the last one or two blocks, the length is 128 bit big endian */
+        MEMSET_BZERO(tail[lane], sizeof(tail[lane]));
+        MEMCPY_BCOPY(tail[lane], data[lane] + full[lane] * SHA512_BLOCK_LENGTH, rem);
+        tail[lane][rem] = 0x80;
+        end = tail[lane] + (total[lane] - full[lane]) * SHA512_BLOCK_LENGTH;
+        for (i = 1; i <= 8; i++, bits >>= 8) {
+            end[-(int)i] = (sha2_byte)bits;
+        }
+    }
+
+    for (i = 0; i < 8; i++) {
+        for (lane = 0; lane < lanes; lane++) {
+            state[i * lanes + lane] = init[i];
+        }
+    }
+    for (b = 0; b < maxblocks; b++) {
+        for (lane = 0; lane < lanes; lane++) {
+            if (b < full[lane]) {
+                blocks[lane] = data[lane] + b * SHA512_BLOCK_LENGTH;
+            } else if (b < total[lane]) {
+                blocks[lane] = tail[lane] + (b - full[lane]) * SHA512_BLOCK_LENGTH;
+            } else {
+                /* lane already finished, keep it busy */
+                blocks[lane] = tail[lane];
+            }
+        }
+        transform(state, blocks);
+        for (lane = 0; lane < lanes; lane++) {
+            if (b == total[lane] - 1) {
+                sha2_byte *d = digests[lane];
+                for (i = 0; i < 8; i++) {
+                    sha2_word64 w = state[i * lanes + lane];
+                    int j;
+                    for (j = 7; j >= 0; j--, w >>= 8) {
+                        d[8 * i + j] = (sha2_byte)w;
+                    }
+                }
+            }
+        }
+    }
+    MEMSET_BZERO(tail, sizeof(tail));
+    MEMSET_BZERO(state, sizeof(state));
+}
+
+void hmac_sha512_Final_many(const HMAC_SHA512_CTX *hctx, const uint8_t *const *msg,
+                            const uint32_t *msglen, size_t count,
+                            uint8_t (*hmac)[SHA512_DIGEST_LENGTH])
+{
+    sha512_transform_many_fn transform = sha512_transform_many;
+    size_t lanes = sha512_many_lanes;
+    size_t i = 0, lane;
+
+    if (transform) {
+        uint8_t inner[SHA512_MAX_LANES][SHA512_DIGEST_LENGTH];
+        const uint8_t *inner_ptr[SHA512_MAX_LANES];
+        size_t len[SHA512_MAX_LANES], inner_len[SHA512_MAX_LANES];
+
+        for (lane = 0; lane < lanes; lane++) {
+            inner_ptr[lane] = inner[lane];
+            inner_len[lane] = SHA512_DIGEST_LENGTH;
+        }
+        for (; i + lanes <= count; i += lanes) {
+            for (lane = 0; lane < lanes; lane++) {
+                len[lane] = msglen[i + lane];
+            }
+            sha512_lanes(transform, lanes, hctx->inner, SHA512_BLOCK_LENGTH,
+                         msg + i, len, inner);
+            sha512_lanes(transform, lanes, hctx->outer, SHA512_BLOCK_LENGTH,
+                         inner_ptr, inner_len, hmac + i);
+        }
+        memset(inner, 0, sizeof(inner));
+    }
+    /* scalar tail */
+    for (; i < count; i++) {
+        hmac_sha512_Final(hctx, msg[i], msglen[i], hmac[i]);
+    }
 }
@@ -42,21 +42,63 @@
 #define SHA512_DIGEST_LENGTH        64
 #define SHA512_DIGEST_STRING_LENGTH (SHA512_DIGEST_LENGTH * 2 + 1)
 
+/* CPU features usable by the sha2 implementations */
+#define SHA2_CPU_SHANI              (1 << 0)
+#define SHA2_CPU_SSE41              (1 << 1)
+#define SHA2_CPU_AVX2               (1 << 2)
+
 typedef struct _SHA256_CTX {
     uint32_t    state[8];
     uint64_t    bitcount;
     uint8_t buffer[SHA256_BLOCK_LENGTH];
 } SHA256_CTX;
+/* SHA256_CTX state on a block boundary, used to resume hashing after a shared prefix */
+typedef struct _SHA256_MIDSTATE {
+    uint32_t    state[8];
+    uint64_t    bitcount;
+} SHA256_MIDSTATE;
 typedef struct _SHA512_CTX {
     uint64_t    state[8];
     uint64_t    bitcount[2];
     uint8_t buffer[SHA512_BLOCK_LENGTH];
 } SHA512_CTX;
 
+/* Select the fastest implementations supported by build and CPU.
+ * Returns the SHA2_CPU_* features in use (called from ecc_start()). */
+uint32_t sha2_auto_detect(void);
+/* Restrict the implementations to the given SHA2_CPU_* features (0 selects
+ * the portable code). Returns the features actually in use. */
+uint32_t sha2_set_features(uint32_t features);
+uint32_t sha2_get_features(void);
+
+/* round constants, also used by the SIMD implementations */
+extern const uint32_t sha256_K[64];
+extern const uint64_t sha512_K[80];
+
+/* HMAC-SHA512 key context: SHA-512 states after the ipad and opad blocks */
+typedef struct _HMAC_SHA512_CTX {
+    uint64_t    inner[8];
+    uint64_t    outer[8];
+} HMAC_SHA512_CTX;
+
 void sha256_Init(SHA256_CTX *);
 void sha256_Update(SHA256_CTX *, const uint8_t *, size_t);
 void sha256_Final(uint8_t[SHA256_DIGEST_LENGTH], SHA256_CTX *);
 void sha256_Raw(const uint8_t *, size_t, uint8_t[SHA256_DIGEST_LENGTH]);
+/* Capture the midstate of a context that hashed a multiple of 64 bytes
+ * (returns 0 otherwise) and start a new context from a captured midstate. */
+int sha256_GetMidstate(const SHA256_CTX *, SHA256_MIDSTATE *);
+void sha256_SetMidstate(SHA256_CTX *, const SHA256_MIDSTATE *);
+
+/* Hash count independent messages data[i] of len[i] bytes. Groups of 4 (SSE4.1)
+ * or 8 (AVX2) messages are hashed in parallel, best with similar lengths. */
+void sha256_Raw_many(const uint8_t *const *data, const size_t *len, size_t count,
+                     uint8_t (*digests)[SHA256_DIGEST_LENGTH]);
+/* Double sha256 of exactly 64 bytes (a merkle tree node), digest may alias data */
+void sha256d64(const uint8_t *data, uint8_t digest[SHA256_DIGEST_LENGTH]);
+/* Double sha256 of count contiguous 64 byte inputs (count * 32 bytes output).
+ * digests may equal data, which allows computing a merkle level in place. */
+void sha256d64_many(const uint8_t *data, size_t count, uint8_t *digests);
 
 void sha512_Init(SHA512_CTX *);
 void sha512_Update(SHA512_CTX *, const uint8_t *, size_t);
@@ -67,4 +109,13 @@ void hmac_sha256(const uint8_t *key, const uint32_t keylen, const uint8_t *msg,
                  const uint32_t msglen, uint8_t *hmac);
 void hmac_sha512(const uint8_t *key, const uint32_t keylen, const uint8_t *msg,
                  const uint32_t msglen, uint8_t *hmac);
+/* Precompute the key pads once, then MAC any number of messages with that key
+ * at two compressions less per message. The context holds key material. */
+void hmac_sha512_Init(HMAC_SHA512_CTX *hctx, const uint8_t *key, const uint32_t keylen);
+void hmac_sha512_Final(const HMAC_SHA512_CTX *hctx, const uint8_t *msg,
+                       const uint32_t msglen, uint8_t *hmac);
+/* hmac_sha512_Final of count messages with the same key, 4 at a time with AVX2 */
+void hmac_sha512_Final_many(const HMAC_SHA512_CTX *hctx, const uint8_t *const *msg,
+                            const uint32_t *msglen, size_t count,
+                            uint8_t (*hmac)[SHA512_DIGEST_LENGTH]);
 #endif
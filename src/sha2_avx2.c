@@ -0,0 +1,144 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Jonas Schnelli
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+/*
+ * 8-way SHA-256 compression function using AVX2. Each 32-bit lane of the
+ * vectors holds the state of an independent message. This file is compiled
+ * with -mavx -mavx2 and must only be called after sha2_auto_detect() has
+ * confirmed CPU and OS support.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <immintrin.h>
+
+#include "sha2.h"
+
+#define ADD(a, b)       _mm256_add_epi32((a), (b))
+#define XOR(a, b)       _mm256_xor_si256((a), (b))
+#define AND(a, b)       _mm256_and_si256((a), (b))
+#define OR(a, b)        _mm256_or_si256((a), (b))
+#define SHR(x, n)       _mm256_srli_epi32((x), (n))
+#define ROR(x, n)       OR(_mm256_srli_epi32((x), (n)), _mm256_slli_epi32((x), 32 - (n)))
+
+#define Ch(x, y, z)     XOR((z), AND((x), XOR((y), (z))))
+#define Maj(x, y, z)    OR(AND((x), (y)), AND((z), OR((x), (y))))
+#define Sigma0(x)       XOR(ROR((x), 2), XOR(ROR((x), 13), ROR((x), 22)))
+#define Sigma1(x)       XOR(ROR((x), 6), XOR(ROR((x), 11), ROR((x), 25)))
+#define sigma0(x)       XOR(ROR((x), 7), XOR(ROR((x), 18), SHR((x), 3)))
+#define sigma1(x)       XOR(ROR((x), 17), XOR(ROR((x), 19), SHR((x), 10)))
+
+/* message word t (expanding the schedule in place for t >= 16) */
+static inline __m256i sha256_8way_w(__m256i *w, int t)
+{
+    if (t >= 16) {
+        w[t & 15] = ADD(ADD(sigma1(w[(t - 2) & 15]), w[(t - 7) & 15]),
+                        ADD(sigma0(w[(t - 15) & 15]), w[t & 15]));
+    }
+    return w[t & 15];
+}
+
+#define ROUND(a, b, c, d, e, f, g, h, t) do { \
+    __m256i T1 = ADD(ADD(ADD((h), Sigma1(e)), ADD(Ch((e), (f), (g)), \
+                     _mm256_set1_epi32(sha256_K[t]))), sha256_8way_w(w, (t))); \
+    __m256i T2 = ADD(Sigma0(a), Maj((a), (b), (c))); \
+    (d) = ADD((d), T1); \
+    (h) = ADD(T1, T2); \
+} while (0)
+
+/* transpose 16 bytes of four blocks into 4 words (one lane per block) */
+static inline void sha256_8way_transpose(__m128i *out, const uint8_t *const *blocks, int offset)
+{
+    __m128i r0 = _mm_loadu_si128((const __m128i *)(blocks[0] + offset));
+    __m128i r1 = _mm_loadu_si128((const __m128i *)(blocks[1] + offset));
+    __m128i r2 = _mm_loadu_si128((const __m128i *)(blocks[2] + offset));
+    __m128i r3 = _mm_loadu_si128((const __m128i *)(blocks[3] + offset));
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+    out[0] = _mm_unpacklo_epi64(t0, t1);
+    out[1] = _mm_unpackhi_epi64(t0, t1);
+    out[2] = _mm_unpacklo_epi64(t2, t3);
+    out[3] = _mm_unpackhi_epi64(t2, t3);
+}
+
+static inline void sha256_8way_load(__m256i *w, const uint8_t *const *blocks, int offset)
+{
+    const __m256i bswap_mask = _mm256_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL,
+                                                 0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i lo[4], hi[4];
+    int i;
+
+    sha256_8way_transpose(lo, blocks, offset);
+    sha256_8way_transpose(hi, blocks + 4, offset);
+    for (i = 0; i < 4; i++) {
+        w[i] = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(lo[i]), hi[i], 1),
+                                   bswap_mask);
+    }
+}
+
+/* state holds the 8 state words interleaved: state[8 * i + lane] */
+void sha256_Transform_8way(uint32_t *state, const uint8_t *const *blocks)
+{
+    __m256i a, b, c, d, e, f, g, h, w[16];
+    int t;
+
+    a = _mm256_loadu_si256((const __m256i *)&state[0]);
+    b = _mm256_loadu_si256((const __m256i *)&state[8]);
+    c = _mm256_loadu_si256((const __m256i *)&state[16]);
+    d = _mm256_loadu_si256((const __m256i *)&state[24]);
+    e = _mm256_loadu_si256((const __m256i *)&state[32]);
+    f = _mm256_loadu_si256((const __m256i *)&state[40]);
+    g = _mm256_loadu_si256((const __m256i *)&state[48]);
+    h = _mm256_loadu_si256((const __m256i *)&state[56]);
+
+    sha256_8way_load(&w[0], blocks, 0);
+    sha256_8way_load(&w[4], blocks, 16);
+    sha256_8way_load(&w[8], blocks, 32);
+    sha256_8way_load(&w[12], blocks, 48);
+
+    for (t = 0; t < 64; t += 8) {
+        ROUND(a, b, c, d, e, f, g, h, t + 0);
+        ROUND(h, a, b, c, d, e, f, g, t + 1);
+        ROUND(g, h, a, b, c, d, e, f, t + 2);
+        ROUND(f, g, h, a, b, c, d, e, t + 3);
+        ROUND(e, f, g, h, a, b, c, d, t + 4);
+        ROUND(d, e, f, g, h, a, b, c, t + 5);
+        ROUND(c, d, e, f, g, h, a, b, t + 6);
+        ROUND(b, c, d, e, f, g, h, a, t + 7);
+    }
+
+    _mm256_storeu_si256((__m256i *)&state[0], ADD(a, _mm256_loadu_si256((const __m256i *)&state[0])));
+    _mm256_storeu_si256((__m256i *)&state[8], ADD(b, _mm256_loadu_si256((const __m256i *)&state[8])));
+    _mm256_storeu_si256((__m256i *)&state[16], ADD(c, _mm256_loadu_si256((const __m256i *)&state[16])));
+    _mm256_storeu_si256((__m256i *)&state[24], ADD(d, _mm256_loadu_si256((const __m256i *)&state[24])));
+    _mm256_storeu_si256((__m256i *)&state[32], ADD(e, _mm256_loadu_si256((const __m256i *)&state[32])));
+    _mm256_storeu_si256((__m256i *)&state[40], ADD(f, _mm256_loadu_si256((const __m256i *)&state[40])));
+    _mm256_storeu_si256((__m256i *)&state[48], ADD(g, _mm256_loadu_si256((const __m256i *)&state[48])));
+    _mm256_storeu_si256((__m256i *)&state[56], ADD(h, _mm256_loadu_si256((const __m256i *)&state[56])));
+    _mm256_zeroupper();
+}
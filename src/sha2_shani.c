@@ -0,0 +1,131 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Jonas Schnelli
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+/*
+ * SHA-256 compression function using the x86 SHA extensions (SHA-NI).
+ * This file is compiled with -msse4.1 -msha and must only be called after
+ * sha2_auto_detect() has confirmed CPU support.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <immintrin.h>
+
+#include "sha2.h"
+
+/* load 16 message bytes and convert them to big endian words */
+#define SHANI_LOAD(i) \
+    _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16 * (i))), bswap_mask)
+
+/* four rounds using message words m and constants K[4*i..4*i+3] */
+#define SHANI_ROUNDS(m, i) do { \
+    msg = _mm_add_epi32((m), _mm_loadu_si128((const __m128i *)&sha256_K[4 * (i)])); \
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg); \
+    msg = _mm_shuffle_epi32(msg, 0x0e); \
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg); \
+} while (0)
+
+/* message schedule: first and second half of the W[t] expansion */
+#define SHANI_MSG1(a, b) (a) = _mm_sha256msg1_epu32((a), (b))
+#define SHANI_MSG2(a, b, c) \
+    (a) = _mm_sha256msg2_epu32(_mm_add_epi32((a), _mm_alignr_epi8((b), (c), 4)), (b))
+
+void sha256_Transform_shani(uint32_t *state, const uint8_t *data, size_t blocks)
+{
+    const __m128i bswap_mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i state0, state1, msg, tmp, m0, m1, m2, m3, abef, cdgh;
+
+    /* the sha instructions expect the state as ABEF/CDGH */
+    tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xb1);
+    state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1b);
+    state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+    for (; blocks > 0; blocks--, data += SHA256_BLOCK_LENGTH) {
+        abef = state0;
+        cdgh = state1;
+
+        m0 = SHANI_LOAD(0);
+        SHANI_ROUNDS(m0, 0);
+        m1 = SHANI_LOAD(1);
+        SHANI_ROUNDS(m1, 1);
+        SHANI_MSG1(m0, m1);
+        m2 = SHANI_LOAD(2);
+        SHANI_ROUNDS(m2, 2);
+        SHANI_MSG1(m1, m2);
+        m3 = SHANI_LOAD(3);
+        SHANI_ROUNDS(m3, 3);
+        SHANI_MSG2(m0, m3, m2);
+        SHANI_MSG1(m2, m3);
+
+        SHANI_ROUNDS(m0, 4);
+        SHANI_MSG2(m1, m0, m3);
+        SHANI_MSG1(m3, m0);
+        SHANI_ROUNDS(m1, 5);
+        SHANI_MSG2(m2, m1, m0);
+        SHANI_MSG1(m0, m1);
+        SHANI_ROUNDS(m2, 6);
+        SHANI_MSG2(m3, m2, m1);
+        SHANI_MSG1(m1, m2);
+        SHANI_ROUNDS(m3, 7);
+        SHANI_MSG2(m0, m3, m2);
+        SHANI_MSG1(m2, m3);
+
+        SHANI_ROUNDS(m0, 8);
+        SHANI_MSG2(m1, m0, m3);
+        SHANI_MSG1(m3, m0);
+        SHANI_ROUNDS(m1, 9);
+        SHANI_MSG2(m2, m1, m0);
+        SHANI_MSG1(m0, m1);
+        SHANI_ROUNDS(m2, 10);
+        SHANI_MSG2(m3, m2, m1);
+        SHANI_MSG1(m1, m2);
+        SHANI_ROUNDS(m3, 11);
+        SHANI_MSG2(m0, m3, m2);
+        SHANI_MSG1(m2, m3);
+
+        SHANI_ROUNDS(m0, 12);
+        SHANI_MSG2(m1, m0, m3);
+        SHANI_MSG1(m3, m0);
+        SHANI_ROUNDS(m1, 13);
+        SHANI_MSG2(m2, m1, m0);
+        SHANI_ROUNDS(m2, 14);
+        SHANI_MSG2(m3, m2, m1);
+        SHANI_ROUNDS(m3, 15);
+
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+    /* back to ABCD/EFGH */
+    tmp = _mm_shuffle_epi32(state0, 0x1b);
+    state1 = _mm_shuffle_epi32(state1, 0xb1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xf0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+
+    _mm_storeu_si128((__m128i *)&state[0], state0);
+    _mm_storeu_si128((__m128i *)&state[4], state1);
+}
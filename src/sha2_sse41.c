@@ -0,0 +1,129 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Jonas Schnelli
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+/*
+ * 4-way SHA-256 compression function using SSE4.1. Each 32-bit lane of the
+ * vectors holds the state of an independent message. This file is compiled
+ * with -msse4.1 and must only be called after sha2_auto_detect() has
+ * confirmed CPU support.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <immintrin.h>
+
+#include "sha2.h"
+
+#define ADD(a, b)       _mm_add_epi32((a), (b))
+#define XOR(a, b)       _mm_xor_si128((a), (b))
+#define AND(a, b)       _mm_and_si128((a), (b))
+#define OR(a, b)        _mm_or_si128((a), (b))
+#define SHR(x, n)       _mm_srli_epi32((x), (n))
+#define ROR(x, n)       OR(_mm_srli_epi32((x), (n)), _mm_slli_epi32((x), 32 - (n)))
+
+#define Ch(x, y, z)     XOR((z), AND((x), XOR((y), (z))))
+#define Maj(x, y, z)    OR(AND((x), (y)), AND((z), OR((x), (y))))
+#define Sigma0(x)       XOR(ROR((x), 2), XOR(ROR((x), 13), ROR((x), 22)))
+#define Sigma1(x)       XOR(ROR((x), 6), XOR(ROR((x), 11), ROR((x), 25)))
+#define sigma0(x)       XOR(ROR((x), 7), XOR(ROR((x), 18), SHR((x), 3)))
+#define sigma1(x)       XOR(ROR((x), 17), XOR(ROR((x), 19), SHR((x), 10)))
+
+/* message word t (expanding the schedule in place for t >= 16) */
+static inline __m128i sha256_4way_w(__m128i *w, int t)
+{
+    if (t >= 16) {
+        w[t & 15] = ADD(ADD(sigma1(w[(t - 2) & 15]), w[(t - 7) & 15]),
+                        ADD(sigma0(w[(t - 15) & 15]), w[t & 15]));
+    }
+    return w[t & 15];
+}
+
+#define ROUND(a, b, c, d, e, f, g, h, t) do { \
+    __m128i T1 = ADD(ADD(ADD((h), Sigma1(e)), ADD(Ch((e), (f), (g)), \
+                     _mm_set1_epi32(sha256_K[t]))), sha256_4way_w(w, (t))); \
+    __m128i T2 = ADD(Sigma0(a), Maj((a), (b), (c))); \
+    (d) = ADD((d), T1); \
+    (h) = ADD(T1, T2); \
+} while (0)
+
+/* load 16 bytes of each lane's block and transpose them into 4 words */
+static inline void sha256_4way_load(__m128i *w, const uint8_t *const *blocks, int offset)
+{
+    const __m128i bswap_mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i r0 = _mm_loadu_si128((const __m128i *)(blocks[0] + offset));
+    __m128i r1 = _mm_loadu_si128((const __m128i *)(blocks[1] + offset));
+    __m128i r2 = _mm_loadu_si128((const __m128i *)(blocks[2] + offset));
+    __m128i r3 = _mm_loadu_si128((const __m128i *)(blocks[3] + offset));
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+    w[0] = _mm_shuffle_epi8(_mm_unpacklo_epi64(t0, t1), bswap_mask);
+    w[1] = _mm_shuffle_epi8(_mm_unpackhi_epi64(t0, t1), bswap_mask);
+    w[2] = _mm_shuffle_epi8(_mm_unpacklo_epi64(t2, t3), bswap_mask);
+    w[3] = _mm_shuffle_epi8(_mm_unpackhi_epi64(t2, t3), bswap_mask);
+}
+
+/* state holds the 8 state words interleaved: state[4 * i + lane] */
+void sha256_Transform_4way(uint32_t *state, const uint8_t *const *blocks)
+{
+    __m128i a, b, c, d, e, f, g, h, w[16];
+    int t;
+
+    a = _mm_loadu_si128((const __m128i *)&state[0]);
+    b = _mm_loadu_si128((const __m128i *)&state[4]);
+    c = _mm_loadu_si128((const __m128i *)&state[8]);
+    d = _mm_loadu_si128((const __m128i *)&state[12]);
+    e = _mm_loadu_si128((const __m128i *)&state[16]);
+    f = _mm_loadu_si128((const __m128i *)&state[20]);
+    g = _mm_loadu_si128((const __m128i *)&state[24]);
+    h = _mm_loadu_si128((const __m128i *)&state[28]);
+
+    sha256_4way_load(&w[0], blocks, 0);
+    sha256_4way_load(&w[4], blocks, 16);
+    sha256_4way_load(&w[8], blocks, 32);
+    sha256_4way_load(&w[12], blocks, 48);
+
+    for (t = 0; t < 64; t += 8) {
+        ROUND(a, b, c, d, e, f, g, h, t + 0);
+        ROUND(h, a, b, c, d, e, f, g, t + 1);
+        ROUND(g, h, a, b, c, d, e, f, t + 2);
+        ROUND(f, g, h, a, b, c, d, e, t + 3);
+        ROUND(e, f, g, h, a, b, c, d, t + 4);
+        ROUND(d, e, f, g, h, a, b, c, t + 5);
+        ROUND(c, d, e, f, g, h, a, b, t + 6);
+        ROUND(b, c, d, e, f, g, h, a, t + 7);
+    }
+
+    _mm_storeu_si128((__m128i *)&state[0], ADD(a, _mm_loadu_si128((const __m128i *)&state[0])));
+    _mm_storeu_si128((__m128i *)&state[4], ADD(b, _mm_loadu_si128((const __m128i *)&state[4])));
+    _mm_storeu_si128((__m128i *)&state[8], ADD(c, _mm_loadu_si128((const __m128i *)&state[8])));
+    _mm_storeu_si128((__m128i *)&state[12], ADD(d, _mm_loadu_si128((const __m128i *)&state[12])));
+    _mm_storeu_si128((__m128i *)&state[16], ADD(e, _mm_loadu_si128((const __m128i *)&state[16])));
+    _mm_storeu_si128((__m128i *)&state[20], ADD(f, _mm_loadu_si128((const __m128i *)&state[20])));
+    _mm_storeu_si128((__m128i *)&state[24], ADD(g, _mm_loadu_si128((const __m128i *)&state[24])));
+    _mm_storeu_si128((__m128i *)&state[28], ADD(h, _mm_loadu_si128((const __m128i *)&state[28])));
+}
@@ -0,0 +1,218 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Jonas Schnelli
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+/*
+ * SHA-512 compression functions using AVX2: a single stream with a vectorised
+ * message schedule and a 4-way variant where each 64-bit lane hashes an
+ * independent message. This file is compiled with -mavx -mavx2 and must only
+ * be called after sha2_auto_detect() has confirmed CPU and OS support.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <immintrin.h>
+
+#include "sha2.h"
+
+#define ADD(a, b)       _mm256_add_epi64((a), (b))
+#define XOR(a, b)       _mm256_xor_si256((a), (b))
+#define AND(a, b)       _mm256_and_si256((a), (b))
+#define OR(a, b)        _mm256_or_si256((a), (b))
+#define SHR(x, n)       _mm256_srli_epi64((x), (n))
+#define ROR(x, n)       OR(_mm256_srli_epi64((x), (n)), _mm256_slli_epi64((x), 64 - (n)))
+
+#define Ch(x, y, z)     XOR((z), AND((x), XOR((y), (z))))
+#define Maj(x, y, z)    OR(AND((x), (y)), AND((z), OR((x), (y))))
+#define Sigma0(x)       XOR(ROR((x), 28), XOR(ROR((x), 34), ROR((x), 39)))
+#define Sigma1(x)       XOR(ROR((x), 14), XOR(ROR((x), 18), ROR((x), 41)))
+#define sigma0(x)       XOR(ROR((x), 1), XOR(ROR((x), 8), SHR((x), 7)))
+#define sigma1(x)       XOR(ROR((x), 19), XOR(ROR((x), 61), SHR((x), 6)))
+
+/* scalar round helpers for the single stream */
+#define ROR64(x, n)     (((x) >> (n)) | ((x) << (64 - (n))))
+#define S_Ch(x, y, z)   ((z) ^ ((x) & ((y) ^ (z))))
+#define S_Maj(x, y, z)  (((x) & (y)) | ((z) & ((x) | (y))))
+#define S_Sigma0(x)     (ROR64((x), 28) ^ ROR64((x), 34) ^ ROR64((x), 39))
+#define S_Sigma1(x)     (ROR64((x), 14) ^ ROR64((x), 18) ^ ROR64((x), 41))
+
+#define S_ROUND(a, b, c, d, e, f, g, h, t) do { \
+    uint64_t T1 = (h) + S_Sigma1(e) + S_Ch((e), (f), (g)) + wk[t]; \
+    (d) += T1; \
+    (h) = T1 + S_Sigma0(a) + S_Maj((a), (b), (c)); \
+} while (0)
+
+/* words 1..4 of the 8 words in lo:hi */
+static inline __m256i sha512_avx2_align1(__m256i lo, __m256i hi)
+{
+    return _mm256_alignr_epi8(_mm256_permute2x128_si256(lo, hi, 0x21), lo, 8);
+}
+
+/* next four schedule words from the previous sixteen in v0..v3 */
+static inline __m256i sha512_avx2_schedule(__m256i v0, __m256i v1, __m256i v2, __m256i v3)
+{
+    __m256i w = ADD(ADD(v0, sigma0(sha512_avx2_align1(v0, v1))), sha512_avx2_align1(v2, v3));
+    /* the low pair depends on the last two words of v3, the high pair on the low pair */
+    w = ADD(w, sigma1(_mm256_permute2x128_si256(v3, v3, 0x81)));
+    w = ADD(w, sigma1(_mm256_permute2x128_si256(w, w, 0x08)));
+    return w;
+}
+
+void sha512_Transform_avx2(uint64_t *state, const uint8_t *data, size_t blocks)
+{
+    const __m256i bswap_mask = _mm256_set_epi64x(0x08090a0b0c0d0e0fULL, 0x0001020304050607ULL,
+                                                 0x08090a0b0c0d0e0fULL, 0x0001020304050607ULL);
+    uint64_t wk[80] __attribute__((aligned(32)));
+    uint64_t a, b, c, d, e, f, g, h;
+    __m256i v0, v1, v2, v3, v4;
+    int t;
+
+    for (; blocks > 0; blocks--, data += SHA512_BLOCK_LENGTH) {
+        /* message schedule plus round constants, computed ahead of the rounds */
+        v0 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(data + 0)), bswap_mask);
+        v1 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(data + 32)), bswap_mask);
+        v2 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(data + 64)), bswap_mask);
+        v3 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(data + 96)), bswap_mask);
+        _mm256_store_si256((__m256i *)&wk[0], ADD(v0, _mm256_loadu_si256((const __m256i *)&sha512_K[0])));
+        _mm256_store_si256((__m256i *)&wk[4], ADD(v1, _mm256_loadu_si256((const __m256i *)&sha512_K[4])));
+        _mm256_store_si256((__m256i *)&wk[8], ADD(v2, _mm256_loadu_si256((const __m256i *)&sha512_K[8])));
+        _mm256_store_si256((__m256i *)&wk[12], ADD(v3, _mm256_loadu_si256((const __m256i *)&sha512_K[12])));
+        for (t = 16; t < 80; t += 4) {
+            v4 = sha512_avx2_schedule(v0, v1, v2, v3);
+            _mm256_store_si256((__m256i *)&wk[t], ADD(v4, _mm256_loadu_si256((const __m256i *)&sha512_K[t])));
+            v0 = v1;
+            v1 = v2;
+            v2 = v3;
+            v3 = v4;
+        }
+
+        a = state[0];
+        b = state[1];
+        c = state[2];
+        d = state[3];
+        e = state[4];
+        f = state[5];
+        g = state[6];
+        h = state[7];
+        for (t = 0; t < 80; t += 8) {
+            S_ROUND(a, b, c, d, e, f, g, h, t + 0);
+            S_ROUND(h, a, b, c, d, e, f, g, t + 1);
+            S_ROUND(g, h, a, b, c, d, e, f, t + 2);
+            S_ROUND(f, g, h, a, b, c, d, e, t + 3);
+            S_ROUND(e, f, g, h, a, b, c, d, t + 4);
+            S_ROUND(d, e, f, g, h, a, b, c, t + 5);
+            S_ROUND(c, d, e, f, g, h, a, b, t + 6);
+            S_ROUND(b, c, d, e, f, g, h, a, t + 7);
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+    _mm256_zeroupper();
+}
+
+/* message word t (expanding the schedule in place for t >= 16) */
+static inline __m256i sha512_4way_w(__m256i *w, int t)
+{
+    if (t >= 16) {
+        w[t & 15] = ADD(ADD(sigma1(w[(t - 2) & 15]), w[(t - 7) & 15]),
+                        ADD(sigma0(w[(t - 15) & 15]), w[t & 15]));
+    }
+    return w[t & 15];
+}
+
+#define ROUND(a, b, c, d, e, f, g, h, t) do { \
+    __m256i T1 = ADD(ADD(ADD((h), Sigma1(e)), ADD(Ch((e), (f), (g)), \
+                     _mm256_set1_epi64x((long long)sha512_K[t]))), sha512_4way_w(w, (t))); \
+    __m256i T2 = ADD(Sigma0(a), Maj((a), (b), (c))); \
+    (d) = ADD((d), T1); \
+    (h) = ADD(T1, T2); \
+} while (0)
+
+/* transpose 32 bytes of four blocks into 4 words (one lane per block) */
+static inline void sha512_4way_load(__m256i *w, const uint8_t *const *blocks, int offset)
+{
+    const __m256i bswap_mask = _mm256_set_epi64x(0x08090a0b0c0d0e0fULL, 0x0001020304050607ULL,
+                                                 0x08090a0b0c0d0e0fULL, 0x0001020304050607ULL);
+    __m256i r0 = _mm256_loadu_si256((const __m256i *)(blocks[0] + offset));
+    __m256i r1 = _mm256_loadu_si256((const __m256i *)(blocks[1] + offset));
+    __m256i r2 = _mm256_loadu_si256((const __m256i *)(blocks[2] + offset));
+    __m256i r3 = _mm256_loadu_si256((const __m256i *)(blocks[3] + offset));
+    __m256i t0 = _mm256_unpacklo_epi64(r0, r1);
+    __m256i t1 = _mm256_unpackhi_epi64(r0, r1);
+    __m256i t2 = _mm256_unpacklo_epi64(r2, r3);
+    __m256i t3 = _mm256_unpackhi_epi64(r2, r3);
+    w[0] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(t0, t2, 0x20), bswap_mask);
+    w[1] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(t1, t3, 0x20), bswap_mask);
+    w[2] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(t0, t2, 0x31), bswap_mask);
+    w[3] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(t1, t3, 0x31), bswap_mask);
+}
+
+/* state holds the 8 state words interleaved: state[4 * i + lane] */
+void sha512_Transform_4way(uint64_t *state, const uint8_t *const *blocks)
+{
+    __m256i a, b, c, d, e, f, g, h, w[16];
+    int t;
+
+    a = _mm256_loadu_si256((const __m256i *)&state[0]);
+    b = _mm256_loadu_si256((const __m256i *)&state[4]);
+    c = _mm256_loadu_si256((const __m256i *)&state[8]);
+    d = _mm256_loadu_si256((const __m256i *)&state[12]);
+    e = _mm256_loadu_si256((const __m256i *)&state[16]);
+    f = _mm256_loadu_si256((const __m256i *)&state[20]);
+    g = _mm256_loadu_si256((const __m256i *)&state[24]);
+    h = _mm256_loadu_si256((const __m256i *)&state[28]);
+
+    sha512_4way_load(&w[0], blocks, 0);
+    sha512_4way_load(&w[4], blocks, 32);
+    sha512_4way_load(&w[8], blocks, 64);
+    sha512_4way_load(&w[12], blocks, 96);
+
+    for (t = 0; t < 80; t += 8) {
+        ROUND(a, b, c, d, e, f, g, h, t + 0);
+        ROUND(h, a, b, c, d, e, f, g, t + 1);
+        ROUND(g, h, a, b, c, d, e, f, t + 2);
+        ROUND(f, g, h, a, b, c, d, e, t + 3);
+        ROUND(e, f, g, h, a, b, c, d, t + 4);
+        ROUND(d, e, f, g, h, a, b, c, t + 5);
+        ROUND(c, d, e, f, g, h, a, b, t + 6);
+        ROUND(b, c, d, e, f, g, h, a, t + 7);
+    }
+
+    _mm256_storeu_si256((__m256i *)&state[0], ADD(a, _mm256_loadu_si256((const __m256i *)&state[0])));
+    _mm256_storeu_si256((__m256i *)&state[4], ADD(b, _mm256_loadu_si256((const __m256i *)&state[4])));
+    _mm256_storeu_si256((__m256i *)&state[8], ADD(c, _mm256_loadu_si256((const __m256i *)&state[8])));
+    _mm256_storeu_si256((__m256i *)&state[12], ADD(d, _mm256_loadu_si256((const __m256i *)&state[12])));
+    _mm256_storeu_si256((__m256i *)&state[16], ADD(e, _mm256_loadu_si256((const __m256i *)&state[16])));
+    _mm256_storeu_si256((__m256i *)&state[20], ADD(f, _mm256_loadu_si256((const __m256i *)&state[20])));
+    _mm256_storeu_si256((__m256i *)&state[24], ADD(g, _mm256_loadu_si256((const __m256i *)&state[24])));
+    _mm256_storeu_si256((__m256i *)&state[28], ADD(h, _mm256_loadu_si256((const __m256i *)&state[28])));
+    _mm256_zeroupper();
+}
@@ -31,6 +31,7 @@
 #include <string.h>
 
 #include "btc/tx.h"
+#include "btc/arena.h"
 
 #include "script.h"
 #include "serialize.h"
@@ -49,6 +50,22 @@ void btc_tx_in_free(btc_tx_in *tx_in)
         cstr_free(tx_in->script_sig, true);
         tx_in->script_sig = NULL;
     }
+
+    if (tx_in->witness_stack) {
+        vector_free(tx_in->witness_stack, true);
+        tx_in->witness_stack = NULL;
+    }
+}
+
+//callback for the witness stack vector
+static void btc_tx_witness_item_free_cb(void *data)
+{
+    cstr_free(data, true);
+}
+
+static vector* btc_tx_witness_stack_new(size_t count)
+{
+    return vector_new(count ? count : 1, btc_tx_witness_item_free_cb);
 }
 
 //callback for vector free function
@@ -134,9 +151,16 @@ btc_tx* btc_tx_new()
 }
 
 
+/* smallest serialized input (empty script) and output */
+#define BTC_TX_IN_MIN_SIZE (32 + 4 + 1 + 4)
+#define BTC_TX_OUT_MIN_SIZE (8 + 1)
+
+/* BIP144 marker (the empty input count) and flag */
+#define BTC_TX_WITNESS_FLAG 1
+
 bool btc_tx_in_deserialize(btc_tx_in *tx_in, struct const_buffer *buf)
 {
-    deser_u256(tx_in->prevout.hash, buf);
+    if (!deser_u256(tx_in->prevout.hash, buf)) return false;
     if (!deser_u32(&tx_in->prevout.n, buf)) return false;
     if (!deser_varstr(&tx_in->script_sig, buf)) return false;
     if (!deser_u32(&tx_in->sequence, buf)) return false;
@@ -150,42 +174,419 @@ bool btc_tx_out_deserialize(btc_tx_out *tx_out, struct const_buffer *buf)
     return true;
 }
 
+static bool btc_tx_witness_deserialize(btc_tx_in *tx_in, struct const_buffer *buf)
+{
+    uint32_t vlen, i;
+
+    if (!deser_varlen(&vlen, buf)) return false;
+    /* every item takes at least its length byte */
+    if (vlen > buf->len) return false;
+    if (vlen == 0)
+        return true;
+
+    tx_in->witness_stack = btc_tx_witness_stack_new(vlen);
+    for (i = 0; i < vlen; i++) {
+        cstring *item = NULL;
+        if (!deser_varstr(&item, buf)) return false;
+        vector_add(tx_in->witness_stack, item);
+    }
+    return true;
+}
+
 int btc_tx_deserialize(const unsigned char *tx_serialized, size_t inlen, btc_tx *tx)
 {
     struct const_buffer buf = { tx_serialized, inlen };
+    uint8_t flags = 0;
 
     //tx needs to be initialized
-    deser_u32(&tx->version, &buf);
+    btc_tx_hash_invalidate(tx);
+    if (!deser_u32(&tx->version, &buf)) return false;
     uint32_t vlen;
     if (!deser_varlen(&vlen, &buf)) return false;
 
+    /* an empty input list followed by a non zero flag byte is the
+       BIP144 marker, as in bitcoin core a zero flag ends the tx */
+    if (vlen == 0) {
+        if (!deser_bytes(&flags, &buf, 1)) return false;
+        if (flags != 0 && !deser_varlen(&vlen, &buf)) return false;
+    }
+
     unsigned int i;
     for (i = 0; i < vlen; i++) {
         btc_tx_in *tx_in = btc_tx_in_new();
 
         if (!btc_tx_in_deserialize(tx_in, &buf)) {
-            free(tx_in);
+            btc_tx_in_free_cb(tx_in);
+            return false;
         }
-        
+
         vector_add(tx->vin, tx_in);
     }
 
-    if (!deser_varlen(&vlen, &buf)) return false;
-    for (i = 0; i < vlen; i++) {
-        btc_tx_out *tx_out = btc_tx_out_new();
+    if (tx->vin->len > 0 || flags != 0) {
+        if (!deser_varlen(&vlen, &buf)) return false;
+        for (i = 0; i < vlen; i++) {
+            btc_tx_out *tx_out = btc_tx_out_new();
 
-        if (!btc_tx_out_deserialize(tx_out, &buf)) {
-            free(tx_out);
+            if (!btc_tx_out_deserialize(tx_out, &buf)) {
+                btc_tx_out_free_cb(tx_out);
+                return false;
+            }
+
+            vector_add(tx->vout, tx_out);
         }
+    }
 
-        vector_add(tx->vout, tx_out);
+    if (flags & BTC_TX_WITNESS_FLAG) {
+        flags ^= BTC_TX_WITNESS_FLAG;
+        for (i = 0; i < tx->vin->len; i++)
+            if (!btc_tx_witness_deserialize(vector_idx(tx->vin, i), &buf)) return false;
+        /* superfluous witness record */
+        if (!btc_tx_has_witness(tx)) return false;
     }
+    /* unknown optional data */
+    if (flags) return false;
 
     if (!deser_u32(&tx->locktime, &buf)) return false;
 
     return true;
 }
 
+/* a read only vector of count elements of elem_size bytes, all from the arena */
+static vector* btc_tx_arena_vector(btc_arena *arena, size_t count, size_t elem_size)
+{
+    vector *vec = btc_arena_alloc(arena, sizeof(*vec));
+    uint8_t *elems = btc_arena_alloc(arena, count * elem_size);
+    size_t i;
+
+    if (!vec || !elems)
+        return NULL;
+    vec->data = btc_arena_alloc(arena, count * sizeof(void *));
+    if (!vec->data)
+        return NULL;
+    memset(elems, 0, count * elem_size);
+    for (i = 0; i < count; i++)
+        vec->data[i] = elems + i * elem_size;
+    vec->len = vec->alloc = count;
+    vec->elem_free_f = NULL;
+    return vec;
+}
+
+static bool deser_varstr_arena(cstring **so, struct const_buffer *buf, btc_arena *arena)
+{
+    uint32_t len;
+    if (!deser_varlen(&len, buf)) return false;
+    if (buf->len < len) return false;
+
+    cstring *s = btc_arena_alloc(arena, sizeof(*s));
+    if (!s) return false;
+    s->str = btc_arena_alloc(arena, len + 1);
+    if (!s->str) return false;
+    memcpy(s->str, buf->p, len);
+    s->str[len] = 0;
+    s->len = len;
+    s->alloc = len + 1;
+
+    buf->p = (const uint8_t *)buf->p + len;
+    buf->len -= len;
+    *so = s;
+    return true;
+}
+
+static bool btc_tx_witness_deserialize_arena(btc_tx_in *tx_in, struct const_buffer *buf, btc_arena *arena)
+{
+    uint32_t vlen, i;
+
+    if (!deser_varlen(&vlen, buf)) return false;
+    if (vlen > buf->len) return false;
+    if (vlen == 0)
+        return true;
+
+    vector *stack = btc_arena_alloc(arena, sizeof(*stack));
+    if (!stack) return false;
+    stack->data = btc_arena_alloc(arena, vlen * sizeof(void *));
+    if (!stack->data) return false;
+    for (i = 0; i < vlen; i++)
+        if (!deser_varstr_arena((cstring **)&stack->data[i], buf, arena)) return false;
+    stack->len = stack->alloc = vlen;
+    stack->elem_free_f = NULL;
+    tx_in->witness_stack = stack;
+    return true;
+}
+
+btc_tx* btc_tx_deserialize_arena(const unsigned char *tx_serialized, size_t inlen, btc_arena *arena, size_t *consumed_length)
+{
+    struct const_buffer buf = { tx_serialized, inlen };
+    btc_tx *tx = btc_arena_alloc(arena, sizeof(*tx));
+    uint8_t flags = 0;
+    uint32_t vlen;
+    unsigned int i;
+
+    if (!tx) return NULL;
+    btc_tx_hash_invalidate(tx);
+    if (!deser_u32(&tx->version, &buf)) return NULL;
+
+    /* counts are bounded by the remaining bytes before allocating */
+    if (!deser_varlen(&vlen, &buf)) return NULL;
+    if (vlen == 0) {
+        if (!deser_bytes(&flags, &buf, 1)) return NULL;
+        if (flags != 0 && !deser_varlen(&vlen, &buf)) return NULL;
+    }
+    if (vlen > buf.len / BTC_TX_IN_MIN_SIZE) return NULL;
+    tx->vin = btc_tx_arena_vector(arena, vlen, sizeof(btc_tx_in));
+    if (!tx->vin) return NULL;
+    for (i = 0; i < vlen; i++) {
+        btc_tx_in *tx_in = vector_idx(tx->vin, i);
+        if (!deser_u256(tx_in->prevout.hash, &buf)) return NULL;
+        if (!deser_u32(&tx_in->prevout.n, &buf)) return NULL;
+        if (!deser_varstr_arena(&tx_in->script_sig, &buf, arena)) return NULL;
+        if (!deser_u32(&tx_in->sequence, &buf)) return NULL;
+    }
+
+    vlen = 0;
+    if (tx->vin->len > 0 || flags != 0)
+        if (!deser_varlen(&vlen, &buf)) return NULL;
+    if (vlen > buf.len / BTC_TX_OUT_MIN_SIZE) return NULL;
+    tx->vout = btc_tx_arena_vector(arena, vlen, sizeof(btc_tx_out));
+    if (!tx->vout) return NULL;
+    for (i = 0; i < vlen; i++) {
+        btc_tx_out *tx_out = vector_idx(tx->vout, i);
+        if (!deser_s64(&tx_out->value, &buf)) return NULL;
+        if (!deser_varstr_arena(&tx_out->script_pubkey, &buf, arena)) return NULL;
+    }
+
+    if (flags & BTC_TX_WITNESS_FLAG) {
+        flags ^= BTC_TX_WITNESS_FLAG;
+        for (i = 0; i < tx->vin->len; i++)
+            if (!btc_tx_witness_deserialize_arena(vector_idx(tx->vin, i), &buf, arena)) return NULL;
+        if (!btc_tx_has_witness(tx)) return NULL;
+    }
+    if (flags) return NULL;
+
+    if (!deser_u32(&tx->locktime, &buf)) return NULL;
+
+    if (consumed_length)
+        *consumed_length = inlen - buf.len;
+    return tx;
+}
+
+static inline uint32_t btc_tx_view_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* compact size at *p, false if it does not fit before end */
+static inline bool btc_tx_view_varlen(const uint8_t **p, const uint8_t *end, uint64_t *vlen)
+{
+    const uint8_t *q = *p;
+    size_t n, k;
+
+    if (q >= end) return false;
+    if (*q < 253) {
+        *vlen = *q;
+        *p = q + 1;
+        return true;
+    }
+    n = *q == 253 ? 2 : (*q == 254 ? 4 : 8);
+    if ((size_t)(end - q) < 1 + n) return false;
+    for (*vlen = 0, k = n; k > 0; k--)
+        *vlen = (*vlen << 8) | q[k];
+    *p = q + 1 + n;
+    return true;
+}
+
+/* skip the script after its length prefix (plus trailing bytes), recording it in item if not NULL */
+static inline bool btc_tx_view_script(const uint8_t **p, const uint8_t *end, const uint8_t *start, btc_tx_view_item *item, size_t trailing)
+{
+    uint64_t len;
+    if (!btc_tx_view_varlen(p, end, &len)) return false;
+    if (len > (uint64_t)(end - *p) || (uint64_t)(end - *p) - len < trailing) return false;
+    if (item) {
+        item->script_offset = (uint32_t)(*p - start);
+        item->script_len = (uint32_t)len;
+    }
+    *p += len + trailing;
+    return true;
+}
+
+static btc_tx_view_item* btc_tx_view_items(btc_arena *arena, size_t count)
+{
+    if (arena)
+        return btc_arena_alloc(arena, count * sizeof(btc_tx_view_item));
+    return malloc(count ? count * sizeof(btc_tx_view_item) : 1);
+}
+
+/* the one walk over the transaction grammar behind btc_tx_view_parse and btc_tx_skip:
+ * returns the bytes the transaction at data takes, 0 if it is malformed
+ * with a view, the counts and item tables (from arena or the heap) are recorded in it,
+ * the caller releases them on failure */
+static size_t btc_tx_view_walk(btc_tx_view *view, const uint8_t *data, size_t len, btc_arena *arena)
+{
+    const uint8_t *p = data, *end = data + len;
+    uint64_t vin_count, vout_count;
+    btc_tx_view_item *vin = NULL, *vout = NULL;
+    bool witness = false;
+    size_t i;
+
+    if (len < 4) return 0;
+    p += 4;
+
+    /* counts are bounded by the remaining bytes before allocating */
+    if (!btc_tx_view_varlen(&p, end, &vin_count)) return 0;
+    if (vin_count == 0) {
+        /* BIP144 marker and flag */
+        if (p >= end) return 0;
+        if (*p != 0) {
+            if (*p != BTC_TX_WITNESS_FLAG) return 0;
+            witness = true;
+            p++;
+            if (!btc_tx_view_varlen(&p, end, &vin_count)) return 0;
+        }
+        else
+            p++;
+    }
+    if (vin_count > (uint64_t)(end - p) / BTC_TX_IN_MIN_SIZE) return 0;
+    if (view) {
+        view->items_on_heap = !arena;
+        vin = view->vin = btc_tx_view_items(arena, vin_count);
+        if (!vin) return 0;
+    }
+    for (i = 0; i < vin_count; i++) {
+        if ((size_t)(end - p) < 36) return 0;
+        if (vin) {
+            vin[i].offset = (uint32_t)(p - data);
+            vin[i].witness_offset = 0;
+        }
+        p += 36;
+        if (!btc_tx_view_script(&p, end, data, vin ? &vin[i] : NULL, 4)) return 0;
+    }
+
+    vout_count = 0;
+    if ((vin_count > 0 || witness) && !btc_tx_view_varlen(&p, end, &vout_count)) return 0;
+    if (vout_count > (uint64_t)(end - p) / BTC_TX_OUT_MIN_SIZE) return 0;
+    if (view) {
+        vout = view->vout = btc_tx_view_items(arena, vout_count);
+        if (!vout) return 0;
+    }
+    for (i = 0; i < vout_count; i++) {
+        if ((size_t)(end - p) < 8) return 0;
+        if (vout) {
+            vout[i].offset = (uint32_t)(p - data);
+            vout[i].witness_offset = 0;
+        }
+        p += 8;
+        if (!btc_tx_view_script(&p, end, data, vout ? &vout[i] : NULL, 0)) return 0;
+    }
+
+    if (witness) {
+        bool witness_items = false;
+        for (i = 0; i < vin_count; i++) {
+            uint64_t count, item_len;
+            if (vin)
+                vin[i].witness_offset = (uint32_t)(p - data);
+            if (!btc_tx_view_varlen(&p, end, &count)) return 0;
+            if (count > (uint64_t)(end - p)) return 0;
+            witness_items |= count > 0;
+            while (count--) {
+                if (!btc_tx_view_varlen(&p, end, &item_len)) return 0;
+                if (item_len > (uint64_t)(end - p)) return 0;
+                p += item_len;
+            }
+        }
+        /* superfluous witness record */
+        if (!witness_items) return 0;
+    }
+
+    if ((size_t)(end - p) < 4) return 0;
+    if (view) {
+        view->vin_count = vin_count;
+        view->vout_count = vout_count;
+        view->has_witness = witness;
+    }
+    return p + 4 - data;
+}
+
+bool btc_tx_view_parse(btc_tx_view *view, const uint8_t *data, size_t len, btc_arena *arena)
+{
+    size_t size;
+
+    memset(view, 0, sizeof(*view));
+    /* offsets are 32 bit */
+    size = btc_tx_view_walk(view, data, len > UINT32_MAX ? UINT32_MAX : len, arena);
+    if (!size) {
+        btc_tx_view_free(view);
+        return false;
+    }
+    view->data = data;
+    view->size = size;
+    view->version = btc_tx_view_le32(data);
+    view->locktime = btc_tx_view_le32(data + size - 4);
+    return true;
+}
+
+size_t btc_tx_skip(const uint8_t *data, size_t len)
+{
+    return btc_tx_view_walk(NULL, data, len, NULL);
+}
+
+void btc_tx_view_free(btc_tx_view *view)
+{
+    if (view->items_on_heap) {
+        free(view->vin);
+        free(view->vout);
+    }
+    memset(view, 0, sizeof(*view));
+}
+
+const uint8_t* btc_tx_view_prevout_hash(const btc_tx_view *view, size_t in_num)
+{
+    return view->data + view->vin[in_num].offset;
+}
+
+uint32_t btc_tx_view_prevout_n(const btc_tx_view *view, size_t in_num)
+{
+    return btc_tx_view_le32(view->data + view->vin[in_num].offset + 32);
+}
+
+const uint8_t* btc_tx_view_script_sig(const btc_tx_view *view, size_t in_num, size_t *len)
+{
+    *len = view->vin[in_num].script_len;
+    return view->data + view->vin[in_num].script_offset;
+}
+
+uint32_t btc_tx_view_sequence(const btc_tx_view *view, size_t in_num)
+{
+    return btc_tx_view_le32(view->data + view->vin[in_num].script_offset + view->vin[in_num].script_len);
+}
+
+int64_t btc_tx_view_value(const btc_tx_view *view, size_t out_num)
+{
+    const uint8_t *p = view->data + view->vout[out_num].offset;
+    return (int64_t)(btc_tx_view_le32(p) | ((uint64_t)btc_tx_view_le32(p + 4) << 32));
+}
+
+const uint8_t* btc_tx_view_script_pubkey(const btc_tx_view *view, size_t out_num, size_t *len)
+{
+    *len = view->vout[out_num].script_len;
+    return view->data + view->vout[out_num].script_offset;
+}
+
+const uint8_t* btc_tx_view_witness(const btc_tx_view *view, size_t in_num, size_t *len)
+{
+    uint32_t start = view->vin[in_num].witness_offset;
+    /* an empty stack is just its zero item count */
+    if (!start || view->data[start] == 0) {
+        *len = 0;
+        return NULL;
+    }
+    /* the stack ends where the next one (or the locktime) starts */
+    if (in_num + 1 < view->vin_count)
+        *len = view->vin[in_num + 1].witness_offset - start;
+    else
+        *len = view->size - 4 - start;
+    return view->data + start;
+}
+
 void btc_tx_in_serialize(cstring *s, const btc_tx_in *tx_in)
 {
     ser_u256(s, tx_in->prevout.hash);
@@ -200,34 +601,307 @@ void btc_tx_out_serialize(cstring *s, const btc_tx_out *tx_out)
     ser_varstr(s, tx_out->script_pubkey);
 }
 
-void btc_tx_serialize(cstring *s, const btc_tx *tx)
+/* bytes of a ser_varlen() length prefix */
+static inline size_t btc_tx_varlen_size(size_t vlen)
+{
+    return vlen < 253 ? 1 : (vlen < 0x10000 ? 3 : 5);
+}
+
+static inline size_t btc_tx_script_size(const cstring *script)
 {
-    ser_u32(s, tx->version);
+    size_t len = script ? script->len : 0;
+    return btc_tx_varlen_size(len) + len;
+}
 
-    ser_varlen(s, tx->vin ? tx->vin->len : 0);
+static inline bool btc_tx_in_has_witness(const btc_tx_in *tx_in)
+{
+    return tx_in->witness_stack && tx_in->witness_stack->len > 0;
+}
 
-    unsigned int i;
-    if (tx->vin) {
-        for (i = 0; i < tx->vin->len; i++) {
-            btc_tx_in *tx_in;
+bool btc_tx_has_witness(const btc_tx *tx)
+{
+    size_t i;
+    for (i = 0; tx->vin && i < tx->vin->len; i++)
+        if (btc_tx_in_has_witness(vector_idx(tx->vin, i)))
+            return true;
+    return false;
+}
+
+/* size without witness data */
+static size_t btc_tx_base_size(const btc_tx *tx)
+{
+    size_t vin_len = tx->vin ? tx->vin->len : 0;
+    size_t vout_len = tx->vout ? tx->vout->len : 0;
+    size_t size = 4 + btc_tx_varlen_size(vin_len) + btc_tx_varlen_size(vout_len) + 4;
+    size_t i;
+
+    for (i = 0; i < vin_len; i++) {
+        const btc_tx_in *tx_in = vector_idx(tx->vin, i);
+        size += 32 + 4 + btc_tx_script_size(tx_in->script_sig) + 4;
+    }
+    for (i = 0; i < vout_len; i++) {
+        const btc_tx_out *tx_out = vector_idx(tx->vout, i);
+        size += 8 + btc_tx_script_size(tx_out->script_pubkey);
+    }
+    return size;
+}
 
-            tx_in = vector_idx(tx->vin, i);
-            btc_tx_in_serialize(s, tx_in);
+/* marker, flag and all witness stacks */
+static size_t btc_tx_witness_size(const btc_tx *tx)
+{
+    size_t size = 2;
+    size_t i, k;
+
+    for (i = 0; i < tx->vin->len; i++) {
+        const btc_tx_in *tx_in = vector_idx(tx->vin, i);
+        if (!btc_tx_in_has_witness(tx_in)) {
+            size++;
+            continue;
         }
+        size += btc_tx_varlen_size(tx_in->witness_stack->len);
+        for (k = 0; k < tx_in->witness_stack->len; k++)
+            size += btc_tx_script_size(vector_idx(tx_in->witness_stack, k));
     }
+    return size;
+}
 
-    ser_varlen(s, tx->vout ? tx->vout->len : 0);
+size_t btc_tx_serialized_size(const btc_tx *tx)
+{
+    size_t size = btc_tx_base_size(tx);
+    if (btc_tx_has_witness(tx))
+        size += btc_tx_witness_size(tx);
+    return size;
+}
 
-    if (tx->vout) {
-        for (i = 0; i < tx->vout->len; i++) {
-            btc_tx_out *tx_out;
-            
-            tx_out = vector_idx(tx->vout, i);
-            btc_tx_out_serialize(s, tx_out);
+size_t btc_tx_weight(const btc_tx *tx)
+{
+    /* base size * 3 + total size */
+    size_t base_size = btc_tx_base_size(tx);
+    size_t size = base_size;
+    if (btc_tx_has_witness(tx))
+        size += btc_tx_witness_size(tx);
+    return base_size * 3 + size;
+}
+
+size_t btc_tx_vsize(const btc_tx *tx)
+{
+    return (btc_tx_weight(tx) + 3) / 4;
+}
+
+static inline uint8_t* btc_tx_write_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+    return p + 4;
+}
+
+static inline uint8_t* btc_tx_write_varlen(uint8_t *p, uint32_t vlen)
+{
+    if (vlen < 253) {
+        *p = vlen;
+        return p + 1;
+    }
+    if (vlen < 0x10000) {
+        p[0] = 253;
+        p[1] = vlen;
+        p[2] = vlen >> 8;
+        return p + 3;
+    }
+    *p = 254;
+    return btc_tx_write_u32(p + 1, vlen);
+}
+
+static inline uint8_t* btc_tx_write_script(uint8_t *p, const cstring *script)
+{
+    size_t len = script ? script->len : 0;
+    p = btc_tx_write_varlen(p, len);
+    if (len)
+        memcpy(p, script->str, len);
+    return p + len;
+}
+
+static uint8_t* btc_tx_write_outputs(uint8_t *p, const btc_tx *tx)
+{
+    size_t vout_len = tx->vout ? tx->vout->len : 0;
+    size_t i;
+    for (i = 0; i < vout_len; i++) {
+        const btc_tx_out *tx_out = vector_idx(tx->vout, i);
+        p = btc_tx_write_u32(p, (uint32_t)tx_out->value);
+        p = btc_tx_write_u32(p, (uint32_t)((uint64_t)tx_out->value >> 32));
+        p = btc_tx_write_script(p, tx_out->script_pubkey);
+    }
+    return p;
+}
+
+static void btc_tx_hash_output(SHA256_CTX *ctx, const btc_tx_out *tx_out)
+{
+    size_t script_len = tx_out->script_pubkey ? tx_out->script_pubkey->len : 0;
+    uint8_t buf[8 + 5];
+    uint8_t *p;
+
+    p = btc_tx_write_u32(buf, (uint32_t)tx_out->value);
+    p = btc_tx_write_u32(p, (uint32_t)((uint64_t)tx_out->value >> 32));
+    p = btc_tx_write_varlen(p, script_len);
+    sha256_Update(ctx, buf, p - buf);
+    if (script_len)
+        sha256_Update(ctx, (const uint8_t *)tx_out->script_pubkey->str, script_len);
+}
+
+/* write the serialization into p, which has room for btc_tx_serialized_size() bytes,
+   in the BIP144 format if witness is set */
+static uint8_t* btc_tx_write(uint8_t *p, const btc_tx *tx, bool witness)
+{
+    size_t vin_len = tx->vin ? tx->vin->len : 0;
+    size_t vout_len = tx->vout ? tx->vout->len : 0;
+    size_t i, k;
+
+    p = btc_tx_write_u32(p, tx->version);
+    if (witness) {
+        *p++ = 0;
+        *p++ = BTC_TX_WITNESS_FLAG;
+    }
+    p = btc_tx_write_varlen(p, vin_len);
+    for (i = 0; i < vin_len; i++) {
+        const btc_tx_in *tx_in = vector_idx(tx->vin, i);
+        memcpy(p, tx_in->prevout.hash, 32);
+        p = btc_tx_write_u32(p + 32, tx_in->prevout.n);
+        p = btc_tx_write_script(p, tx_in->script_sig);
+        p = btc_tx_write_u32(p, tx_in->sequence);
+    }
+    p = btc_tx_write_varlen(p, vout_len);
+    p = btc_tx_write_outputs(p, tx);
+    for (i = 0; witness && i < vin_len; i++) {
+        const btc_tx_in *tx_in = vector_idx(tx->vin, i);
+        if (!btc_tx_in_has_witness(tx_in)) {
+            *p++ = 0;
+            continue;
         }
+        p = btc_tx_write_varlen(p, tx_in->witness_stack->len);
+        for (k = 0; k < tx_in->witness_stack->len; k++)
+            p = btc_tx_write_script(p, vector_idx(tx_in->witness_stack, k));
     }
-    
-    ser_u32(s, tx->locktime);
+    return btc_tx_write_u32(p, tx->locktime);
+}
+
+size_t btc_tx_serialize_buf(const btc_tx *tx, uint8_t *buf, size_t buflen)
+{
+    size_t size = btc_tx_serialized_size(tx);
+    if (buflen < size)
+        return 0;
+    btc_tx_write(buf, tx, btc_tx_has_witness(tx));
+    return size;
+}
+
+void btc_tx_serialize(cstring *s, const btc_tx *tx)
+{
+    /* grow the string once to the exact size */
+    size_t pos = s->len;
+    if (!cstr_resize(s, pos + btc_tx_serialized_size(tx)))
+        return;
+    btc_tx_write((uint8_t *)s->str + pos, tx, btc_tx_has_witness(tx));
+}
+
+static inline void btc_tx_hash_script(SHA256_CTX *ctx, const cstring *script)
+{
+    size_t len = script ? script->len : 0;
+    uint8_t prefix[5];
+    sha256_Update(ctx, prefix, btc_tx_write_varlen(prefix, len) - prefix);
+    if (len)
+        sha256_Update(ctx, (const uint8_t *)script->str, len);
+}
+
+/* feed the serialization to ctx field by field */
+static void btc_tx_hash_update(SHA256_CTX *ctx, const btc_tx *tx, bool witness)
+{
+    size_t vin_len = tx->vin ? tx->vin->len : 0;
+    size_t vout_len = tx->vout ? tx->vout->len : 0;
+    uint8_t buf[4 + 2 + 5];
+    uint8_t outpoint[36];
+    uint8_t *p;
+    size_t i, k;
+
+    p = btc_tx_write_u32(buf, tx->version);
+    if (witness) {
+        *p++ = 0;
+        *p++ = BTC_TX_WITNESS_FLAG;
+    }
+    p = btc_tx_write_varlen(p, vin_len);
+    sha256_Update(ctx, buf, p - buf);
+    for (i = 0; i < vin_len; i++) {
+        const btc_tx_in *tx_in = vector_idx(tx->vin, i);
+        memcpy(outpoint, tx_in->prevout.hash, 32);
+        btc_tx_write_u32(outpoint + 32, tx_in->prevout.n);
+        sha256_Update(ctx, outpoint, sizeof(outpoint));
+        btc_tx_hash_script(ctx, tx_in->script_sig);
+        btc_tx_write_u32(buf, tx_in->sequence);
+        sha256_Update(ctx, buf, 4);
+    }
+    p = btc_tx_write_varlen(buf, vout_len);
+    sha256_Update(ctx, buf, p - buf);
+    for (i = 0; i < vout_len; i++)
+        btc_tx_hash_output(ctx, vector_idx(tx->vout, i));
+    for (i = 0; witness && i < vin_len; i++) {
+        const btc_tx_in *tx_in = vector_idx(tx->vin, i);
+        size_t count = btc_tx_in_has_witness(tx_in) ? tx_in->witness_stack->len : 0;
+        p = btc_tx_write_varlen(buf, count);
+        sha256_Update(ctx, buf, p - buf);
+        for (k = 0; k < count; k++)
+            btc_tx_hash_script(ctx, vector_idx(tx_in->witness_stack, k));
+    }
+    btc_tx_write_u32(buf, tx->locktime);
+    sha256_Update(ctx, buf, 4);
+}
+
+/* btc_tx.hash_cached bits */
+#define BTC_TX_HASH_TXID 1
+#define BTC_TX_HASH_WTXID 2
+
+static void btc_tx_hash_digest(const btc_tx *tx, bool witness, uint8_t *hashout)
+{
+    SHA256_CTX ctx;
+    sha256_Init(&ctx);
+    btc_tx_hash_update(&ctx, tx, witness);
+    sha256_Final(hashout, &ctx);
+    sha256_Raw(hashout, SHA256_DIGEST_LENGTH, hashout);
+}
+
+void btc_tx_hash(btc_tx *tx, uint8_t *hashout)
+{
+    if (!(tx->hash_cached & BTC_TX_HASH_TXID)) {
+        btc_tx_hash_digest(tx, false, tx->txid);
+        tx->hash_cached |= BTC_TX_HASH_TXID;
+    }
+    memcpy(hashout, tx->txid, SHA256_DIGEST_LENGTH);
+}
+
+void btc_tx_witness_hash(btc_tx *tx, uint8_t *hashout)
+{
+    if (!(tx->hash_cached & BTC_TX_HASH_WTXID)) {
+        /* the same as the txid without witness data */
+        if (btc_tx_has_witness(tx))
+            btc_tx_hash_digest(tx, true, tx->wtxid);
+        else
+            btc_tx_hash(tx, tx->wtxid);
+        tx->hash_cached |= BTC_TX_HASH_WTXID;
+    }
+    memcpy(hashout, tx->wtxid, SHA256_DIGEST_LENGTH);
+}
+
+void btc_tx_hash_invalidate(btc_tx *tx)
+{
+    tx->hash_cached = 0;
+}
+
+void btc_tx_hash_compute(const btc_tx *tx, uint8_t *hashout)
+{
+    btc_tx_hash_digest(tx, false, hashout);
+}
+
+void btc_tx_witness_hash_compute(const btc_tx *tx, uint8_t *hashout)
+{
+    btc_tx_hash_digest(tx, btc_tx_has_witness(tx), hashout);
 }
 
 
@@ -244,6 +918,16 @@ void btc_tx_in_copy(btc_tx_in *dest, const btc_tx_in *src)
         cstr_append_buf(dest->script_sig,
                         src->script_sig->str, src->script_sig->len);
     }
+
+    dest->witness_stack = NULL;
+    if (src->witness_stack) {
+        size_t i;
+        dest->witness_stack = btc_tx_witness_stack_new(src->witness_stack->len);
+        for (i = 0; i < src->witness_stack->len; i++) {
+            const cstring *item = vector_idx(src->witness_stack, i);
+            vector_add(dest->witness_stack, cstr_new_buf(item->str, item->len));
+        }
+    }
 }
 
 
@@ -266,6 +950,9 @@ void btc_tx_copy(btc_tx *dest, const btc_tx *src)
 {
     dest->version = src->version;
     dest->locktime = src->locktime;
+    dest->hash_cached = src->hash_cached;
+    memcpy(dest->txid, src->txid, sizeof(dest->txid));
+    memcpy(dest->wtxid, src->wtxid, sizeof(dest->wtxid));
 
     if (!src->vin)
         dest->vin = NULL;
@@ -309,98 +996,405 @@ void btc_tx_copy(btc_tx *dest, const btc_tx *src)
     }
 }
 
+/* step over the script op at p, returns 0 if it is truncated */
+static size_t btc_tx_script_op_len(const uint8_t *p, size_t len)
+{
+    size_t n = 1, datalen;
+    if (p[0] > OP_PUSHDATA4)
+        return 1;
+    if (p[0] < OP_PUSHDATA1)
+        datalen = p[0];
+    else if (p[0] == OP_PUSHDATA1) {
+        if (len < 2)
+            return 0;
+        datalen = p[1];
+        n = 2;
+    } else if (p[0] == OP_PUSHDATA2) {
+        if (len < 3)
+            return 0;
+        datalen = p[1] | ((size_t)p[2] << 8);
+        n = 3;
+    } else {
+        if (len < 5)
+            return 0;
+        datalen = p[1] | ((size_t)p[2] << 8) | ((size_t)p[3] << 16) | ((size_t)p[4] << 24);
+        n = 5;
+    }
+    return len - n < datalen ? 0 : n + datalen;
+}
+
+/* hash the script code: the script with its OP_CODESEPARATORs removed.
+ * Like bitcoin core, the length prefix counts the whole script and the
+ * bytes stop at a truncated push. */
+static void btc_tx_sighash_script(SHA256_CTX *ctx, const cstring *script)
+{
+    const uint8_t *p = script ? (const uint8_t *)script->str : NULL;
+    size_t len = script ? script->len : 0;
+    size_t pos, op_len, seps = 0, end = 0, start = 0;
+    uint8_t prefix[5];
+
+    for (pos = 0; pos < len; pos += op_len) {
+        op_len = btc_tx_script_op_len(p + pos, len - pos);
+        if (op_len == 0)
+            break;
+        if (p[pos] == OP_CODESEPARATOR)
+            seps++;
+        end = pos + op_len;
+    }
+    /* a truncated push still contributes its opcode and length bytes */
+    if (pos < len) {
+        end = pos + 1;
+        if (p[pos] == OP_PUSHDATA1 && len - pos >= 2)
+            end = pos + 2;
+        else if (p[pos] == OP_PUSHDATA2 && len - pos >= 3)
+            end = pos + 3;
+        else if (p[pos] == OP_PUSHDATA4 && len - pos >= 5)
+            end = pos + 5;
+    }
+
+    sha256_Update(ctx, prefix, btc_tx_write_varlen(prefix, len - seps) - prefix);
+    if (seps == 0) {
+        sha256_Update(ctx, p, end);
+        return;
+    }
+    for (pos = 0; pos < end; pos += op_len) {
+        op_len = btc_tx_script_op_len(p + pos, len - pos);
+        if (op_len == 0)
+            break;
+        if (p[pos] == OP_CODESEPARATOR) {
+            sha256_Update(ctx, p + start, pos - start);
+            start = pos + 1;
+        }
+    }
+    sha256_Update(ctx, p + start, end - start);
+}
+
 bool btc_tx_sighash(const btc_tx *tx_to, const cstring *fromPubKey, unsigned int in_num, int hashtype, uint8_t *hash)
 {
     if (in_num >= tx_to->vin->len)
         return false;
 
-    bool ret = true;
+    int base_type = hashtype & 0x1f;
+    bool anyone_can_pay = (hashtype & SIGHASH_ANYONECANPAY) != 0;
+    size_t vout_len = tx_to->vout ? tx_to->vout->len : 0;
 
-    btc_tx *tx_tmp = btc_tx_new();
-    btc_tx_copy(tx_tmp, tx_to);
+    /* Only lock-in the txout payee at same index as txin */
+    if (base_type == SIGHASH_SINGLE && in_num >= vout_len) {
+        //TODO: set error code
+        return false;
+    }
 
-    cstring *new_script = cstr_new_sz(fromPubKey->len);
-    btc_script_copy_without_op_codeseperator(fromPubKey, new_script);
+    /* hash the modified serialization directly instead of
+       copying the transaction and serializing the copy */
+    SHA256_CTX ctx;
+    uint8_t buf[44];
+    uint8_t *p;
+    size_t i, n_in, n_out;
 
-    unsigned int i;
-    btc_tx_in *tx_in;
-    for (i = 0; i < tx_tmp->vin->len; i++) {
-        tx_in = vector_idx(tx_tmp->vin, i);
-        cstr_resize(tx_in->script_sig, 0);
+    sha256_Init(&ctx);
+    p = btc_tx_write_u32(buf, tx_to->version);
 
-        if (i == in_num)
-            cstr_append_buf(tx_in->script_sig,
-                            new_script->str, new_script->len);
+    /* Blank out other inputs completely;
+     not recommended for open transactions */
+    n_in = anyone_can_pay ? 1 : tx_to->vin->len;
+    p = btc_tx_write_varlen(p, n_in);
+    sha256_Update(&ctx, buf, p - buf);
+
+    for (i = 0; i < n_in; i++) {
+        size_t in_idx = anyone_can_pay ? in_num : i;
+        const btc_tx_in *tx_in = vector_idx(tx_to->vin, in_idx);
+        uint32_t sequence = tx_in->sequence;
+
+        memcpy(buf, tx_in->prevout.hash, 32);
+        p = btc_tx_write_u32(buf + 32, tx_in->prevout.n);
+        if (in_idx == in_num) {
+            sha256_Update(&ctx, buf, p - buf);
+            btc_tx_sighash_script(&ctx, fromPubKey);
+            p = buf;
+        } else {
+            /* Let the others update at will */
+            if (base_type == SIGHASH_NONE || base_type == SIGHASH_SINGLE)
+                sequence = 0;
+            *p++ = 0;
+        }
+        p = btc_tx_write_u32(p, sequence);
+        sha256_Update(&ctx, buf, p - buf);
     }
-    cstr_free(new_script, true);
+
     /* Blank out some of the outputs */
-    if ((hashtype & 0x1f) == SIGHASH_NONE) {
-        /* Wildcard payee */
-        if (tx_tmp->vout)
-            vector_free(tx_tmp->vout, true);
-
-        tx_tmp->vout = vector_new(1, btc_tx_out_free_cb);
-
-        /* Let the others update at will */
-        for (i = 0; i < tx_tmp->vin->len; i++) {
-            tx_in = vector_idx(tx_tmp->vin, i);
-            if (i != in_num)
-                tx_in->sequence = 0;
+    if (base_type == SIGHASH_NONE)
+        n_out = 0; /* Wildcard payee */
+    else if (base_type == SIGHASH_SINGLE)
+        n_out = in_num + 1;
+    else
+        n_out = vout_len;
+    p = btc_tx_write_varlen(buf, n_out);
+    sha256_Update(&ctx, buf, p - buf);
+
+    for (i = 0; i < n_out; i++) {
+        const btc_tx_out *tx_out = vector_idx(tx_to->vout, i);
+        if (base_type == SIGHASH_SINGLE && i != in_num) {
+            /* value -1 and an empty script */
+            memset(buf, 0xff, 8);
+            buf[8] = 0;
+            sha256_Update(&ctx, buf, 9);
+            continue;
         }
+        size_t script_len = tx_out->script_pubkey ? tx_out->script_pubkey->len : 0;
+        p = btc_tx_write_u32(buf, (uint32_t)tx_out->value);
+        p = btc_tx_write_u32(p, (uint32_t)((uint64_t)tx_out->value >> 32));
+        p = btc_tx_write_varlen(p, script_len);
+        sha256_Update(&ctx, buf, p - buf);
+        if (script_len)
+            sha256_Update(&ctx, (const uint8_t *)tx_out->script_pubkey->str, script_len);
     }
 
-    else if ((hashtype & 0x1f) == SIGHASH_SINGLE) {
-        /* Only lock-in the txout payee at same index as txin */
-        unsigned int n_out = in_num;
-        if (n_out >= tx_tmp->vout->len) {
-            //TODO: set error code
-            ret = false;
-            goto out;
-        }
+    p = btc_tx_write_u32(buf, tx_to->locktime);
+    p = btc_tx_write_u32(p, (uint32_t)hashtype);
+    sha256_Update(&ctx, buf, p - buf);
 
-        vector_resize(tx_tmp->vout, n_out + 1);
+    sha256_Final(hash, &ctx);
+    sha256_Raw(hash, 32, hash);
 
-        for (i = 0; i < n_out; i++) {
-            btc_tx_out *tx_out;
+    return true;
+}
 
-            tx_out = vector_idx(tx_tmp->vout, i);
-            tx_out->value = -1;
-            if (tx_out->script_pubkey) {
-                cstr_free(tx_out->script_pubkey, true);
-                tx_out->script_pubkey = NULL;
-            }
-        }
 
-        /* Let the others update at will */
-        for (i = 0; i < tx_tmp->vin->len; i++) {
-            tx_in = vector_idx(tx_tmp->vin, i);
-            if (i != in_num)
-                tx_in->sequence = 0;
-        }
+/* BIP143 hashPrevouts, hashSequence and hashOutputs of all inputs/outputs */
+static void btc_tx_hash_prevouts(const btc_tx *tx, uint8_t *hash)
+{
+    SHA256_CTX ctx;
+    uint8_t buf[36];
+    size_t i;
+
+    sha256_Init(&ctx);
+    for (i = 0; i < tx->vin->len; i++) {
+        const btc_tx_in *tx_in = vector_idx(tx->vin, i);
+        memcpy(buf, tx_in->prevout.hash, 32);
+        btc_tx_write_u32(buf + 32, tx_in->prevout.n);
+        sha256_Update(&ctx, buf, sizeof(buf));
     }
-    
-    /* Blank out other inputs completely;
-     not recommended for open transactions */
-    if (hashtype & SIGHASH_ANYONECANPAY) {
-        if (in_num > 0)
-            vector_remove_range(tx_tmp->vin, 0, in_num);
-        vector_resize(tx_tmp->vin, 1);
+    sha256_Final(hash, &ctx);
+    sha256_Raw(hash, SHA256_DIGEST_LENGTH, hash);
+}
+
+static void btc_tx_hash_sequence(const btc_tx *tx, uint8_t *hash)
+{
+    SHA256_CTX ctx;
+    uint8_t buf[4];
+    size_t i;
+
+    sha256_Init(&ctx);
+    for (i = 0; i < tx->vin->len; i++) {
+        const btc_tx_in *tx_in = vector_idx(tx->vin, i);
+        btc_tx_write_u32(buf, tx_in->sequence);
+        sha256_Update(&ctx, buf, sizeof(buf));
     }
+    sha256_Final(hash, &ctx);
+    sha256_Raw(hash, SHA256_DIGEST_LENGTH, hash);
+}
 
-    cstring *s = cstr_new_sz(512);
-    btc_tx_serialize(s, tx_tmp);
-    char hextest[4096];
-    ser_s32(s, hashtype);
+/* all outputs, or only out_num when it is not SIZE_MAX */
+static void btc_tx_hash_outputs_range(const btc_tx *tx, size_t out_num, uint8_t *hash)
+{
+    size_t vout_len = tx->vout ? tx->vout->len : 0;
+    SHA256_CTX ctx;
+    size_t i;
+
+    sha256_Init(&ctx);
+    for (i = 0; i < vout_len; i++)
+        if (out_num == SIZE_MAX || i == out_num)
+            btc_tx_hash_output(&ctx, vector_idx(tx->vout, i));
+    sha256_Final(hash, &ctx);
+    sha256_Raw(hash, SHA256_DIGEST_LENGTH, hash);
+}
 
-    utils_bin_to_hex((unsigned char *)s->str, s->len, hextest);
+static void btc_tx_hash_outputs(const btc_tx *tx, uint8_t *hash)
+{
+    btc_tx_hash_outputs_range(tx, SIZE_MAX, hash);
+}
 
-    sha256_Raw((const uint8_t *)s->str, s->len, hash);
-    sha256_Raw(hash, 32, hash);
+/* BIP143 digest from the given all-input/all-output hashes,
+   which are only read when the hash type commits to them */
+static void btc_tx_sighash_v0(const btc_tx *tx, const uint8_t *hash_prevouts, const uint8_t *hash_sequence, const uint8_t *hash_outputs, const cstring *script_code, unsigned int in_num, int hashtype, int64_t amount, uint8_t *hash)
+{
+    int base_type = hashtype & 0x1f;
+    bool anyone_can_pay = (hashtype & SIGHASH_ANYONECANPAY) != 0;
+    size_t vout_len = tx->vout ? tx->vout->len : 0;
+    const btc_tx_in *tx_in = vector_idx(tx->vin, in_num);
+    size_t script_len = script_code ? script_code->len : 0;
+    SHA256_CTX ctx;
+    uint8_t buf[4 + 32 + 32 + 36 + 5];
+    uint8_t *p;
+
+    sha256_Init(&ctx);
+    p = btc_tx_write_u32(buf, tx->version);
+    if (anyone_can_pay)
+        memset(p, 0, 32);
+    else
+        memcpy(p, hash_prevouts, 32);
+    p += 32;
+    if (anyone_can_pay || base_type == SIGHASH_SINGLE || base_type == SIGHASH_NONE)
+        memset(p, 0, 32);
+    else
+        memcpy(p, hash_sequence, 32);
+    p += 32;
+    memcpy(p, tx_in->prevout.hash, 32);
+    p = btc_tx_write_u32(p + 32, tx_in->prevout.n);
+    p = btc_tx_write_varlen(p, script_len);
+    sha256_Update(&ctx, buf, p - buf);
+    if (script_len)
+        sha256_Update(&ctx, (const uint8_t *)script_code->str, script_len);
+
+    p = btc_tx_write_u32(buf, (uint32_t)amount);
+    p = btc_tx_write_u32(p, (uint32_t)((uint64_t)amount >> 32));
+    p = btc_tx_write_u32(p, tx_in->sequence);
+    if (base_type != SIGHASH_SINGLE && base_type != SIGHASH_NONE)
+        memcpy(p, hash_outputs, 32);
+    else if (base_type == SIGHASH_SINGLE && in_num < vout_len)
+        btc_tx_hash_outputs_range(tx, in_num, p);
+    else
+        memset(p, 0, 32);
+    p = btc_tx_write_u32(p + 32, tx->locktime);
+    p = btc_tx_write_u32(p, (uint32_t)hashtype);
+    sha256_Update(&ctx, buf, p - buf);
+
+    sha256_Final(hash, &ctx);
+    sha256_Raw(hash, SHA256_DIGEST_LENGTH, hash);
+}
+
+bool btc_tx_sighash_witness_v0(const btc_tx *tx_to, const cstring *script_code, unsigned int in_num, int hashtype, int64_t amount, uint8_t *hash)
+{
+    uint8_t hash_prevouts[SHA256_DIGEST_LENGTH];
+    uint8_t hash_sequence[SHA256_DIGEST_LENGTH];
+    uint8_t hash_outputs[SHA256_DIGEST_LENGTH];
+    int base_type = hashtype & 0x1f;
+
+    if (in_num >= tx_to->vin->len)
+        return false;
+
+    /* only the hashes the hash type commits to */
+    if (!(hashtype & SIGHASH_ANYONECANPAY)) {
+        btc_tx_hash_prevouts(tx_to, hash_prevouts);
+        if (base_type != SIGHASH_SINGLE && base_type != SIGHASH_NONE)
+            btc_tx_hash_sequence(tx_to, hash_sequence);
+    }
+    if (base_type != SIGHASH_SINGLE && base_type != SIGHASH_NONE)
+        btc_tx_hash_outputs(tx_to, hash_outputs);
+
+    btc_tx_sighash_v0(tx_to, hash_prevouts, hash_sequence, hash_outputs, script_code, in_num, hashtype, amount, hash);
+    return true;
+}
+
+struct btc_tx_sighash_cache_
+{
+    const btc_tx *tx;
+    /* BIP143 double sha256 of all prevouts, sequences and outputs */
+    uint8_t hash_prevouts[SHA256_DIGEST_LENGTH];
+    uint8_t hash_sequence[SHA256_DIGEST_LENGTH];
+    uint8_t hash_outputs[SHA256_DIGEST_LENGTH];
+    /* SIGHASH_ALL preimage with every script_sig empty,
+       input i's empty script (one zero byte) is at script_pos[i] */
+    uint8_t *legacy;
+    size_t legacy_len;
+    size_t *script_pos;
+    /* hash state after legacy[0 .. script_pos[i]) */
+    SHA256_CTX *prefix;
+};
+
+btc_tx_sighash_cache* btc_tx_sighash_cache_new(const btc_tx *tx)
+{
+    size_t vin_len = tx->vin ? tx->vin->len : 0;
+    size_t vout_len = tx->vout ? tx->vout->len : 0;
+    size_t i, pos;
+    btc_tx_sighash_cache *cache;
+    SHA256_CTX ctx;
+    uint8_t *p;
+
+    cache = calloc(1, sizeof(*cache));
+    if (!cache)
+        return NULL;
+    cache->tx = tx;
+    cache->legacy_len = btc_tx_base_size(tx);
+    for (i = 0; i < vin_len; i++) {
+        const btc_tx_in *tx_in = vector_idx(tx->vin, i);
+        cache->legacy_len -= btc_tx_script_size(tx_in->script_sig) - 1;
+    }
+    cache->legacy = malloc(cache->legacy_len);
+    cache->script_pos = malloc((vin_len ? vin_len : 1) * sizeof(*cache->script_pos));
+    cache->prefix = malloc((vin_len ? vin_len : 1) * sizeof(*cache->prefix));
+    if (!cache->legacy || !cache->script_pos || !cache->prefix) {
+        btc_tx_sighash_cache_free(cache);
+        return NULL;
+    }
+
+    p = btc_tx_write_u32(cache->legacy, tx->version);
+    p = btc_tx_write_varlen(p, vin_len);
+    for (i = 0; i < vin_len; i++) {
+        const btc_tx_in *tx_in = vector_idx(tx->vin, i);
+        memcpy(p, tx_in->prevout.hash, 32);
+        p = btc_tx_write_u32(p + 32, tx_in->prevout.n);
+        cache->script_pos[i] = p - cache->legacy;
+        *p++ = 0;
+        p = btc_tx_write_u32(p, tx_in->sequence);
+    }
+    p = btc_tx_write_varlen(p, vout_len);
+    p = btc_tx_write_outputs(p, tx);
+    btc_tx_write_u32(p, tx->locktime);
+
+    btc_tx_hash_prevouts(tx, cache->hash_prevouts);
+    btc_tx_hash_sequence(tx, cache->hash_sequence);
+    btc_tx_hash_outputs(tx, cache->hash_outputs);
+
+    /* one pass over the preimage records the state before every input script */
+    sha256_Init(&ctx);
+    for (i = 0, pos = 0; i < vin_len; i++) {
+        sha256_Update(&ctx, cache->legacy + pos, cache->script_pos[i] - pos);
+        pos = cache->script_pos[i];
+        cache->prefix[i] = ctx;
+    }
+    return cache;
+}
+
+void btc_tx_sighash_cache_free(btc_tx_sighash_cache *cache)
+{
+    if (!cache)
+        return;
+    free(cache->legacy);
+    free(cache->script_pos);
+    free(cache->prefix);
+    free(cache);
+}
+
+bool btc_tx_sighash_cached(const btc_tx_sighash_cache *cache, const cstring *fromPubKey, unsigned int in_num, int hashtype, uint8_t *hash)
+{
+    int base_type = hashtype & 0x1f;
+    const btc_tx *tx = cache->tx;
 
-    cstr_free(s, true);
+    /* other hash types change the invariant parts (ANYONECANPAY hashes a single input anyway) */
+    if (base_type == SIGHASH_NONE || base_type == SIGHASH_SINGLE || (hashtype & SIGHASH_ANYONECANPAY))
+        return btc_tx_sighash(tx, fromPubKey, in_num, hashtype, hash);
+    if (in_num >= tx->vin->len)
+        return false;
+
+    SHA256_CTX ctx = cache->prefix[in_num];
+    size_t suffix = cache->script_pos[in_num] + 1;
+    uint8_t buf[4];
 
-out:
-    btc_tx_free(tx_tmp);
+    btc_tx_sighash_script(&ctx, fromPubKey);
+    sha256_Update(&ctx, cache->legacy + suffix, cache->legacy_len - suffix);
+    btc_tx_write_u32(buf, (uint32_t)hashtype);
+    sha256_Update(&ctx, buf, 4);
+    sha256_Final(hash, &ctx);
+    sha256_Raw(hash, 32, hash);
+    return true;
+}
 
-    return ret;
+bool btc_tx_sighash_witness_v0_cached(const btc_tx_sighash_cache *cache, const cstring *script_code, unsigned int in_num, int hashtype, int64_t amount, uint8_t *hash)
+{
+    if (in_num >= cache->tx->vin->len)
+        return false;
+
+    btc_tx_sighash_v0(cache->tx, cache->hash_prevouts, cache->hash_sequence, cache->hash_outputs, script_code, in_num, hashtype, amount, hash);
+    return true;
 }
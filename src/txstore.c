@@ -0,0 +1,301 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Jonas Schnelli
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "btc/txstore.h"
+
+#include "sha2.h"
+
+/* first capacity of the columns, they double from there */
+#define BTC_TXSTORE_MIN_ALLOC 16
+
+static bool btc_txstore_realloc(void **column, size_t count, size_t elem_size)
+{
+    void *p = realloc(*column, count * elem_size);
+    if (!p)
+        return false;
+    *column = p;
+    return true;
+}
+
+static size_t btc_txstore_capacity(size_t alloc, size_t need)
+{
+    size_t cap = alloc ? alloc : BTC_TXSTORE_MIN_ALLOC;
+    while (cap < need)
+        cap *= 2;
+    return cap;
+}
+
+/* the per transaction columns, the start columns keep one entry more for the end */
+static bool btc_txstore_reserve_txs(btc_txstore *store, size_t need)
+{
+    size_t cap;
+    if (need <= store->tx_alloc)
+        return true;
+    cap = btc_txstore_capacity(store->tx_alloc, need);
+    if (!btc_txstore_realloc((void **)&store->txid, cap, sizeof(uint256)) ||
+        !btc_txstore_realloc((void **)&store->version, cap, sizeof(uint32_t)) ||
+        !btc_txstore_realloc((void **)&store->locktime, cap, sizeof(uint32_t)) ||
+        !btc_txstore_realloc((void **)&store->tx_vin_start, cap + 1, sizeof(size_t)) ||
+        !btc_txstore_realloc((void **)&store->tx_vout_start, cap + 1, sizeof(size_t)))
+        return false;
+    store->tx_alloc = cap;
+    return true;
+}
+
+static bool btc_txstore_reserve_vin(btc_txstore *store, size_t need)
+{
+    size_t cap;
+    if (need <= store->vin_alloc)
+        return true;
+    cap = btc_txstore_capacity(store->vin_alloc, need);
+    if (!btc_txstore_realloc((void **)&store->prevout_hash, cap, sizeof(uint256)) ||
+        !btc_txstore_realloc((void **)&store->prevout_n, cap, sizeof(uint32_t)) ||
+        !btc_txstore_realloc((void **)&store->sequence, cap, sizeof(uint32_t)))
+        return false;
+    store->vin_alloc = cap;
+    return true;
+}
+
+static bool btc_txstore_reserve_vout(btc_txstore *store, size_t need)
+{
+    size_t cap;
+    if (need <= store->vout_alloc)
+        return true;
+    cap = btc_txstore_capacity(store->vout_alloc, need);
+    if (!btc_txstore_realloc((void **)&store->value, cap, sizeof(int64_t)) ||
+        !btc_txstore_realloc((void **)&store->script_start, cap + 1, sizeof(size_t)))
+        return false;
+    store->vout_alloc = cap;
+    return true;
+}
+
+static bool btc_txstore_reserve_scripts(btc_txstore *store, size_t need)
+{
+    size_t cap;
+    if (need <= store->script_alloc)
+        return true;
+    cap = btc_txstore_capacity(store->script_alloc, need);
+    if (!btc_txstore_realloc((void **)&store->script_bytes, cap, 1))
+        return false;
+    store->script_alloc = cap;
+    return true;
+}
+
+bool btc_txstore_init(btc_txstore *store)
+{
+    memset(store, 0, sizeof(*store));
+    store->scratch = btc_arena_new(0);
+    if (!store->scratch ||
+        !btc_txstore_reserve_txs(store, 1) ||
+        !btc_txstore_reserve_vin(store, 1) ||
+        !btc_txstore_reserve_vout(store, 1) ||
+        !btc_txstore_reserve_scripts(store, 1)) {
+        btc_txstore_free(store);
+        return false;
+    }
+    store->tx_vin_start[0] = 0;
+    store->tx_vout_start[0] = 0;
+    store->script_start[0] = 0;
+    return true;
+}
+
+void btc_txstore_free(btc_txstore *store)
+{
+    free(store->txid);
+    free(store->version);
+    free(store->locktime);
+    free(store->tx_vin_start);
+    free(store->tx_vout_start);
+    free(store->prevout_hash);
+    free(store->prevout_n);
+    free(store->sequence);
+    free(store->value);
+    free(store->script_start);
+    free(store->script_bytes);
+    if (store->scratch)
+        btc_arena_free(store->scratch);
+    memset(store, 0, sizeof(*store));
+}
+
+void btc_txstore_clear(btc_txstore *store)
+{
+    store->tx_count = 0;
+    store->vin_count = 0;
+    store->vout_count = 0;
+}
+
+/* txid of a viewed transaction: the witness marker, flag and stacks are left out */
+static void btc_txstore_txid(const btc_tx_view *view, uint256 txid)
+{
+    if (!view->has_witness) {
+        sha256_Raw(view->data, view->size, txid);
+    } else {
+        SHA256_CTX ctx;
+        sha256_Init(&ctx);
+        sha256_Update(&ctx, view->data, 4);
+        /* inputs and outputs run from after the flag to the first witness stack */
+        sha256_Update(&ctx, view->data + 6, view->vin[0].witness_offset - 6);
+        sha256_Update(&ctx, view->data + view->size - 4, 4);
+        sha256_Final(txid, &ctx);
+    }
+    sha256_Raw(txid, SHA256_DIGEST_LENGTH, txid);
+}
+
+static bool btc_txstore_add(btc_txstore *store, const btc_tx_view *view)
+{
+    size_t i, n, script_len = 0, script_pos;
+
+    for (i = 0; i < view->vout_count; i++)
+        script_len += view->vout[i].script_len;
+    script_pos = store->script_start[store->vout_count];
+    if (!btc_txstore_reserve_txs(store, store->tx_count + 1) ||
+        !btc_txstore_reserve_vin(store, store->vin_count + view->vin_count) ||
+        !btc_txstore_reserve_vout(store, store->vout_count + view->vout_count) ||
+        !btc_txstore_reserve_scripts(store, script_pos + script_len))
+        return false;
+
+    n = store->tx_count;
+    btc_txstore_txid(view, store->txid[n]);
+    store->version[n] = view->version;
+    store->locktime[n] = view->locktime;
+
+    n = store->vin_count;
+    for (i = 0; i < view->vin_count; i++, n++) {
+        memcpy(store->prevout_hash[n], btc_tx_view_prevout_hash(view, i), sizeof(uint256));
+        store->prevout_n[n] = btc_tx_view_prevout_n(view, i);
+        store->sequence[n] = btc_tx_view_sequence(view, i);
+    }
+
+    n = store->vout_count;
+    for (i = 0; i < view->vout_count; i++, n++) {
+        const btc_tx_view_item *item = &view->vout[i];
+        store->value[n] = btc_tx_view_value(view, i);
+        memcpy(store->script_bytes + script_pos, view->data + item->script_offset, item->script_len);
+        script_pos += item->script_len;
+        store->script_start[n + 1] = script_pos;
+    }
+
+    store->tx_count++;
+    store->vin_count += view->vin_count;
+    store->vout_count += view->vout_count;
+    store->tx_vin_start[store->tx_count] = store->vin_count;
+    store->tx_vout_start[store->tx_count] = store->vout_count;
+    return true;
+}
+
+size_t btc_txstore_append(btc_txstore *store, const uint8_t *data, size_t len, size_t count)
+{
+    size_t tx_count = store->tx_count, vin_count = store->vin_count, vout_count = store->vout_count;
+    size_t pos = 0;
+    btc_tx_view view;
+    bool ok;
+
+    while (count-- > 0) {
+        btc_arena_reset(store->scratch);
+        if (!btc_tx_view_parse(&view, data + pos, len - pos, store->scratch))
+            goto fail;
+        ok = btc_txstore_add(store, &view);
+        pos += view.size;
+        btc_tx_view_free(&view);
+        if (!ok)
+            goto fail;
+    }
+    return pos;
+
+fail:
+    /* the end entries of the restored counts are still in place */
+    store->tx_count = tx_count;
+    store->vin_count = vin_count;
+    store->vout_count = vout_count;
+    return 0;
+}
+
+const uint8_t* btc_txstore_script_pubkey(const btc_txstore *store, size_t out_num, size_t *len)
+{
+    if (out_num >= store->vout_count)
+        return NULL;
+    *len = store->script_start[out_num + 1] - store->script_start[out_num];
+    return store->script_bytes + store->script_start[out_num];
+}
+
+/* last transaction starting at or before num, transactions without entries are passed over */
+static size_t btc_txstore_find_tx(const size_t *start, size_t tx_count, size_t num)
+{
+    size_t lo = 0, hi = tx_count;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (start[mid] <= num)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+size_t btc_txstore_output_tx(const btc_txstore *store, size_t out_num)
+{
+    return btc_txstore_find_tx(store->tx_vout_start, store->tx_count, out_num);
+}
+
+size_t btc_txstore_input_tx(const btc_txstore *store, size_t in_num)
+{
+    return btc_txstore_find_tx(store->tx_vin_start, store->tx_count, in_num);
+}
+
+size_t btc_txstore_next_value(const btc_txstore *store, int64_t min, int64_t max, size_t from)
+{
+    const int64_t *value = store->value;
+    size_t i;
+    for (i = from; i < store->vout_count; i++)
+        if (value[i] >= min && value[i] <= max)
+            break;
+    return i;
+}
+
+size_t btc_txstore_next_script(const btc_txstore *store, const uint8_t *script, size_t len, size_t from)
+{
+    const size_t *start = store->script_start;
+    size_t i;
+    for (i = from; i < store->vout_count; i++)
+        if (start[i + 1] - start[i] == len && memcmp(store->script_bytes + start[i], script, len) == 0)
+            break;
+    return i;
+}
+
+size_t btc_txstore_next_prevout(const btc_txstore *store, const uint256 hash, uint32_t n, size_t from)
+{
+    size_t i;
+    for (i = from; i < store->vin_count; i++)
+        if (store->prevout_n[i] == n && memcmp(store->prevout_hash[i], hash, sizeof(uint256)) == 0)
+            break;
+    return i;
+}
@@ -25,16 +25,37 @@
 
 */
 
+#if defined HAVE_CONFIG_H
+#include "libbtc-config.h"
+#endif
+
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <inttypes.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "utils.h"
+#include "sha2.h"
+
+#ifdef ENABLE_AVX2
+size_t utils_hex_encode_avx2(const uint8_t *bin, size_t len, char *hex);
+size_t utils_hex_decode_avx2(const char *hex, size_t len, uint8_t *bin);
+#endif
+
 
+/* the result buffers of utils_hex_to_uint8/utils_uint8_to_hex, one set per thread */
+#ifdef HAVE_THREAD_LOCAL
+#define UTILS_THREAD_LOCAL __thread
+#else
+#define UTILS_THREAD_LOCAL
+#endif
 
-static uint8_t buffer_hex_to_uint8[TO_UINT8_HEX_BUF_LEN];
-static char buffer_uint8_to_hex[TO_UINT8_HEX_BUF_LEN];
+static UTILS_THREAD_LOCAL uint8_t buffer_hex_to_uint8[TO_UINT8_HEX_BUF_LEN];
+static UTILS_THREAD_LOCAL char buffer_uint8_to_hex[TO_UINT8_HEX_BUF_LEN];
 
 
 void utils_clear_buffers(void)
@@ -43,35 +64,144 @@ void utils_clear_buffers(void)
     memset(buffer_uint8_to_hex, 0, TO_UINT8_HEX_BUF_LEN);
 }
 
-void utils_hex_to_bin(const char *str, unsigned char *out, int inLen, int *outLen)
+static const char hex_digits[] = "0123456789abcdef";
+
+/* value of a hex digit, -1 for any other character */
+static const int8_t hex_digits_map[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+#if defined(__SSE2__)
+/* nibble values of 16 hex characters, valid is set if all were hex digits */
+static inline __m128i hex_nibbles_sse2(__m128i v, int *valid)
 {
-    int bLen = inLen / 2;
-    memset(out, 0, bLen);
-    uint8_t c;
-    int i;
-    for (i = 0; i < bLen; i++) {
-        c = 0;
-        if (str[i * 2] >= '0' && str[i * 2] <= '9') {
-            *out = (str[i * 2] - '0') << 4;
-        }
-        if (str[i * 2] >= 'a' && str[i * 2] <= 'f') {
-            *out = (10 + str[i  * 2] - 'a') << 4;
-        }
-        if (str[i * 2] >= 'A' && str[i * 2] <= 'F') {
-            *out = (10 + str[i * 2] - 'A') << 4;
-        }
-        if (str[i * 2 + 1] >= '0' && str[i * 2 + 1] <= '9') {
-            *out |= (str[i * 2 + 1] - '0');
-        }
-        if (str[i * 2 + 1] >= 'a' && str[i * 2 + 1] <= 'f') {
-            *out |= (10 + str[i * 2 + 1] - 'a');
+    const __m128i d = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+    const __m128i l = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    const __m128i isdigit = _mm_and_si128(_mm_cmpgt_epi8(d, _mm_set1_epi8(-1)),
+                                          _mm_cmplt_epi8(d, _mm_set1_epi8(10)));
+    const __m128i isalpha = _mm_and_si128(_mm_cmpgt_epi8(l, _mm_set1_epi8(-1)),
+                                          _mm_cmplt_epi8(l, _mm_set1_epi8(6)));
+    *valid = _mm_movemask_epi8(_mm_or_si128(isdigit, isalpha)) == 0xffff;
+    return _mm_or_si128(_mm_and_si128(isdigit, d),
+                        _mm_and_si128(isalpha, _mm_add_epi8(l, _mm_set1_epi8(10))));
+}
+
+/* pair up the nibbles of each 16 bit lane: high nibble first */
+static inline __m128i hex_pack_sse2(__m128i n)
+{
+    return _mm_or_si128(_mm_slli_epi16(_mm_and_si128(n, _mm_set1_epi16(0x00ff)), 4),
+                        _mm_srli_epi16(n, 8));
+}
+#endif
+
+void utils_hex_encode(const uint8_t *bin, size_t len, char *hex)
+{
+    size_t i = 0;
+
+#ifdef ENABLE_AVX2
+    if (sha2_get_features() & SHA2_CPU_AVX2) {
+        i = utils_hex_encode_avx2(bin, len, hex);
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i alpha = _mm_set1_epi8('a' - '0' - 10);
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(bin + i));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+        __m128i lo = _mm_and_si128(v, mask);
+        hi = _mm_add_epi8(_mm_add_epi8(hi, zero), _mm_and_si128(_mm_cmpgt_epi8(hi, nine), alpha));
+        lo = _mm_add_epi8(_mm_add_epi8(lo, zero), _mm_and_si128(_mm_cmpgt_epi8(lo, nine), alpha));
+        _mm_storeu_si128((__m128i *)(hex + 2 * i), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *)(hex + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+#endif
+    for (; i < len; i++) {
+        hex[i * 2] = hex_digits[bin[i] >> 4];
+        hex[i * 2 + 1] = hex_digits[bin[i] & 0xF];
+    }
+    hex[len * 2] = '\0';
+}
+
+bool utils_hex_decode(const char *hex, size_t hexlen, uint8_t *bin)
+{
+    const unsigned char *h = (const unsigned char *)hex;
+    size_t len = hexlen / 2, i = 0;
+    int hi, lo;
+
+    if (hexlen & 1) {
+        return false;
+    }
+#ifdef ENABLE_AVX2
+    if (sha2_get_features() & SHA2_CPU_AVX2) {
+        i = utils_hex_decode_avx2(hex, len, bin);
+    }
+#endif
+#if defined(__SSE2__)
+    /* 32 characters per step, an invalid block is left to the scalar loop */
+    for (; i + 16 <= len; i += 16) {
+        int valid1, valid2;
+        __m128i a = hex_nibbles_sse2(_mm_loadu_si128((const __m128i *)(hex + 2 * i)), &valid1);
+        __m128i b = hex_nibbles_sse2(_mm_loadu_si128((const __m128i *)(hex + 2 * i + 16)), &valid2);
+        if (!(valid1 & valid2)) {
+            break;
         }
-        if (str[i * 2 + 1] >= 'A' && str[i * 2 + 1] <= 'F') {
-            *out |= (10 + str[i * 2 + 1] - 'A');
+        _mm_storeu_si128((__m128i *)(bin + i), _mm_packus_epi16(hex_pack_sse2(a), hex_pack_sse2(b)));
+    }
+#endif
+    for (; i < len; i++) {
+        hi = hex_digits_map[h[i * 2]];
+        lo = hex_digits_map[h[i * 2 + 1]];
+        if ((hi | lo) < 0) {
+            return false;
         }
-        out++;
+        bin[i] = (hi << 4) | lo;
+    }
+    return true;
+}
+
+/* the old decoding rules: a non hex character counts as a 0 nibble */
+static void utils_hex_decode_lenient(const char *str, size_t len, uint8_t *out)
+{
+    const unsigned char *h = (const unsigned char *)str;
+    int hi, lo;
+    size_t i;
+
+    if (utils_hex_decode(str, len * 2, out)) {
+        return;
+    }
+    for (i = 0; i < len; i++) {
+        hi = hex_digits_map[h[i * 2]];
+        lo = hex_digits_map[h[i * 2 + 1]];
+        out[i] = ((hi < 0 ? 0 : hi) << 4) | (lo < 0 ? 0 : lo);
     }
-    *outLen = i;
+}
+
+void utils_hex_to_bin(const char *str, unsigned char *out, int inLen, int *outLen)
+{
+    int bLen = inLen / 2;
+    if (bLen < 0) {
+        bLen = 0;
+    }
+    utils_hex_decode_lenient(str, bLen, out);
+    *outLen = bLen;
 }
 
 uint8_t *utils_hex_to_uint8(const char *str)
@@ -80,43 +210,14 @@ uint8_t *utils_hex_to_uint8(const char *str)
         return NULL;
     }
     memset(buffer_hex_to_uint8, 0, TO_UINT8_HEX_BUF_LEN);
-    uint8_t c;
-    size_t i;
-    for (i = 0; i < strlens(str) / 2; i++) {
-        c = 0;
-        if (str[i * 2] >= '0' && str[i * 2] <= '9') {
-            c += (str[i * 2] - '0') << 4;
-        }
-        if (str[i * 2] >= 'a' && str[i * 2] <= 'f') {
-            c += (10 + str[i  * 2] - 'a') << 4;
-        }
-        if (str[i * 2] >= 'A' && str[i * 2] <= 'F') {
-            c += (10 + str[i * 2] - 'A') << 4;
-        }
-        if (str[i * 2 + 1] >= '0' && str[i * 2 + 1] <= '9') {
-            c += (str[i * 2 + 1] - '0');
-        }
-        if (str[i * 2 + 1] >= 'a' && str[i * 2 + 1] <= 'f') {
-            c += (10 + str[i * 2 + 1] - 'a');
-        }
-        if (str[i * 2 + 1] >= 'A' && str[i * 2 + 1] <= 'F') {
-            c += (10 + str[i * 2 + 1] - 'A');
-        }
-        buffer_hex_to_uint8[i] = c;
-    }
+    utils_hex_decode_lenient(str, strlens(str) / 2, buffer_hex_to_uint8);
     return buffer_hex_to_uint8;
 }
 
 
 void utils_bin_to_hex(unsigned char *bin_in, size_t inlen, char *hex_out)
 {
-    static char digits[] = "0123456789abcdef";
-    size_t i;
-    for (i = 0; i < inlen; i++) {
-        hex_out[i * 2] = digits[(bin_in[i] >> 4) & 0xF];
-        hex_out[i * 2 + 1] = digits[bin_in[i] & 0xF];
-    }
-    hex_out[inlen * 2] = '\0';
+    utils_hex_encode(bin_in, inlen, hex_out);
 }
 
 
@@ -125,26 +226,24 @@ char *utils_uint8_to_hex(const uint8_t *bin, size_t l)
     if (l > (TO_UINT8_HEX_BUF_LEN / 2 - 1)) {
         return NULL;
     }
-    static char digits[] = "0123456789abcdef";
     memset(buffer_uint8_to_hex, 0, TO_UINT8_HEX_BUF_LEN);
-    size_t i;
-    for (i = 0; i < l; i++) {
-        buffer_uint8_to_hex[i * 2] = digits[(bin[i] >> 4) & 0xF];
-        buffer_uint8_to_hex[i * 2 + 1] = digits[bin[i] & 0xF];
-    }
-    buffer_uint8_to_hex[l * 2] = '\0';
+    utils_hex_encode(bin, l, buffer_uint8_to_hex);
     return buffer_uint8_to_hex;
 }
 
 
 void utils_reverse_hex(char *h, int len)
 {
-    char copy[len];
-    strncpy(copy, h, len);
-    int i;
-    for (i = 0; i < len; i += 2) {
-        h[i] = copy[len - i - 2];
-        h[i + 1] = copy[len - i - 1];
+    int i, j;
+    char c;
+    /* swap the hex digit pairs from both ends, in place */
+    for (i = 0, j = len - 2; i < j; i += 2, j -= 2) {
+        c = h[i];
+        h[i] = h[j];
+        h[j] = c;
+        c = h[i + 1];
+        h[i + 1] = h[j + 1];
+        h[j + 1] = c;
     }
 }
 
@@ -30,6 +30,7 @@
 #define _UTILS_H_
 
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
@@ -40,7 +41,17 @@
 #define strlens(s) (s == NULL ? 0 : strlen(s))
 
 
+/* utils_hex_to_uint8 and utils_uint8_to_hex return a buffer that is private
+ * to the calling thread (if the compiler has thread local storage) and is
+ * overwritten by the thread's next call. Code that keeps results around or
+ * must not depend on thread local storage uses utils_hex_decode and
+ * utils_hex_encode with its own buffers; every other helper is reentrant. */
 void utils_clear_buffers(void);
+/* lower case hex of len bytes into hex (2 * len + 1 bytes, terminated) */
+void utils_hex_encode(const uint8_t *bin, size_t len, char *hex);
+/* decode hexlen characters (no terminator needed) into hexlen / 2 bytes,
+ * false for an odd length or a non hex character (bin is then undefined) */
+bool utils_hex_decode(const char *hex, size_t hexlen, uint8_t *bin);
 void utils_hex_to_bin(const char *str, unsigned char *out, int inLen, int *outLen);
 void utils_bin_to_hex(unsigned char *bin_in, size_t inlen, char *hex_out);
 uint8_t *utils_hex_to_uint8(const char *str);
@@ -0,0 +1,103 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Jonas Schnelli
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+/*
+ * Hex encoding and decoding, 32 bytes per step using AVX2. This file is
+ * compiled with -mavx -mavx2 and must only be called after
+ * sha2_auto_detect() has confirmed CPU and OS support.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <immintrin.h>
+
+/* encode the largest multiple of 32 of len bytes, returns the bytes done */
+size_t utils_hex_encode_avx2(const uint8_t *bin, size_t len, char *hex)
+{
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    const __m256i nine = _mm256_set1_epi8(9);
+    const __m256i zero = _mm256_set1_epi8('0');
+    const __m256i alpha = _mm256_set1_epi8('a' - '0' - 10);
+    size_t i;
+
+    for (i = 0; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(bin + i));
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), mask);
+        __m256i lo = _mm256_and_si256(v, mask);
+        hi = _mm256_add_epi8(_mm256_add_epi8(hi, zero), _mm256_and_si256(_mm256_cmpgt_epi8(hi, nine), alpha));
+        lo = _mm256_add_epi8(_mm256_add_epi8(lo, zero), _mm256_and_si256(_mm256_cmpgt_epi8(lo, nine), alpha));
+        /* the unpacks work per 128 bit lane, swap the middle quarters back */
+        __m256i a = _mm256_unpacklo_epi8(hi, lo);
+        __m256i b = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256((__m256i *)(hex + 2 * i), _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256((__m256i *)(hex + 2 * i + 32), _mm256_permute2x128_si256(a, b, 0x31));
+    }
+    _mm256_zeroupper();
+    return i;
+}
+
+/* nibble values of 32 hex characters, valid is all ones if every one was a hex digit */
+static inline __m256i hex_nibbles_avx2(__m256i v, int *valid)
+{
+    const __m256i d = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+    const __m256i l = _mm256_sub_epi8(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    const __m256i isdigit = _mm256_and_si256(_mm256_cmpgt_epi8(d, _mm256_set1_epi8(-1)),
+                                             _mm256_cmpgt_epi8(_mm256_set1_epi8(10), d));
+    const __m256i isalpha = _mm256_and_si256(_mm256_cmpgt_epi8(l, _mm256_set1_epi8(-1)),
+                                             _mm256_cmpgt_epi8(_mm256_set1_epi8(6), l));
+    *valid = _mm256_movemask_epi8(_mm256_or_si256(isdigit, isalpha)) == -1;
+    return _mm256_or_si256(_mm256_and_si256(isdigit, d),
+                           _mm256_and_si256(isalpha, _mm256_add_epi8(l, _mm256_set1_epi8(10))));
+}
+
+/* pair up the nibbles of each 16 bit lane: high nibble first */
+static inline __m256i hex_pack_avx2(__m256i n)
+{
+    return _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(n, _mm256_set1_epi16(0x00ff)), 4),
+                           _mm256_srli_epi16(n, 8));
+}
+
+/* decode 64 character blocks into the largest multiple of 32 of len bytes,
+ * returns the bytes done, stopping before the first block with a non hex
+ * character (the caller's scalar code reports the error) */
+size_t utils_hex_decode_avx2(const char *hex, size_t len, uint8_t *bin)
+{
+    size_t i;
+    int valid1, valid2;
+
+    for (i = 0; i + 32 <= len; i += 32) {
+        __m256i a = hex_nibbles_avx2(_mm256_loadu_si256((const __m256i *)(hex + 2 * i)), &valid1);
+        __m256i b = hex_nibbles_avx2(_mm256_loadu_si256((const __m256i *)(hex + 2 * i + 32)), &valid2);
+        if (!(valid1 & valid2)) {
+            break;
+        }
+        /* packus works per 128 bit lane, restore the order of the quarters */
+        __m256i r = _mm256_packus_epi16(hex_pack_avx2(a), hex_pack_avx2(b));
+        _mm256_storeu_si256((__m256i *)(bin + i), _mm256_permute4x64_epi64(r, 0xd8));
+    }
+    _mm256_zeroupper();
+    return i;
+}
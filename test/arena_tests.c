@@ -0,0 +1,65 @@
+/**********************************************************************
+ * Copyright (c) 2015 Jonas Schnelli                                  *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+
+#include <stdint.h>
+#include <string.h>
+
+#include <btc/arena.h>
+
+#include "utest.h"
+
+void test_arena()
+{
+    btc_arena *arena = btc_arena_new(256);
+    uint8_t *p, *q, *big;
+    size_t i;
+
+    /* allocations are aligned and do not overlap */
+    p = btc_arena_alloc(arena, 3);
+    q = btc_arena_alloc(arena, 40);
+    u_assert_int_eq(((uintptr_t)p) % 16, 0);
+    u_assert_int_eq(((uintptr_t)q) % 16, 0);
+    u_assert_int_eq(q - p >= 3, 1);
+    memset(p, 0xaa, 3);
+    memset(q, 0xbb, 40);
+    u_assert_int_eq(p[2], 0xaa);
+    u_assert_int_eq(btc_arena_used(arena), 16 + 48);
+
+    /* chunks are added as needed, oversized requests are served as well */
+    for (i = 0; i < 100; i++) {
+        p = btc_arena_alloc(arena, 24);
+        u_assert_int_eq(p != NULL, 1);
+        memset(p, (int)i, 24);
+    }
+    big = btc_arena_alloc(arena, 10000);
+    u_assert_int_eq(big != NULL, 1);
+    memset(big, 1, 10000);
+    u_assert_int_eq(p[23], 99);
+
+    /* after a reset the memory is one block and gets reused */
+    btc_arena_reset(arena);
+    u_assert_int_eq(btc_arena_used(arena), 0);
+    p = btc_arena_alloc(arena, 10000);
+    q = btc_arena_alloc(arena, 2000);
+    u_assert_int_eq(q - p, 10000);
+    btc_arena_reset(arena);
+    u_assert_int_eq(btc_arena_alloc(arena, 1) == p, 1);
+
+    /* sizes that overflow the rounding or the chunk header fail, the arena stays usable */
+    u_assert_int_eq(btc_arena_alloc(arena, SIZE_MAX) == NULL, 1);
+    u_assert_int_eq(btc_arena_alloc(arena, SIZE_MAX - 15) == NULL, 1);
+    u_assert_int_eq(btc_arena_alloc(arena, SIZE_MAX - 64) == NULL, 1);
+    u_assert_int_eq(btc_arena_used(arena), 16);
+    u_assert_int_eq(btc_arena_alloc(arena, 1) != NULL, 1);
+    btc_arena_free(arena);
+
+    /* a chunk size too large for the chunk header fails on the first allocation */
+    arena = btc_arena_new(SIZE_MAX - 8);
+    u_assert_int_eq(btc_arena_alloc(arena, 1) == NULL, 1);
+    btc_arena_free(arena);
+    btc_arena_free(NULL);
+}
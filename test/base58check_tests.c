@@ -10,6 +10,7 @@
 #include <assert.h>
 
 #include <btc/base58.h>
+#include "sha2.h"
 #include "utils.h"
 
 /* test vectors from bitcoin core */
@@ -75,6 +76,236 @@ static const char *base58_invalid_vector[] = {
     0, 0
 };
 
+/* reference: the plain byte-at-a-time base58 conversion */
+static void b58enc_reference(char *b58, const uint8_t *bin, size_t binsz)
+{
+    static const char digits[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+    uint8_t buf[256];
+    size_t zcount = 0, size, i, j, k;
+    int carry;
+
+    while (zcount < binsz && !bin[zcount])
+        ++zcount;
+    size = (binsz - zcount) * 138 / 100 + 1;
+    memset(buf, 0, size);
+    for (i = zcount; i < binsz; ++i) {
+        for (carry = bin[i], j = size; j--; ) {
+            carry += 256 * buf[j];
+            buf[j] = carry % 58;
+            carry /= 58;
+        }
+    }
+    for (j = 0; j < size && !buf[j]; ++j);
+    memset(b58, '1', zcount);
+    for (k = zcount; j < size; ++k, ++j)
+        b58[k] = digits[buf[j]];
+    b58[k] = '\0';
+}
+
+/* random payloads (with runs of leading zeros) encode like the reference and round trip */
+static void test_base58check_random(void)
+{
+    uint8_t raw[128 + 4], dec[128];
+    char str[200], ref[200];
+    uint32_t rnd = 0x12345678;
+    int iter, len, zeros, i, r, res;
+
+    for (iter = 0; iter < 2000; iter++) {
+        len = iter % 129;
+        zeros = iter % 7 == 0 ? (iter / 7) % (len + 1) : 0;
+        for (i = 0; i < len; i++) {
+            rnd = rnd * 1103515245 + 12345;
+            raw[i] = i < zeros ? 0 : (uint8_t)(rnd >> 16);
+        }
+        if (iter % 5 == 0 && len > 0)
+            raw[zeros < len ? zeros : 0] = 0xff;
+
+        r = base58_encode_check(raw, len, str, sizeof(str));
+        assert(r == (int)strlen(str) + 1);
+
+        /* the checksummed input as the reference sees it */
+        sha256_Raw(raw, len, dec);
+        sha256_Raw(dec, 32, dec);
+        memcpy(raw + len, dec, 4);
+        b58enc_reference(ref, raw, len + 4);
+        assert(strcmp(str, ref) == 0);
+
+        memset(dec, 0xaa, sizeof(dec));
+        res = base58_decode_check(str, dec, len);
+        assert(res == len);
+        assert(memcmp(dec, raw, len) == 0);
+
+        /* wrong expected length and a corrupted digit are rejected */
+        res = base58_decode_check(str, dec, len + 1);
+        assert(res == 0);
+        if (len > 0) {
+            res = base58_decode_check(str, dec, len - 1);
+            assert(res == 0);
+        }
+        str[r / 2] = str[r / 2] == 'z' ? 'y' : 'z';
+        res = base58_decode_check(str, dec, len);
+        assert(res == 0);
+
+        /* a too small output buffer is refused */
+        res = base58_encode_check(raw, len, str, r - 1);
+        assert(res == 0);
+    }
+}
+
+/* the batch functions give the same results as the single string ones */
+static void test_base58check_many(void)
+{
+    uint8_t raw[100][34], dec[100][34];
+    char str[100][60];
+    const uint8_t *raws[100];
+    uint8_t *decs[100];
+    char *strs[100];
+    const char *cstrs[100];
+    int lens[100], results[100];
+    size_t n = 0, i, ok;
+
+    /* the valid vectors, plus an oversized payload */
+    for (i = 0; base58_vector[2 * i]; i++, n++) {
+        lens[n] = strlen(base58_vector[2 * i]) / 2;
+        memcpy(raw[n], utils_hex_to_uint8(base58_vector[2 * i]), lens[n]);
+    }
+    lens[n++] = 129;
+    for (i = 0; i < n; i++) {
+        raws[i] = raw[i];
+        decs[i] = dec[i];
+        strs[i] = str[i];
+        cstrs[i] = str[i];
+    }
+
+    ok = base58_encode_check_many(raws, lens, n, strs, sizeof(str[0]), results);
+    assert(ok == n - 1);
+    for (i = 0; i + 1 < n; i++) {
+        assert(strcmp(str[i], base58_vector[2 * i + 1]) == 0);
+        assert(results[i] == (int)strlen(str[i]) + 1);
+    }
+    assert(results[n - 1] == 0);
+    strcpy(str[n - 1], "1AGNa15ZQXAZUgFiqJ2i7Z2DPU2J6hW62i");
+
+    /* break a checksum, a length and a digit */
+    str[1][5] = str[1][5] == 'z' ? 'y' : 'z';
+    lens[2]++;
+    str[3][3] = '0';
+    lens[n - 1] = 21;
+    memset(dec, 0, sizeof(dec));
+    ok = base58_decode_check_many(cstrs, decs, lens, n, results);
+    assert(ok == n - 3);
+    for (i = 0; i < n; i++) {
+        int res = base58_decode_check(str[i], raw[i], lens[i]);
+        assert(results[i] == res);
+        if (results[i])
+            assert(memcmp(dec[i], raw[i], lens[i]) == 0);
+    }
+    assert(results[1] == 0 && results[2] == 0 && results[3] == 0);
+    assert(results[n - 1] == 21);
+}
+
+/* reference: digit-at-a-time base58check decode of len characters */
+static int b58dec_check_reference(const char *str, size_t len, uint8_t *data, int datalen)
+{
+    static const char digits[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+    uint8_t num[128 + 4], hash[32];
+    size_t binsz = datalen + 4, zeros = 0, i, j;
+    const char *d;
+    int carry;
+
+    memset(num, 0, sizeof(num));
+    while (zeros < len && str[zeros] == '1')
+        zeros++;
+    for (i = zeros; i < len; i++) {
+        if (str[i] == '\0' || !(d = strchr(digits, str[i])))
+            return 0;
+        for (carry = d - digits, j = binsz; j--; ) {
+            carry += num[j] * 58;
+            num[j] = carry & 0xff;
+            carry >>= 8;
+        }
+        if (carry)
+            return 0;
+    }
+    /* the number of leading zero bytes must match the leading '1's */
+    for (i = 0; i < binsz && !num[i]; i++);
+    if (i != zeros)
+        return 0;
+    sha256_Raw(num, datalen, hash);
+    sha256_Raw(hash, 32, hash);
+    if (memcmp(num + datalen, hash, 4))
+        return 0;
+    memcpy(data, num, datalen);
+    return datalen;
+}
+
+/* fuzz: the length aware decoder (fixed size fast paths for 21 and 78 byte
+ * payloads, generic otherwise) agrees with the reference on mutated strings */
+static void test_base58check_fuzz(void)
+{
+    static const int sizes[] = {21, 78, 20, 22, 33, 77, 79, 0, 1, 128};
+    static const char chars[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz0OIl+\x80";
+    uint8_t raw[128], out[128], ref[128];
+    char str[300], buf[300];
+    uint32_t rnd = 0xdeadbeef;
+    int iter, len, i, r, r2, slen, valid = 0;
+
+    for (iter = 0; iter < 20000; iter++) {
+        len = sizes[iter % 10];
+        for (i = 0; i < len; i++) {
+            rnd = rnd * 1103515245 + 12345;
+            raw[i] = (uint8_t)(rnd >> 16);
+        }
+        if (iter % 3 == 0)
+            memset(raw, 0, (iter / 3) % 4 < len ? (iter / 3) % 4 : len);
+        slen = base58_encode_check(raw, len, str, sizeof(str)) - 1;
+        assert(slen > 0);
+
+        /* mutations: none, replace, insert, delete, prefix '1', truncate */
+        rnd = rnd * 1103515245 + 12345;
+        i = (rnd >> 8) % slen;
+        switch ((iter / 10) % 6) {
+        case 1:
+            str[i] = chars[(rnd >> 20) % (sizeof(chars) - 1)];
+            break;
+        case 2:
+            memmove(str + i + 1, str + i, slen - i + 1);
+            str[i] = chars[(rnd >> 20) % (sizeof(chars) - 1)];
+            slen++;
+            break;
+        case 3:
+            memmove(str + i, str + i + 1, slen - i);
+            slen--;
+            break;
+        case 4:
+            memmove(str + 1, str, slen + 1);
+            str[0] = '1';
+            slen++;
+            break;
+        case 5:
+            slen = i;
+            break;
+        }
+
+        /* decode from a buffer without terminator, guarded by garbage */
+        memset(buf, 'z', sizeof(buf));
+        memcpy(buf, str, slen);
+        memset(out, 0, sizeof(out));
+        r = base58_decode_check_len(buf, slen, out, len);
+        r2 = b58dec_check_reference(buf, slen, ref, len);
+        assert(r == r2);
+        if (r) {
+            assert(memcmp(out, ref, len) == 0);
+            valid++;
+        }
+        str[slen] = '\0';
+        r2 = base58_decode_check(str, out, len);
+        assert(r2 == r);
+    }
+    /* unmutated strings decode (a 0 byte payload reports 0 either way) */
+    assert(valid >= 20000 / 7);
+}
+
 void test_base58check()
 {
     const char **raw = base58_vector;
@@ -114,4 +345,8 @@ void test_base58check()
         i_raw += 2;
         i_cmd += 2;
     }
+
+    test_base58check_random();
+    test_base58check_many();
+    test_base58check_fuzz();
 }
@@ -6,6 +6,7 @@
 
 #include <btc/bip32.h>
 
+#include "sha2.h"
 #include "utest.h"
 #include "utils.h"
 
@@ -201,4 +202,81 @@ void test_bip32()
 
     r = hdnode_public_ckd(&node4, 0x80000000 + 1); //try deriving a hardened key (= must fail)
     u_assert_int_eq(r, false);
+
+    /* batch derivation must match single child derivation */
+    HDNode parent, children[5];
+    uint32_t indexes[5] = {0, 1, 123, 0x80000000, 0x80000000 + 7};
+    int k;
+    hd_generate_key(&parent, "m/0'/1", private_key_master, chain_code_master);
+    r = hdnode_private_ckd_many(&parent, indexes, 5, children);
+    u_assert_int_eq(r, true);
+    for (k = 0; k < 5; k++) {
+        memcpy(&node3, &parent, sizeof(HDNode));
+        r = hdnode_private_ckd(&node3, indexes[k]);
+        u_assert_int_eq(r, true);
+        u_assert_mem_eq(&children[k], &node3, sizeof(HDNode));
+    }
+
+    r = hdnode_deserialize(str_pub_ckd, &parent);
+    u_assert_int_eq(r, true);
+    r = hdnode_public_ckd_many(&parent, indexes, 3, children);
+    u_assert_int_eq(r, true);
+    for (k = 0; k < 3; k++) {
+        memcpy(&node3, &parent, sizeof(HDNode));
+        r = hdnode_public_ckd(&node3, indexes[k]);
+        u_assert_int_eq(r, true);
+        u_assert_mem_eq(&children[k], &node3, sizeof(HDNode));
+    }
+    r = hdnode_public_ckd_many(&parent, indexes, 4, children); // includes a hardened index
+    u_assert_int_eq(r, false);
+
+    /* a parent key of n - I_L makes the private tweak of child 1 fail */
+    {
+        static const uint8_t order[32] = {
+            0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe,
+            0xba, 0xae, 0xdc, 0xe6, 0xaf, 0x48, 0xa0, 0x3b, 0xbf, 0xd2, 0x5e, 0x8c, 0xd0, 0x36, 0x41, 0x41};
+        uint8_t data[33 + 4] = {0}, I[64];
+        int d, borrow = 0;
+
+        hd_generate_key(&parent, "m/0'/1", private_key_master, chain_code_master);
+        memcpy(data, parent.public_key, 33);
+        data[36] = 1;
+        hmac_sha512(parent.chain_code, 32, data, sizeof(data), I);
+        for (k = 31; k >= 0; k--) {
+            d = order[k] - I[k] - borrow;
+            borrow = d < 0;
+            parent.private_key[k] = d & 0xff;
+        }
+
+        memcpy(&node3, &parent, sizeof(HDNode));
+        r = hdnode_private_ckd(&node3, 1);
+        u_assert_int_eq(r, false);
+        u_assert_int_eq(node3.depth, parent.depth);
+        u_assert_int_eq(node3.child_num, parent.child_num);
+
+        r = hdnode_private_ckd_many(&parent, indexes, 3, children);
+        u_assert_int_eq(r, false);
+        u_assert_int_eq(children[1].depth, parent.depth);
+        memcpy(&node3, &parent, sizeof(HDNode));
+        r = hdnode_private_ckd(&node3, indexes[0]);
+        u_assert_int_eq(r, true);
+        u_assert_mem_eq(&children[0], &node3, sizeof(HDNode));
+    }
+
+    /* key path parsing: empty elements are skipped, malformed elements fail */
+    hd_generate_key(&parent, "m/0'/1", private_key_master, chain_code_master);
+    r = hd_generate_key(&node3, "m//0'/1/", private_key_master, chain_code_master);
+    u_assert_int_eq(r, true);
+    u_assert_mem_eq(&node3, &parent, sizeof(HDNode));
+    r = hd_generate_key(&node3, "m/", private_key_master, chain_code_master);
+    u_assert_int_eq(r, true);
+    u_assert_int_eq(node3.depth, 0);
+    r = hd_generate_key(&node3, "m/0'1", private_key_master, chain_code_master);
+    u_assert_int_eq(r, false);
+    r = hd_generate_key(&node3, "m/0/x", private_key_master, chain_code_master);
+    u_assert_int_eq(r, false);
+    r = hd_generate_key(&node3, "m/4294967296", private_key_master, chain_code_master);
+    u_assert_int_eq(r, false);
+    r = hd_generate_key(&node3, "n/0", private_key_master, chain_code_master);
+    u_assert_int_eq(r, false);
 }
@@ -0,0 +1,286 @@
+/**********************************************************************
+ * Copyright (c) 2015 Jonas Schnelli                                  *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <btc/block.h>
+
+#include "fixtures.h"
+#include "sha2.h"
+#include "utils.h"
+
+/* block 100000, txids and merkle root in display (reversed) byte order */
+static const char *merkle_block100000_txids[] = {
+    "8c14f0db3df150123e6f3dbbf30f8b955a8249b62ac1d1ff16284aefa3d06d87",
+    "fff2525b8931402dd09222c50775608f75787bd2b87e56995a7bdd30f79702c4",
+    "6359f0868171b1d194cbee1af2f16ea598ae8fad666d9b012c8ed2b79a236ec4",
+    "e9a66845e05d5abc0ad04ec80f774a7e585c6e8db975962d069a522137b80c1d",
+};
+static const char *merkle_block100000_root = "f3e94742aca4b5ef85488dc37c06c3282295ffec960994b2c0d5ac2a25a95766";
+
+static void merkle_hash_from_hex(const char *hex, uint256 out)
+{
+    char rev[65];
+    int outlen;
+    strcpy(rev, hex);
+    utils_reverse_hex(rev, 64);
+    utils_hex_to_bin(rev, out, 64, &outlen);
+}
+
+/* straightforward reference using the generic sha256 */
+static void merkle_root_reference(uint256 *nodes, size_t n, uint256 out)
+{
+    uint8_t pair[64];
+    size_t i;
+    while (n > 1) {
+        for (i = 0; i < n; i += 2) {
+            memcpy(pair, nodes[i], 32);
+            memcpy(pair + 32, nodes[i + 1 < n ? i + 1 : i], 32);
+            sha256_Raw(pair, 64, nodes[i / 2]);
+            sha256_Raw(nodes[i / 2], 32, nodes[i / 2]);
+        }
+        n = (n + 1) / 2;
+    }
+    memcpy(out, nodes[0], 32);
+}
+
+static void test_merkle_root_vectors(void)
+{
+    bool ok, mutated;
+    uint256 leaves[40], nodes[40], root, expected;
+    size_t i, n;
+
+    for (i = 0; i < 4; i++)
+        merkle_hash_from_hex(merkle_block100000_txids[i], leaves[i]);
+    merkle_hash_from_hex(merkle_block100000_root, expected);
+    ok = btc_merkle_root((const uint256 *)leaves, 4, root, NULL);
+    assert(ok);
+    assert(memcmp(root, expected, 32) == 0);
+
+    /* single leaf is its own root, no leaves give zero */
+    ok = btc_merkle_root((const uint256 *)leaves, 1, root, NULL);
+    assert(ok);
+    assert(memcmp(root, leaves[0], 32) == 0);
+    memset(expected, 0, 32);
+    ok = btc_merkle_root((const uint256 *)leaves, 0, root, NULL);
+    assert(ok);
+    assert(memcmp(root, expected, 32) == 0);
+
+    /* odd and even counts, crossing the multi-lane group sizes */
+    for (i = 0; i < 40; i++) {
+        for (n = 0; n < 32; n++)
+            leaves[i][n] = (uint8_t)(i * 17 + n);
+    }
+    for (n = 1; n <= 40; n++) {
+        memcpy(nodes, leaves, sizeof(leaves));
+        merkle_root_reference(nodes, n, expected);
+        ok = btc_merkle_root((const uint256 *)leaves, n, root, &mutated);
+        assert(ok && !mutated);
+        assert(memcmp(root, expected, 32) == 0);
+    }
+
+    /* duplicating the last leaf of an odd count keeps the root, but is reported */
+    for (n = 3; n <= 39; n += 2) {
+        ok = btc_merkle_root((const uint256 *)leaves, n, expected, NULL);
+        assert(ok);
+        memcpy(nodes, leaves, n * sizeof(uint256));
+        memcpy(nodes[n], leaves[n - 1], sizeof(uint256));
+        ok = btc_merkle_root((const uint256 *)nodes, n + 1, root, &mutated);
+        assert(ok && mutated);
+        assert(memcmp(root, expected, 32) == 0);
+    }
+}
+
+void test_merkle_root()
+{
+    uint32_t features = sha2_get_features();
+
+    sha2_set_features(0);
+    test_merkle_root_vectors();
+    sha2_set_features(features);
+    test_merkle_root_vectors();
+    /* the vector units are only used without SHA-NI */
+    sha2_set_features(features & ~SHA2_CPU_SHANI);
+    test_merkle_root_vectors();
+    sha2_set_features(features);
+}
+
+/* hash of the genesis block (fixture_block_genesis_hex) in display byte order */
+static const char block_genesis_hash[] = "000000000019d6689c085ae165831e934ff763ae46a2a6c172b3f1b60a8ce26f";
+
+/* transactions in the synthetic block, enough to use several threads */
+#define BLOCK_TEST_TXS 300
+
+static void test_block_genesis(void)
+{
+    uint8_t data[sizeof(fixture_block_genesis_hex) / 2];
+    uint8_t header[BTC_BLOCK_HEADER_SIZE];
+    uint256 expected;
+    int outlen;
+
+    utils_hex_to_bin(fixture_block_genesis_hex, data, strlen(fixture_block_genesis_hex), &outlen);
+    btc_block *block = btc_block_parse(data, outlen, 0);
+    assert(block);
+    assert(block->size == (size_t)outlen);
+    assert(block->tx_count == 1 && block->merkle_valid);
+    assert(block->header.version == 1 && block->header.timestamp == 1231006505);
+    assert(block->header.bits == 0x1d00ffff && block->header.nonce == 2083236893);
+    merkle_hash_from_hex(block_genesis_hash, expected);
+    assert(memcmp(block->hash, expected, 32) == 0);
+    btc_block_header_serialize(&block->header, header);
+    assert(memcmp(header, data, sizeof(header)) == 0);
+    btc_block_free(block);
+
+    /* a 64-bit transaction count of 2^32 + 1 is not read as 1 */
+    {
+        uint8_t wide[sizeof(data) + 8];
+        static const uint8_t count[9] = { 0xff, 1, 0, 0, 0, 1, 0, 0, 0 };
+        memcpy(wide, data, BTC_BLOCK_HEADER_SIZE);
+        memcpy(wide + BTC_BLOCK_HEADER_SIZE, count, sizeof(count));
+        memcpy(wide + BTC_BLOCK_HEADER_SIZE + sizeof(count), data + BTC_BLOCK_HEADER_SIZE + 1, outlen - BTC_BLOCK_HEADER_SIZE - 1);
+        block = btc_block_parse(wide, outlen + 8, 1);
+        assert(!block);
+        wide[BTC_BLOCK_HEADER_SIZE + 5] = 0;
+        block = btc_block_parse(wide, outlen + 8, 1);
+        assert(block && block->tx_count == 1 && block->merkle_valid);
+        btc_block_free(block);
+    }
+
+    /* a wrong merkle root is reported, truncation fails */
+    data[36] ^= 1;
+    block = btc_block_parse(data, outlen, 1);
+    assert(block && !block->merkle_valid);
+    btc_block_free(block);
+    block = btc_block_parse(data, outlen - 1, 1);
+    assert(!block);
+    block = btc_block_parse(data, BTC_BLOCK_HEADER_SIZE, 1);
+    assert(!block);
+}
+
+static void test_block_parallel(void)
+{
+    bool ok;
+    uint8_t coinbase[FIXTURE_COINBASE_GENESIS_SIZE];
+    uint8_t witness_tx[sizeof(fixture_tx_p2wpkh_hex) / 2];
+    uint256 txids[BLOCK_TEST_TXS], hash;
+    size_t offsets[BLOCK_TEST_TXS + 1];
+    btc_block_header header;
+    int coinbase_len, witness_len;
+    size_t i, pos, len;
+    unsigned int threads;
+
+    utils_hex_to_bin(fixture_coinbase_genesis_hex, coinbase, strlen(fixture_coinbase_genesis_hex), &coinbase_len);
+    utils_hex_to_bin(fixture_tx_p2wpkh_hex, witness_tx, strlen(fixture_tx_p2wpkh_hex), &witness_len);
+
+    /* alternate both transactions, the locktime makes every txid unique */
+    uint8_t *data = malloc(BTC_BLOCK_HEADER_SIZE + 3 + BLOCK_TEST_TXS * (coinbase_len + witness_len) + 16);
+    pos = BTC_BLOCK_HEADER_SIZE;
+    data[pos++] = 253;
+    data[pos++] = BLOCK_TEST_TXS & 0xff;
+    data[pos++] = BLOCK_TEST_TXS >> 8;
+    for (i = 0; i < BLOCK_TEST_TXS; i++) {
+        offsets[i] = pos;
+        len = i & 1 ? (size_t)witness_len : (size_t)coinbase_len;
+        memcpy(data + pos, i & 1 ? witness_tx : coinbase, len);
+        pos += len;
+        data[pos - 4] = i & 0xff;
+        data[pos - 3] = i >> 8;
+        btc_tx *tx = btc_tx_new();
+        ok = btc_tx_deserialize(data + offsets[i], len, tx);
+        assert(ok);
+        btc_tx_hash(tx, txids[i]);
+        btc_tx_free(tx);
+    }
+    offsets[i] = pos;
+    memset(data + pos, 0xee, 16); /* trailing bytes are not part of the block */
+
+    memset(&header, 0, sizeof(header));
+    header.version = 0x20000000;
+    ok = btc_merkle_root((const uint256 *)txids, BLOCK_TEST_TXS, header.merkle_root, NULL);
+    assert(ok);
+    btc_block_header_serialize(&header, data);
+
+    for (threads = 0; threads <= 8; threads++) {
+        btc_block *block = btc_block_parse(data, pos + 16, threads);
+        assert(block);
+        assert(block->size == pos && block->merkle_valid);
+        assert(block->tx_count == BLOCK_TEST_TXS);
+        assert(block->arena_count >= 1);
+        for (i = 0; i < BLOCK_TEST_TXS; i++) {
+            cstring *s = cstr_new_sz(0);
+            btc_tx_serialize(s, block->txs[i]);
+            assert(s->len == offsets[i + 1] - offsets[i]);
+            assert(memcmp(s->str, data + offsets[i], s->len) == 0);
+            cstr_free(s, true);
+            btc_tx_hash(block->txs[i], hash);
+            assert(memcmp(hash, txids[i], 32) == 0);
+            /* the wtxid is memoised too, reading it leaves the tx untouched */
+            btc_tx_witness_hash_compute(block->txs[i], hash);
+            assert(memcmp(hash, block->txs[i]->wtxid, 32) == 0);
+        }
+        btc_block_free(block);
+    }
+
+    /* a malformed transaction anywhere fails the block (unknown witness flag) */
+    data[offsets[BLOCK_TEST_TXS - 1] + 5] = 2;
+    btc_block *block = btc_block_parse(data, pos, 4);
+    assert(!block);
+    free(data);
+}
+
+/* three transactions, then the same block with the last one duplicated (CVE-2012-2459) */
+static void test_block_mutated(void)
+{
+    bool ok;
+    uint8_t coinbase[FIXTURE_COINBASE_GENESIS_SIZE];
+    uint8_t data[BTC_BLOCK_HEADER_SIZE + 1 + 4 * sizeof(coinbase)];
+    uint256 txids[3];
+    btc_block_header header;
+    btc_block *block;
+    int coinbase_len;
+    size_t i, pos;
+
+    utils_hex_to_bin(fixture_coinbase_genesis_hex, coinbase, strlen(fixture_coinbase_genesis_hex), &coinbase_len);
+
+    pos = BTC_BLOCK_HEADER_SIZE;
+    data[pos++] = 3;
+    for (i = 0; i < 3; i++) {
+        memcpy(data + pos, coinbase, coinbase_len);
+        pos += coinbase_len;
+        data[pos - 4] = (uint8_t)i;
+        btc_tx *tx = btc_tx_new();
+        ok = btc_tx_deserialize(data + pos - coinbase_len, coinbase_len, tx);
+        assert(ok);
+        btc_tx_hash(tx, txids[i]);
+        btc_tx_free(tx);
+    }
+    memset(&header, 0, sizeof(header));
+    ok = btc_merkle_root((const uint256 *)txids, 3, header.merkle_root, NULL);
+    assert(ok);
+    btc_block_header_serialize(&header, data);
+
+    block = btc_block_parse(data, pos, 1);
+    assert(block && block->merkle_valid);
+    btc_block_free(block);
+
+    data[BTC_BLOCK_HEADER_SIZE] = 4;
+    memcpy(data + pos, data + pos - coinbase_len, coinbase_len);
+    pos += coinbase_len;
+    block = btc_block_parse(data, pos, 1);
+    assert(block && block->tx_count == 4 && !block->merkle_valid);
+    btc_block_free(block);
+}
+
+void test_block_parse()
+{
+    test_block_genesis();
+    test_block_parallel();
+    test_block_mutated();
+}
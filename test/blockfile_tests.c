@@ -0,0 +1,135 @@
+/**********************************************************************
+ * Copyright (c) 2015 Jonas Schnelli                                  *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include <btc/block.h>
+#include <btc/blockfile.h>
+
+/* header only block (no transactions) with the given nonce */
+static void blockfile_block(uint8_t *block, uint32_t nonce)
+{
+    btc_block_header header;
+    memset(&header, 0, sizeof(header));
+    header.version = 1;
+    header.nonce = nonce;
+    btc_block_header_serialize(&header, block);
+    block[BTC_BLOCK_HEADER_SIZE] = 0;
+}
+
+static void blockfile_record(FILE *f, uint32_t magic, const uint8_t *block, uint32_t len)
+{
+    size_t res;
+    uint8_t frame[8];
+    int i;
+    for (i = 0; i < 4; i++) {
+        frame[i] = magic >> (8 * i);
+        frame[4 + i] = len >> (8 * i);
+    }
+    res = fwrite(frame, 1, 8, f);
+    assert(res == 8);
+    res = fwrite(block, 1, len, f);
+    assert(res == len);
+}
+
+void test_blockfile()
+{
+    bool ok;
+    size_t res;
+    char path[64], name[64];
+    uint8_t block[BTC_BLOCK_HEADER_SIZE + 1];
+    uint8_t zeros[1000];
+    const uint8_t *data;
+    size_t len, offset;
+    uint32_t nonce;
+    int fd;
+
+    ok = btc_blockfile_path(name, sizeof(name), "/data/blocks", 42);
+    assert(ok);
+    assert(strcmp(name, "/data/blocks/blk00042.dat") == 0);
+    ok = btc_blockfile_path(name, 20, "/data/blocks", 42);
+    assert(!ok);
+
+    strcpy(path, "/tmp/libbtc_blkXXXXXX");
+    fd = mkstemp(path);
+    assert(fd >= 0);
+    FILE *f = fdopen(fd, "wb");
+    assert(f);
+
+    /* three blocks, zero padding, a damaged record, a testnet record,
+       two more blocks and a truncated record */
+    memset(zeros, 0, sizeof(zeros));
+    for (nonce = 0; nonce < 3; nonce++) {
+        blockfile_block(block, nonce);
+        blockfile_record(f, BTC_BLOCKFILE_MAGIC_MAIN, block, sizeof(block));
+    }
+    res = fwrite(zeros, 1, 333, f);
+    assert(res == 333);
+    res = fwrite("junk\xf9\xbe", 1, 6, f);
+    assert(res == 6);
+    blockfile_block(block, 100);
+    blockfile_record(f, BTC_BLOCKFILE_MAGIC_TESTNET3, block, sizeof(block));
+    for (nonce = 3; nonce < 5; nonce++) {
+        blockfile_block(block, nonce);
+        blockfile_record(f, BTC_BLOCKFILE_MAGIC_MAIN, block, sizeof(block));
+    }
+    /* the size claims more bytes than the file has */
+    blockfile_block(block, 5);
+    blockfile_record(f, BTC_BLOCKFILE_MAGIC_MAIN, block, sizeof(block));
+    fseek(f, -(long)sizeof(block) - 4, SEEK_END);
+    uint8_t big_size[4] = {0xff, 0, 0, 0};
+    res = fwrite(big_size, 1, 4, f);
+    assert(res == 4);
+    fclose(f);
+
+    btc_blockfile_prefetch(path);
+    btc_blockfile *file = btc_blockfile_open(path, BTC_BLOCKFILE_MAGIC_MAIN);
+    assert(file);
+    nonce = 0;
+    while (btc_blockfile_next(file, &data, &len, &offset)) {
+        assert(len == sizeof(block) && nonce < 5);
+        btc_block *parsed = btc_block_parse(data, len, 1);
+        assert(parsed && parsed->size == len && parsed->tx_count == 0);
+        assert(parsed->header.nonce == nonce);
+        btc_block_free(parsed);
+        if (nonce == 0)
+            assert(offset == 8);
+        nonce++;
+    }
+    assert(nonce == 5);
+    ok = btc_blockfile_next(file, &data, &len, NULL);
+    assert(!ok);
+    btc_blockfile_close(file);
+
+    /* the testnet record only */
+    file = btc_blockfile_open(path, BTC_BLOCKFILE_MAGIC_TESTNET3);
+    ok = btc_blockfile_next(file, &data, &len, NULL);
+    assert(ok);
+    btc_block_header header;
+    ok = btc_block_header_deserialize(&header, data, len);
+    assert(ok && header.nonce == 100);
+    ok = btc_blockfile_next(file, &data, &len, NULL);
+    assert(!ok);
+    btc_blockfile_close(file);
+
+    /* empty and missing files */
+    f = fopen(path, "wb");
+    fclose(f);
+    file = btc_blockfile_open(path, BTC_BLOCKFILE_MAGIC_MAIN);
+    assert(file);
+    ok = btc_blockfile_next(file, &data, &len, NULL);
+    assert(!ok);
+    btc_blockfile_close(file);
+    unlink(path);
+    file = btc_blockfile_open(path, BTC_BLOCKFILE_MAGIC_MAIN);
+    assert(!file);
+}
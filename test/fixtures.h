@@ -0,0 +1,24 @@
+/**********************************************************************
+ * Copyright (c) 2015 Jonas Schnelli                                  *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+
+#ifndef __LIBBTC_TEST_FIXTURES_H__
+#define __LIBBTC_TEST_FIXTURES_H__
+
+/* serialized test data shared by the test files, as hex */
+
+/* BIP143 native P2WPKH example, signed (with witness) */
+#define FIXTURE_TX_P2WPKH_SIZE 343
+extern const char fixture_tx_p2wpkh_hex[FIXTURE_TX_P2WPKH_SIZE * 2 + 1];
+
+/* genesis block, and its coinbase transaction (the rest of the block after the
+ * header and the one byte transaction count) */
+#define FIXTURE_BLOCK_GENESIS_SIZE 285
+#define FIXTURE_COINBASE_GENESIS_SIZE (FIXTURE_BLOCK_GENESIS_SIZE - 80 - 1)
+extern const char fixture_block_genesis_hex[FIXTURE_BLOCK_GENESIS_SIZE * 2 + 1];
+extern const char *const fixture_coinbase_genesis_hex;
+
+#endif //__LIBBTC_TEST_FIXTURES_H__
@@ -0,0 +1,106 @@
+/**********************************************************************
+ * Copyright (c) 2015 Jonas Schnelli                                  *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "ripemd160.h"
+#include "sha2.h"
+#include "utest.h"
+#include "utils.h"
+
+extern void sha2_test_backends(void (*test_fn)(void));
+
+struct ripemd160_test_vector
+{
+    const char *msg;
+    const char *digest_hex;
+};
+
+static const struct ripemd160_test_vector ripemd160_test_vectors[] =
+{
+    {"", "9c1185a5c5e9fc54612808977ee8f548b2258d31"},
+    {"a", "0bdc9d2d256b3ee9daae347be6f4dc835a467ffe"},
+    {"abc", "8eb208f7e05d987a9b044a8e98c6b087f15a0bfc"},
+    {"message digest", "5d0689ef49d2fae572b881b123a85ffa21595f36"},
+    {"abcdefghijklmnopqrstuvwxyz", "f71c27109c692c1b56bbdceb5b9d2865b3708dbc"},
+    {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "12a053384a9c0c88e405a06c27dcf49ada62eb2b"},
+    {"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789", "b0e20b6e3116640286ed3a87a5713079b21f5189"},
+    {"12345678901234567890123456789012345678901234567890123456789012345678901234567890", "9b752e45573d4b39f4dbd3323cab82bf63326bfb"},
+};
+
+/* btc_hash160_many against btc_hash160, for every lane group/tail split */
+static void test_hash160_many(void)
+{
+    uint8_t pubkeys[70][33];
+    uint8_t out[70][RIPEMD160_DIGEST_LENGTH];
+    uint8_t hash[RIPEMD160_DIGEST_LENGTH];
+    size_t i, n;
+
+    for (i = 0; i < 70 * 33; i++)
+        pubkeys[i / 33][i % 33] = (uint8_t)(i * 31 + 5);
+
+    for (n = 0; n <= 70; n += (n < 20 ? 1 : 25)) {
+        memset(out, 0, sizeof(out));
+        btc_hash160_many((const uint8_t (*)[33])pubkeys, n, out);
+        for (i = 0; i < n; i++) {
+            btc_hash160(pubkeys[i], 33, hash);
+            u_assert_mem_eq(out[i], hash, RIPEMD160_DIGEST_LENGTH);
+        }
+        for (i = n; i < 70; i++)
+            u_assert_mem_eq(out[i], utils_hex_to_uint8("0000000000000000000000000000000000000000"), RIPEMD160_DIGEST_LENGTH);
+    }
+}
+
+void test_ripemd160()
+{
+    uint8_t hash[RIPEMD160_DIGEST_LENGTH], hash2[RIPEMD160_DIGEST_LENGTH];
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    RIPEMD160_CTX ctx;
+    unsigned int i;
+    size_t len, split;
+
+    for (i = 0; i < sizeof(ripemd160_test_vectors) / sizeof(ripemd160_test_vectors[0]); i++) {
+        const char *msg = ripemd160_test_vectors[i].msg;
+        const uint8_t *expected = utils_hex_to_uint8(ripemd160_test_vectors[i].digest_hex);
+        len = strlen(msg);
+
+        ripemd160((const uint8_t *)msg, len, hash);
+        u_assert_mem_eq(hash, expected, RIPEMD160_DIGEST_LENGTH);
+
+        /* streaming, split at every position */
+        for (split = 0; split <= len; split++) {
+            ripemd160_Init(&ctx);
+            ripemd160_Update(&ctx, (const uint8_t *)msg, split);
+            ripemd160_Update(&ctx, (const uint8_t *)msg + split, len - split);
+            ripemd160_Final(hash, &ctx);
+            u_assert_mem_eq(hash, expected, RIPEMD160_DIGEST_LENGTH);
+        }
+    }
+
+    /* hash160 of the bip32 test vector 1 master public key (its identifier) */
+    uint8_t pubkey[33];
+    memcpy(pubkey, utils_hex_to_uint8("0339a36013301597daef41fbe593a02cc513d0b55527ec2df1050e2e8ff49c85c2"), 33);
+    btc_hash160(pubkey, 33, hash);
+    u_assert_mem_eq(hash, utils_hex_to_uint8("3442193e1bb70916e914552172cd4e2dbc9df811"), RIPEMD160_DIGEST_LENGTH);
+
+    /* fused hash160 equals the two step computation */
+    uint8_t msg[200];
+    for (len = 0; len < sizeof(msg); len++)
+        msg[len] = (uint8_t)(len * 13 + 7);
+    for (len = 0; len <= sizeof(msg); len += 11) {
+        btc_hash160(msg, len, hash);
+        sha256_Raw(msg, len, digest);
+        ripemd160(digest, SHA256_DIGEST_LENGTH, hash2);
+        u_assert_mem_eq(hash, hash2, RIPEMD160_DIGEST_LENGTH);
+    }
+
+    /* batch hash160 with the portable code and each SIMD backend */
+    sha2_test_backends(test_hash160_many);
+}
@@ -419,7 +419,26 @@ static const struct sha_hmac_test_v sha_hmac_test_vectors[] =
 {374, 142, 64, "f78343071f61ee7d9f791bd53132e6d557928bcfe4b214bebf6f3592e46374c7ab148c3c4d6a1443a4675cf4321298c865b440631947b6b05f2c2a337d1cbb9b3661de974b4604eb41cc77c3659e85470e47e16f22a34619db935d59cbf5e1101ed401c020db069eff1035e9d1bff77bd8b3379e05ac0c20bc0e98aad7d7304dedd3bc5ed4136184649b5e0f7e5b", "d63b50b54e1536e35d5f3c6e29f1e49a78ca43fa22b31232c71f0300bd56517e4cd29ba11ee9f206f1ad31ee8f118c87004d6c6dfe837b70a9a2fa987c8b5b6680720c5dbf8791c1fcd6d59fa16cc20df9bc0fb39f41598a376476e45b9f06add8e34af01b373a9ce6a3d189484cacb6cbe0d3d5ef34d709d72c1dee43dc79da", "086f674d778db491e73b6fbc5126233c6b6e1f066963356d49ea386d9c0868ad25bf6edad0371cde87cea94a18c6dba47535dfce2e40d2246ab17980495d656c"}
 };
 
-void test_sha_256()
+/* run test_fn with the portable code and with every CPU specific backend
+ * (shared with the ripemd160 and utils tests) */
+void sha2_test_backends(void (*test_fn)(void))
+{
+    uint32_t features = sha2_auto_detect();
+    uint32_t feature, selected;
+
+    sha2_set_features(0);
+    test_fn();
+    for (feature = 1; feature != 0; feature <<= 1) {
+        if (features & feature) {
+            selected = sha2_set_features(feature);
+            assert(selected == feature);
+            test_fn();
+        }
+    }
+    sha2_set_features(features);
+}
+
+static void test_sha_256_vectors(void)
 {
     uint8_t buf[SHA256_DIGEST_LENGTH];
     uint8_t *digest_out; /* use non thread save buffer (optimized for embedded systems) */
@@ -460,7 +479,12 @@ void test_sha_256()
     }
 }
 
-void test_sha_512()
+void test_sha_256()
+{
+    sha2_test_backends(test_sha_256_vectors);
+}
+
+static void test_sha_512_vectors(void)
 {
     uint8_t buf[SHA512_DIGEST_LENGTH];
     uint8_t *digest_out; /* use non thread save buffer (optimized for embedded systems) */
@@ -503,7 +527,12 @@ void test_sha_512()
     }
 }
 
-void test_sha_hmac()
+void test_sha_512()
+{
+    sha2_test_backends(test_sha_512_vectors);
+}
+
+static void test_sha_hmac_vectors(void)
 {
     uint8_t buf[SHA512_DIGEST_LENGTH];
     uint8_t *digest_out;
@@ -526,5 +555,171 @@ void test_sha_hmac()
 
         digest_out = utils_hex_to_uint8((const char *)sha_hmac_test_vectors[i].digest_hex);
         assert(memcmp(buf, digest_out, sha_hmac_test_vectors[i].tlen) == 0);
+
+        if (sha_hmac_test_vectors[i].tlen == 64) {
+            /* precomputed key context, used twice */
+            HMAC_SHA512_CTX hctx;
+            hmac_sha512_Init(&hctx, key_buf, sha_hmac_test_vectors[i].klen);
+            hmac_sha512_Final(&hctx, msg_buf, oLenMsg, buf);
+            assert(memcmp(buf, digest_out, SHA512_DIGEST_LENGTH) == 0);
+            memset(buf, 0, sizeof(buf));
+            hmac_sha512_Final(&hctx, msg_buf, oLenMsg, buf);
+            assert(memcmp(buf, digest_out, SHA512_DIGEST_LENGTH) == 0);
+        }
+    }
+}
+
+static void test_sha_hmac_many_vectors(void)
+{
+    uint8_t key[32], msgs[9][300];
+    const uint8_t *msg[9];
+    uint32_t msglen[9];
+    uint8_t hmacs[9][SHA512_DIGEST_LENGTH], buf[SHA512_DIGEST_LENGTH];
+    HMAC_SHA512_CTX hctx;
+    size_t i, j, count;
+
+    for (i = 0; i < sizeof(key); i++) {
+        key[i] = (uint8_t)(i * 7 + 1);
+    }
+    for (i = 0; i < 9; i++) {
+        for (j = 0; j < sizeof(msgs[i]); j++) {
+            msgs[i][j] = (uint8_t)(i * 29 + j * 3);
+        }
+        msg[i] = msgs[i];
+    }
+    hmac_sha512_Init(&hctx, key, sizeof(key));
+
+    /* bip32 sized messages and lengths around the sha512 block boundaries */
+    for (j = 0; j < 300; j += 37) {
+        for (i = 0; i < 9; i++) {
+            msglen[i] = (uint32_t)((j + i * 41) % 300);
+        }
+        for (count = 0; count <= 9; count++) {
+            hmac_sha512_Final_many(&hctx, msg, msglen, count, hmacs);
+            for (i = 0; i < count; i++) {
+                hmac_sha512(key, sizeof(key), msg[i], msglen[i], buf);
+                assert(memcmp(buf, hmacs[i], SHA512_DIGEST_LENGTH) == 0);
+            }
+        }
+    }
+}
+
+void test_sha_hmac()
+{
+    sha2_test_backends(test_sha_hmac_vectors);
+    sha2_test_backends(test_sha_hmac_many_vectors);
+}
+
+static void test_sha_256_many_vectors(void)
+{
+    /* 19 messages: two full groups of 8 lanes plus a scalar tail */
+    uint8_t msgs[19][200];
+    const uint8_t *data[19];
+    size_t len[19];
+    uint8_t digests[19][SHA256_DIGEST_LENGTH];
+    uint8_t buf[SHA256_DIGEST_LENGTH];
+    size_t i, j, round;
+
+    for (i = 0; i < 19; i++) {
+        for (j = 0; j < sizeof(msgs[i]); j++) {
+            msgs[i][j] = (uint8_t)(i * 31 + j * 7);
+        }
+        data[i] = msgs[i];
+    }
+
+    /* vary the lengths across lanes, including block and padding edges */
+    for (round = 0; round < 200; round += 11) {
+        for (i = 0; i < 19; i++) {
+            len[i] = (round + i * 13) % 200;
+        }
+        sha256_Raw_many(data, len, 19, digests);
+        for (i = 0; i < 19; i++) {
+            sha256_Raw(data[i], len[i], buf);
+            assert(memcmp(buf, digests[i], SHA256_DIGEST_LENGTH) == 0);
+        }
+    }
+    for (i = 0; i < 19; i++) {
+        len[i] = 55 + (i % 3);
+    }
+    sha256_Raw_many(data, len, 19, digests);
+    for (i = 0; i < 19; i++) {
+        sha256_Raw(data[i], len[i], buf);
+        assert(memcmp(buf, digests[i], SHA256_DIGEST_LENGTH) == 0);
+    }
+
+    /* double sha256 of 64 byte inputs (merkle tree nodes) */
+    uint8_t nodes[19 * 64];
+    uint8_t hashes[19 * SHA256_DIGEST_LENGTH];
+    for (i = 0; i < sizeof(nodes); i++) {
+        nodes[i] = (uint8_t)(i * 13 + 5);
+    }
+    for (i = 0; i <= 19; i++) {
+        sha256d64_many(nodes, i, hashes);
+        for (j = 0; j < i; j++) {
+            sha256_Raw(nodes + j * 64, 64, buf);
+            sha256_Raw(buf, SHA256_DIGEST_LENGTH, buf);
+            assert(memcmp(buf, hashes + j * SHA256_DIGEST_LENGTH, SHA256_DIGEST_LENGTH) == 0);
+        }
+    }
+    for (i = 0; i < 19; i++) {
+        sha256d64(nodes + i * 64, buf);
+        assert(memcmp(buf, hashes + i * SHA256_DIGEST_LENGTH, SHA256_DIGEST_LENGTH) == 0);
     }
 }
+
+void test_sha_256_many()
+{
+    sha2_test_backends(test_sha_256_many_vectors);
+}
+
+static void test_sha_256_midstate_vectors(void)
+{
+    int ok;
+    static const size_t prefix_lens[] = {0, 64, 128, 640};
+    static const size_t suffix_lens[] = {0, 1, 16, 55, 56, 63, 64, 65, 200};
+    uint8_t msg[640 + 200];
+    uint8_t buf[SHA256_DIGEST_LENGTH], expected[SHA256_DIGEST_LENGTH];
+    SHA256_CTX ctx, resumed;
+    SHA256_MIDSTATE midstate;
+    size_t i, p, x;
+
+    for (i = 0; i < sizeof(msg); i++) {
+        msg[i] = (uint8_t)(i * 251 + 3);
+    }
+
+    for (p = 0; p < sizeof(prefix_lens) / sizeof(prefix_lens[0]); p++) {
+        size_t plen = prefix_lens[p];
+        sha256_Init(&ctx);
+        /* feed the prefix in uneven pieces, the buffer must end up empty */
+        sha256_Update(&ctx, msg, plen / 3);
+        sha256_Update(&ctx, msg + plen / 3, plen - plen / 3);
+        ok = sha256_GetMidstate(&ctx, &midstate);
+        assert(ok == 1);
+
+        for (x = 0; x < sizeof(suffix_lens) / sizeof(suffix_lens[0]); x++) {
+            size_t slen = suffix_lens[x];
+            sha256_Raw(msg, plen + slen, expected);
+
+            /* the same midstate can be resumed any number of times */
+            sha256_SetMidstate(&resumed, &midstate);
+            sha256_Update(&resumed, msg + plen, slen);
+            sha256_Final(buf, &resumed);
+            assert(memcmp(buf, expected, SHA256_DIGEST_LENGTH) == 0);
+        }
+    }
+
+    /* no midstate while bytes are buffered */
+    sha256_Init(&ctx);
+    sha256_Update(&ctx, msg, 65);
+    ok = sha256_GetMidstate(&ctx, &midstate);
+    assert(ok == 0);
+    sha256_Update(&ctx, msg + 65, 63);
+    ok = sha256_GetMidstate(&ctx, &midstate);
+    assert(ok == 1);
+    assert(midstate.bitcount == 128 * 8);
+}
+
+void test_sha_256_midstate()
+{
+    sha2_test_backends(test_sha_256_midstate_vectors);
+}
@@ -9,10 +9,13 @@
 #include <string.h>
 #include <assert.h>
 
+#include <btc/arena.h>
 #include <btc/tx.h>
 
 #include "cstr.h"
+#include "fixtures.h"
 #include "script.h"
+#include "sha2.h"
 #include "utils.h"
 
 
@@ -754,8 +757,487 @@ void test_tx_serialization()
     }
 }
 
+void test_tx_serialized_size()
+{
+    bool ok;
+    size_t res;
+    unsigned int i;
+    for (i = 0; i < (sizeof(txvalid) / sizeof(txvalid[0])); i++)
+    {
+        const struct txtest *one_test = &txvalid[i];
+        uint8_t tx_data[sizeof(one_test->hextx)/2];
+        uint8_t buf[sizeof(one_test->hextx)/2];
+        int outlen;
+        utils_hex_to_bin(one_test->hextx, tx_data, strlen(one_test->hextx), &outlen);
+
+        btc_tx *tx = btc_tx_new();
+        btc_tx_deserialize(tx_data, outlen, tx);
+
+        size_t size = btc_tx_serialized_size(tx);
+        assert(size == (size_t)outlen);
+        assert(btc_tx_weight(tx) == size * 4);
+        assert(btc_tx_vsize(tx) == size);
+
+        /* exact and too small caller buffers */
+        res = btc_tx_serialize_buf(tx, buf, size);
+        assert(res == size);
+        assert(memcmp(buf, tx_data, size) == 0);
+        res = btc_tx_serialize_buf(tx, buf, size - 1);
+        assert(res == 0);
+
+        /* serialization appends to existing string content */
+        cstring *str = cstr_new("ab");
+        btc_tx_serialize(str, tx);
+        assert(str->len == size + 2);
+        assert(memcmp(str->str, "ab", 2) == 0);
+        assert(memcmp(str->str + 2, tx_data, size) == 0);
+        cstr_free(str, true);
+        btc_tx_free(tx);
+    }
+
+    /* missing scripts and 3/5 byte length prefixes */
+    btc_tx *tx = btc_tx_new();
+    btc_tx_in *tx_in = btc_tx_in_new();
+    vector_add(tx->vin, tx_in);
+    btc_tx_out *tx_out = btc_tx_out_new();
+    tx_out->value = -2;
+    vector_add(tx->vout, tx_out);
+    assert(btc_tx_serialized_size(tx) == 4 + 1 + 41 + 1 + 9 + 4);
+
+    tx_in->script_sig = cstr_new_sz(300);
+    cstr_resize(tx_in->script_sig, 300);
+    memset(tx_in->script_sig->str, 0x51, 300);
+    tx_out->script_pubkey = cstr_new_sz(70000);
+    cstr_resize(tx_out->script_pubkey, 70000);
+    memset(tx_out->script_pubkey->str, 0x6a, 70000);
+    size_t size = btc_tx_serialized_size(tx);
+    assert(size == 4 + 1 + (36 + 3 + 300 + 4) + 1 + (8 + 5 + 70000) + 4);
+
+    cstring *str = cstr_new_sz(0);
+    btc_tx_serialize(str, tx);
+    assert(str->len == size);
+    btc_tx *tx_check = btc_tx_new();
+    ok = btc_tx_deserialize((const unsigned char *)str->str, str->len, tx_check);
+    assert(ok);
+    cstring *str2 = cstr_new_sz(size);
+    btc_tx_serialize(str2, tx_check);
+    assert(str2->len == size && memcmp(str->str, str2->str, size) == 0);
+    cstr_free(str, true);
+    cstr_free(str2, true);
+    btc_tx_free(tx_check);
+    btc_tx_free(tx);
+}
+
+static void tx_double_sha256(const uint8_t *data, size_t len, uint8_t *hash)
+{
+    sha256_Raw(data, len, hash);
+    sha256_Raw(hash, 32, hash);
+}
+
+/* fixture_tx_p2wpkh_hex, signed: the first input has an empty stack, the second a witness */
+void test_tx_witness()
+{
+    bool ok;
+    uint8_t tx_data[sizeof(fixture_tx_p2wpkh_hex) / 2];
+    uint8_t hash[32], hash_check[32];
+    int outlen;
+    size_t consumed, len, skipped;
+    unsigned int i;
+
+    utils_hex_to_bin(fixture_tx_p2wpkh_hex, tx_data, strlen(fixture_tx_p2wpkh_hex), &outlen);
+
+    btc_tx *tx = btc_tx_new();
+    ok = btc_tx_deserialize(tx_data, outlen, tx);
+    assert(ok);
+    assert(tx->vin->len == 2 && tx->vout->len == 2);
+    assert(tx->locktime == 17);
+    assert(btc_tx_has_witness(tx));
+    btc_tx_in *tx_in = vector_idx(tx->vin, 0);
+    assert(tx_in->witness_stack == NULL);
+    tx_in = vector_idx(tx->vin, 1);
+    assert(tx_in->witness_stack->len == 2);
+    assert(((cstring *)vector_idx(tx_in->witness_stack, 0))->len == 71);
+    assert(((cstring *)vector_idx(tx_in->witness_stack, 1))->len == 33);
+
+    /* round trip in the extended format */
+    cstring *str = cstr_new_sz(0);
+    btc_tx_serialize(str, tx);
+    assert(str->len == (size_t)outlen && memcmp(str->str, tx_data, outlen) == 0);
+    assert(btc_tx_serialized_size(tx) == (size_t)outlen);
+    cstr_free(str, true);
+
+    /* copies keep the witness, stripping it gives the legacy serialization */
+    btc_tx *tx_copy = btc_tx_new();
+    btc_tx_copy(tx_copy, tx);
+    str = cstr_new_sz(0);
+    btc_tx_serialize(str, tx_copy);
+    assert(str->len == (size_t)outlen && memcmp(str->str, tx_data, outlen) == 0);
+    cstr_free(str, true);
+    tx_in = vector_idx(tx_copy->vin, 1);
+    vector_free(tx_in->witness_stack, true);
+    tx_in->witness_stack = NULL;
+    btc_tx_hash_invalidate(tx_copy);
+    assert(!btc_tx_has_witness(tx_copy));
+    str = cstr_new_sz(0);
+    btc_tx_serialize(str, tx_copy);
+    size_t base_size = str->len;
+    assert(base_size == (size_t)outlen - 2 - 1 - (1 + 1 + 71 + 1 + 33));
+    assert(btc_tx_weight(tx) == base_size * 3 + outlen);
+    assert(btc_tx_vsize(tx) == (base_size * 3 + outlen + 3) / 4);
+
+    /* txid hashes the stripped serialization, wtxid the full one */
+    btc_tx_hash(tx, hash);
+    tx_double_sha256((const uint8_t *)str->str, str->len, hash_check);
+    assert(memcmp(hash, hash_check, 32) == 0);
+    btc_tx_hash(tx_copy, hash);
+    assert(memcmp(hash, hash_check, 32) == 0);
+    btc_tx_witness_hash(tx_copy, hash);
+    assert(memcmp(hash, hash_check, 32) == 0);
+    btc_tx_witness_hash(tx, hash);
+    tx_double_sha256(tx_data, outlen, hash_check);
+    assert(memcmp(hash, hash_check, 32) == 0);
+    cstr_free(str, true);
+    btc_tx_free(tx_copy);
+
+    /* arena parser and view */
+    btc_arena *arena = btc_arena_new(0);
+    btc_tx *tx_arena = btc_tx_deserialize_arena(tx_data, outlen, arena, &consumed);
+    assert(tx_arena && consumed == (size_t)outlen);
+    str = cstr_new_sz(0);
+    btc_tx_serialize(str, tx_arena);
+    assert(str->len == (size_t)outlen && memcmp(str->str, tx_data, outlen) == 0);
+    cstr_free(str, true);
+
+    btc_tx_view view;
+    ok = btc_tx_view_parse(&view, tx_data, outlen, arena);
+    assert(ok);
+    assert(view.size == (size_t)outlen && view.has_witness);
+    assert(view.locktime == 17 && view.vin_count == 2 && view.vout_count == 2);
+    const uint8_t *witness = btc_tx_view_witness(&view, 0, &len);
+    assert(witness == NULL && len == 0);
+    witness = btc_tx_view_witness(&view, 1, &len);
+    assert(len == 1 + 1 + 71 + 1 + 33 && witness[0] == 2 && witness[1] == 71);
+    assert(btc_tx_view_sequence(&view, 1) == 0xffffffff);
+    btc_arena_free(arena);
+
+    /* unknown flag, superfluous witness record and truncated witness are rejected */
+    uint8_t bad[sizeof(tx_data)];
+    memcpy(bad, tx_data, outlen);
+    bad[5] = 2;
+    btc_tx_free(tx);
+    tx = btc_tx_new();
+    ok = btc_tx_deserialize(bad, outlen, tx);
+    assert(!ok);
+    ok = btc_tx_view_parse(&view, bad, outlen, NULL);
+    assert(!ok);
+    skipped = btc_tx_skip(bad, outlen);
+    assert(skipped == 0);
+    skipped = btc_tx_skip(tx_data, outlen);
+    assert(skipped == (size_t)outlen);
+    for (len = 1; len < (size_t)outlen; len += 37) {
+        btc_tx_free(tx);
+        tx = btc_tx_new();
+        ok = btc_tx_deserialize(tx_data, len, tx);
+        assert(!ok);
+        ok = btc_tx_view_parse(&view, tx_data, len, NULL);
+        assert(!ok);
+        skipped = btc_tx_skip(tx_data, len);
+        assert(skipped == 0);
+    }
+    btc_tx_free(tx);
+
+    /* no inputs and a zero flag byte is a legacy transaction without outputs */
+    const char *empty_hex = "010000000000ffffffff";
+    utils_hex_to_bin(empty_hex, bad, strlen(empty_hex), &outlen);
+    tx = btc_tx_new();
+    ok = btc_tx_deserialize(bad, outlen, tx);
+    assert(ok);
+    assert(tx->vin->len == 0 && tx->vout->len == 0 && tx->locktime == 0xffffffff);
+    btc_tx_free(tx);
+
+    /* marker and flag with only empty stacks */
+    const char *superfluous_hex = "0100000000010100000000000000000000000000000000000000000000000000000000000000000000000000ffffffff000000000000";
+    utils_hex_to_bin(superfluous_hex, bad, strlen(superfluous_hex), &outlen);
+    tx = btc_tx_new();
+    ok = btc_tx_deserialize(bad, outlen, tx);
+    assert(!ok);
+    btc_tx_free(tx);
+    ok = btc_tx_view_parse(&view, bad, outlen, NULL);
+    assert(!ok);
+    skipped = btc_tx_skip(bad, outlen);
+    assert(skipped == 0);
+    arena = btc_arena_new(0);
+    tx_arena = btc_tx_deserialize_arena(bad, outlen, arena, NULL);
+    assert(!tx_arena);
+    btc_arena_free(arena);
+
+    /* a single empty witness item is a witness */
+    const char *empty_item_hex = "0100000000010100000000000000000000000000000000000000000000000000000000000000000000000000ffffffff00010000000000";
+    utils_hex_to_bin(empty_item_hex, bad, strlen(empty_item_hex), &outlen);
+    tx = btc_tx_new();
+    ok = btc_tx_deserialize(bad, outlen, tx);
+    assert(ok);
+    assert(btc_tx_has_witness(tx));
+    str = cstr_new_sz(0);
+    btc_tx_serialize(str, tx);
+    assert(str->len == (size_t)outlen && memcmp(str->str, bad, outlen) == 0);
+    cstr_free(str, true);
+    btc_tx_free(tx);
+
+    /* legacy transactions: txid and wtxid are the hash of the serialization */
+    for (i = 0; i < (sizeof(txvalid) / sizeof(txvalid[0])); i++)
+    {
+        uint8_t legacy_data[sizeof(txvalid[i].hextx) / 2];
+        utils_hex_to_bin(txvalid[i].hextx, legacy_data, strlen(txvalid[i].hextx), &outlen);
+        tx = btc_tx_new();
+        ok = btc_tx_deserialize(legacy_data, outlen, tx);
+        assert(ok);
+        assert(!btc_tx_has_witness(tx));
+        tx_double_sha256(legacy_data, outlen, hash_check);
+        btc_tx_hash(tx, hash);
+        assert(memcmp(hash, hash_check, 32) == 0);
+        btc_tx_witness_hash(tx, hash);
+        assert(memcmp(hash, hash_check, 32) == 0);
+        btc_tx_free(tx);
+    }
+}
+
+void test_tx_hash_cache()
+{
+    bool ok;
+    uint8_t tx_data[sizeof(fixture_tx_p2wpkh_hex) / 2];
+    uint8_t txid[32], wtxid[32], hash[32], hash_check[32];
+    int outlen;
+
+    utils_hex_to_bin(fixture_tx_p2wpkh_hex, tx_data, strlen(fixture_tx_p2wpkh_hex), &outlen);
+    btc_tx *tx = btc_tx_new();
+    ok = btc_tx_deserialize(tx_data, outlen, tx);
+    assert(ok);
+    btc_tx_hash(tx, txid);
+    btc_tx_witness_hash(tx, wtxid);
+    tx_double_sha256(tx_data, outlen, hash_check);
+    assert(memcmp(wtxid, hash_check, 32) == 0);
+    assert(memcmp(txid, wtxid, 32) != 0);
+
+    /* copies take the memoised hashes along */
+    btc_tx *tx_copy = btc_tx_new();
+    btc_tx_copy(tx_copy, tx);
+    btc_tx_hash(tx_copy, hash);
+    assert(memcmp(hash, txid, 32) == 0);
+    btc_tx_witness_hash(tx_copy, hash);
+    assert(memcmp(hash, wtxid, 32) == 0);
+
+    /* direct changes need an invalidation, the compute functions always hash */
+    tx_copy->locktime++;
+    btc_tx_hash(tx_copy, hash);
+    assert(memcmp(hash, txid, 32) == 0);
+    btc_tx_hash_compute(tx_copy, hash_check);
+    assert(memcmp(hash_check, txid, 32) != 0);
+    btc_tx_hash_invalidate(tx_copy);
+    btc_tx_hash(tx_copy, hash);
+    assert(memcmp(hash, hash_check, 32) == 0);
+    cstring *str = cstr_new_sz(0);
+    btc_tx_serialize(str, tx_copy);
+    tx_double_sha256((const uint8_t *)str->str, str->len, hash_check);
+    btc_tx_witness_hash(tx_copy, hash);
+    assert(memcmp(hash, hash_check, 32) == 0);
+    btc_tx_witness_hash_compute(tx_copy, hash);
+    assert(memcmp(hash, hash_check, 32) == 0);
+    cstr_free(str, true);
+    btc_tx_free(tx_copy);
+
+    /* deserializing over a hashed tx drops its hashes */
+    uint8_t legacy_data[sizeof(txvalid[0].hextx) / 2];
+    utils_hex_to_bin(txvalid[0].hextx, legacy_data, strlen(txvalid[0].hextx), &outlen);
+    btc_tx_free(tx);
+    tx = btc_tx_new();
+    btc_tx_hash(tx, hash);
+    ok = btc_tx_deserialize(legacy_data, outlen, tx);
+    assert(ok);
+    btc_tx_hash(tx, hash);
+    tx_double_sha256(legacy_data, outlen, hash_check);
+    assert(memcmp(hash, hash_check, 32) == 0);
+    btc_tx_witness_hash(tx, hash);
+    assert(memcmp(hash, hash_check, 32) == 0);
+    btc_tx_free(tx);
+
+    /* arena transactions start without hashes */
+    btc_arena *arena = btc_arena_new(0);
+    btc_tx *tx_arena = btc_tx_deserialize_arena(legacy_data, outlen, arena, NULL);
+    memset(tx_arena->txid, 0xab, 32);
+    btc_tx_hash(tx_arena, hash);
+    assert(memcmp(hash, hash_check, 32) == 0);
+    btc_arena_free(arena);
+}
+
+void test_tx_deserialize_arena()
+{
+    bool ok;
+    btc_arena *arena = btc_arena_new(512);
+    unsigned int i;
+    for (i = 0; i < (sizeof(txvalid) / sizeof(txvalid[0])); i++)
+    {
+        const struct txtest *one_test = &txvalid[i];
+        uint8_t tx_data[sizeof(one_test->hextx)/2 + 1];
+        int outlen;
+        size_t consumed = 0, k;
+        utils_hex_to_bin(one_test->hextx, tx_data, strlen(one_test->hextx), &outlen);
+
+        /* trailing data is not consumed */
+        tx_data[outlen] = 0xab;
+        btc_tx *tx = btc_tx_deserialize_arena(tx_data, outlen + 1, arena, &consumed);
+        assert(tx);
+        assert(consumed == (size_t)outlen);
+        assert(tx->vin->len == (size_t)one_test->num_ins);
+
+        /* equal to the heap parse, serializes back to the input */
+        btc_tx *tx_heap = btc_tx_new();
+        ok = btc_tx_deserialize(tx_data, outlen, tx_heap);
+        assert(ok);
+        cstring *str = cstr_new_sz(outlen);
+        cstring *str2 = cstr_new_sz(outlen);
+        btc_tx_serialize(str, tx);
+        btc_tx_serialize(str2, tx_heap);
+        assert(str->len == (size_t)outlen);
+        assert(memcmp(str->str, tx_data, outlen) == 0);
+        assert(memcmp(str->str, str2->str, str->len) == 0);
+        cstr_free(str, true);
+        cstr_free(str2, true);
+
+        /* a heap copy of an arena tx outlives the arena */
+        btc_tx *tx_copy = btc_tx_new();
+        btc_tx_copy(tx_copy, tx);
+        btc_arena_reset(arena);
+        str = cstr_new_sz(outlen);
+        btc_tx_serialize(str, tx_copy);
+        assert(memcmp(str->str, tx_data, outlen) == 0);
+        cstr_free(str, true);
+        btc_tx_free(tx_copy);
+
+        /* every truncation fails */
+        for (k = 0; k < (size_t)outlen; k++) {
+            tx = btc_tx_deserialize_arena(tx_data, k, arena, NULL);
+            assert(tx == NULL);
+        }
+        btc_arena_reset(arena);
+
+        /* as does the heap parse (without leaking or keeping freed inputs) */
+        btc_tx_free(tx_heap);
+        tx_heap = btc_tx_new();
+        ok = btc_tx_deserialize(tx_data, outlen / 2, tx_heap);
+        assert(!ok);
+        btc_tx_free(tx_heap);
+    }
+
+    /* input counts larger than the remaining data are refused before allocating */
+    uint8_t bogus[] = {0x01, 0x00, 0x00, 0x00, 0xfe, 0xff, 0xff, 0xff, 0x0f, 0x00};
+    btc_tx *tx_bogus = btc_tx_deserialize_arena(bogus, sizeof(bogus), arena, NULL);
+    assert(tx_bogus == NULL);
+    assert(btc_arena_used(arena) < 1024);
+    btc_arena_free(arena);
+}
+
+void test_tx_view()
+{
+    bool ok;
+    btc_arena *arena = btc_arena_new(0);
+    unsigned int i;
+    for (i = 0; i < (sizeof(txvalid) / sizeof(txvalid[0])); i++)
+    {
+        const struct txtest *one_test = &txvalid[i];
+        uint8_t tx_data[sizeof(one_test->hextx)/2 + 1];
+        int outlen;
+        size_t k, len;
+        btc_tx_view view;
+        utils_hex_to_bin(one_test->hextx, tx_data, strlen(one_test->hextx), &outlen);
+        tx_data[outlen] = 0xab;
+
+        btc_tx *tx = btc_tx_new();
+        ok = btc_tx_deserialize(tx_data, outlen, tx);
+        assert(ok);
+
+        /* heap and arena item tables, with a trailing byte */
+        int pass;
+        for (pass = 0; pass < 2; pass++) {
+            ok = btc_tx_view_parse(&view, tx_data, outlen + 1, pass ? arena : NULL);
+            assert(ok);
+            assert(view.size == (size_t)outlen);
+            assert(view.version == tx->version);
+            assert(view.locktime == tx->locktime);
+            assert(view.vin_count == tx->vin->len);
+            assert(view.vout_count == tx->vout->len);
+            for (k = 0; k < view.vin_count; k++) {
+                btc_tx_in *tx_in = vector_idx(tx->vin, k);
+                const uint8_t *script = btc_tx_view_script_sig(&view, k, &len);
+                assert(memcmp(btc_tx_view_prevout_hash(&view, k), tx_in->prevout.hash, 32) == 0);
+                assert(btc_tx_view_prevout_n(&view, k) == tx_in->prevout.n);
+                assert(btc_tx_view_sequence(&view, k) == tx_in->sequence);
+                assert(len == tx_in->script_sig->len);
+                assert(memcmp(script, tx_in->script_sig->str, len) == 0);
+                /* zero-copy: the script points into the input */
+                assert(script > tx_data && script + len <= tx_data + outlen);
+            }
+            for (k = 0; k < view.vout_count; k++) {
+                btc_tx_out *tx_out = vector_idx(tx->vout, k);
+                const uint8_t *script = btc_tx_view_script_pubkey(&view, k, &len);
+                assert(btc_tx_view_value(&view, k) == tx_out->value);
+                assert(len == tx_out->script_pubkey->len);
+                assert(memcmp(script, tx_out->script_pubkey->str, len) == 0);
+            }
+            btc_tx_view_free(&view);
+        }
+        btc_arena_reset(arena);
+        len = btc_tx_skip(tx_data, outlen + 1);
+        assert(len == (size_t)outlen);
+
+        /* every truncation fails */
+        for (k = 0; k < (size_t)outlen; k++) {
+            ok = btc_tx_view_parse(&view, tx_data, k, NULL);
+            assert(!ok);
+            len = btc_tx_skip(tx_data, k);
+            assert(len == 0);
+        }
+        btc_tx_free(tx);
+    }
+    btc_arena_free(arena);
+
+    /* compact size script lengths near 2^64 must not wrap the bounds checks */
+    {
+        static const uint8_t huge_len[2][9] = {
+            {0xff, 0xfc, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff},
+            {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff},
+        };
+        uint8_t bad[64];
+        btc_tx_view view;
+        size_t skipped;
+        for (i = 0; i < 2; i++) {
+            /* the script_sig of the only input (followed by 4 sequence bytes) */
+            memset(bad, 0, sizeof(bad));
+            bad[0] = 1;
+            bad[4] = 1;
+            memcpy(bad + 41, huge_len[i], 9);
+            ok = btc_tx_view_parse(&view, bad, 55, NULL);
+            assert(!ok);
+            skipped = btc_tx_skip(bad, 55);
+            assert(skipped == 0);
+
+            /* the script_pubkey of the only output, after an input with an empty script_sig */
+            memset(bad, 0, sizeof(bad));
+            bad[0] = 1;
+            bad[4] = 1;
+            bad[46] = 1;
+            memcpy(bad + 55, huge_len[i], 9);
+            ok = btc_tx_view_parse(&view, bad, sizeof(bad), NULL);
+            assert(!ok);
+            skipped = btc_tx_skip(bad, sizeof(bad));
+            assert(skipped == 0);
+        }
+    }
+}
+
 void test_tx_sighash()
 {
+    bool ok;
     unsigned int i;
 
     int fails, success;
@@ -777,6 +1259,25 @@ void test_tx_sighash()
         memset(sighash, 0, 32);
         btc_tx_sighash(tx, script, test->inputindex, test->hashtype, sighash);
 
+        /* the per transaction cache gives the same hashes, for every input */
+        btc_tx_sighash_cache *cache = btc_tx_sighash_cache_new(tx);
+        uint8_t sighash_cached[32];
+        unsigned int in_num;
+        memset(sighash_cached, 0, 32);
+        btc_tx_sighash_cached(cache, script, test->inputindex, test->hashtype, sighash_cached);
+        assert(memcmp(sighash, sighash_cached, 32) == 0);
+        for (in_num = 0; in_num < tx->vin->len; in_num++) {
+            uint8_t sighash_all[32];
+            ok = btc_tx_sighash(tx, script, in_num, SIGHASH_ALL, sighash_all);
+            assert(ok);
+            ok = btc_tx_sighash_cached(cache, script, in_num, SIGHASH_ALL, sighash_cached);
+            assert(ok);
+            assert(memcmp(sighash_all, sighash_cached, 32) == 0);
+        }
+        ok = btc_tx_sighash_cached(cache, script, tx->vin->len, SIGHASH_ALL, sighash_cached);
+        assert(!ok);
+        btc_tx_sighash_cache_free(cache);
+
         vector *vec = vector_new(10, btc_script_op_free_cb);
         btc_script_get_ops(script, vec);
         enum btc_tx_out_type type = btc_script_classify(vec);
@@ -806,6 +1307,87 @@ const struct script_test script_tests[] =
     {"0x4e03000000ffff"}
 };
 
+struct sighash_v0_test
+{
+    const char *txhex;
+    const char *script_code;
+    int inputindex;
+    int hashtype;
+    int64_t amount;
+    const char *hashhex;
+};
+
+/* BIP143 examples: native P2WPKH, P2SH-P2WPKH and P2SH-P2WSH with all hash types */
+static const struct sighash_v0_test sighash_v0_tests[] =
+{
+    {"0100000002fff7f7881a8099afa6940d42d1e7f6362bec38171ea3edf433541db4e4ad969f0000000000eeffffffef51e1b804cc89d182d279655c3aa89e815b1b309fe287d9b2b55d57b90ec68a0100000000ffffffff02202cb206000000001976a9148280b37df378db99f66f85c95a783a76ac7a6d5988ac9093510d000000001976a9143bde42dbee7e4dbe6a21b2d50ce2f0167faa815988ac11000000",
+     "76a9141d0f172a0ecb48aee1be1f2687d2963ae33f71a188ac", 1, SIGHASH_ALL, 600000000,
+     "c37af31116d1b27caf68aae9e3ac82f1477929014d5b917657d0eb49478cb670"},
+    {"0100000001db6b1b20aa0fd7b23880be2ecbd4a98130974cf4748fb66092ac4d3ceb1a54770100000000feffffff02b8b4eb0b000000001976a914a457b684d7f0d539a46a45bbc043f35b59d0d96388ac0008af2f000000001976a914fd270b1ee6abcaea97fea7ad0402e8bd8ad6d77c88ac92040000",
+     "76a91479091972186c449eb1ded22b78e40d009bdf008988ac", 0, SIGHASH_ALL, 1000000000,
+     "64f3b0f4dd2bb3aa1ce8566d220cc74dda9df97d8490cc81d89d735c92e59fb6"},
+    {"010000000136641869ca081e70f394c6948e8af409e18b619df2ed74aa106c1ca29787b96e0100000000ffffffff0200e9a435000000001976a914389ffce9cd9ae88dcc0631e88a821ffdbe9bfe2688acc0832f05000000001976a9147480a33f950689af511e6e84c138dbbd3c3ee41588ac00000000",
+     "56210307b8ae49ac90a048e9b53357a2354b3334e9c8bee813ecb98e99a7e07e8c3ba32103b28f0c28bfab54554ae8c658ac5c3e0ce6e79ad336331f78c428dd43eea8449b21034b8113d703413d57761b8b9781957b8c0ac1dfe69f492580ca4195f50376ba4a21033400f6afecb833092a9a21cfdf1ed1376e58c5d1f47de74683123987e967a8f42103a6d48b1131e94ba04d9737d61acdaa1322008af9602b3b14862c07a1789aac162102d8b661b0b3302ee2f162b09e07a55ad5dfbe673a9f01d9f0c19617681024306b56ae", 0, SIGHASH_ALL, 987654321,
+     "185c0be5263dce5b4bb50a047973c1b6272bfbd0103a89444597dc40b248ee7c"},
+    {"010000000136641869ca081e70f394c6948e8af409e18b619df2ed74aa106c1ca29787b96e0100000000ffffffff0200e9a435000000001976a914389ffce9cd9ae88dcc0631e88a821ffdbe9bfe2688acc0832f05000000001976a9147480a33f950689af511e6e84c138dbbd3c3ee41588ac00000000",
+     "56210307b8ae49ac90a048e9b53357a2354b3334e9c8bee813ecb98e99a7e07e8c3ba32103b28f0c28bfab54554ae8c658ac5c3e0ce6e79ad336331f78c428dd43eea8449b21034b8113d703413d57761b8b9781957b8c0ac1dfe69f492580ca4195f50376ba4a21033400f6afecb833092a9a21cfdf1ed1376e58c5d1f47de74683123987e967a8f42103a6d48b1131e94ba04d9737d61acdaa1322008af9602b3b14862c07a1789aac162102d8b661b0b3302ee2f162b09e07a55ad5dfbe673a9f01d9f0c19617681024306b56ae", 0, SIGHASH_NONE, 987654321,
+     "e9733bc60ea13c95c6527066bb975a2ff29a925e80aa14c213f686cbae5d2f36"},
+    {"010000000136641869ca081e70f394c6948e8af409e18b619df2ed74aa106c1ca29787b96e0100000000ffffffff0200e9a435000000001976a914389ffce9cd9ae88dcc0631e88a821ffdbe9bfe2688acc0832f05000000001976a9147480a33f950689af511e6e84c138dbbd3c3ee41588ac00000000",
+     "56210307b8ae49ac90a048e9b53357a2354b3334e9c8bee813ecb98e99a7e07e8c3ba32103b28f0c28bfab54554ae8c658ac5c3e0ce6e79ad336331f78c428dd43eea8449b21034b8113d703413d57761b8b9781957b8c0ac1dfe69f492580ca4195f50376ba4a21033400f6afecb833092a9a21cfdf1ed1376e58c5d1f47de74683123987e967a8f42103a6d48b1131e94ba04d9737d61acdaa1322008af9602b3b14862c07a1789aac162102d8b661b0b3302ee2f162b09e07a55ad5dfbe673a9f01d9f0c19617681024306b56ae", 0, SIGHASH_SINGLE, 987654321,
+     "1e1f1c303dc025bd664acb72e583e933fae4cff9148bf78c157d1e8f78530aea"},
+    {"010000000136641869ca081e70f394c6948e8af409e18b619df2ed74aa106c1ca29787b96e0100000000ffffffff0200e9a435000000001976a914389ffce9cd9ae88dcc0631e88a821ffdbe9bfe2688acc0832f05000000001976a9147480a33f950689af511e6e84c138dbbd3c3ee41588ac00000000",
+     "56210307b8ae49ac90a048e9b53357a2354b3334e9c8bee813ecb98e99a7e07e8c3ba32103b28f0c28bfab54554ae8c658ac5c3e0ce6e79ad336331f78c428dd43eea8449b21034b8113d703413d57761b8b9781957b8c0ac1dfe69f492580ca4195f50376ba4a21033400f6afecb833092a9a21cfdf1ed1376e58c5d1f47de74683123987e967a8f42103a6d48b1131e94ba04d9737d61acdaa1322008af9602b3b14862c07a1789aac162102d8b661b0b3302ee2f162b09e07a55ad5dfbe673a9f01d9f0c19617681024306b56ae", 0, SIGHASH_ALL | SIGHASH_ANYONECANPAY, 987654321,
+     "2a67f03e63a6a422125878b40b82da593be8d4efaafe88ee528af6e5a9955c6e"},
+    {"010000000136641869ca081e70f394c6948e8af409e18b619df2ed74aa106c1ca29787b96e0100000000ffffffff0200e9a435000000001976a914389ffce9cd9ae88dcc0631e88a821ffdbe9bfe2688acc0832f05000000001976a9147480a33f950689af511e6e84c138dbbd3c3ee41588ac00000000",
+     "56210307b8ae49ac90a048e9b53357a2354b3334e9c8bee813ecb98e99a7e07e8c3ba32103b28f0c28bfab54554ae8c658ac5c3e0ce6e79ad336331f78c428dd43eea8449b21034b8113d703413d57761b8b9781957b8c0ac1dfe69f492580ca4195f50376ba4a21033400f6afecb833092a9a21cfdf1ed1376e58c5d1f47de74683123987e967a8f42103a6d48b1131e94ba04d9737d61acdaa1322008af9602b3b14862c07a1789aac162102d8b661b0b3302ee2f162b09e07a55ad5dfbe673a9f01d9f0c19617681024306b56ae", 0, SIGHASH_NONE | SIGHASH_ANYONECANPAY, 987654321,
+     "781ba15f3779d5542ce8ecb5c18716733a5ee42a6f51488ec96154934e2c890a"},
+    {"010000000136641869ca081e70f394c6948e8af409e18b619df2ed74aa106c1ca29787b96e0100000000ffffffff0200e9a435000000001976a914389ffce9cd9ae88dcc0631e88a821ffdbe9bfe2688acc0832f05000000001976a9147480a33f950689af511e6e84c138dbbd3c3ee41588ac00000000",
+     "56210307b8ae49ac90a048e9b53357a2354b3334e9c8bee813ecb98e99a7e07e8c3ba32103b28f0c28bfab54554ae8c658ac5c3e0ce6e79ad336331f78c428dd43eea8449b21034b8113d703413d57761b8b9781957b8c0ac1dfe69f492580ca4195f50376ba4a21033400f6afecb833092a9a21cfdf1ed1376e58c5d1f47de74683123987e967a8f42103a6d48b1131e94ba04d9737d61acdaa1322008af9602b3b14862c07a1789aac162102d8b661b0b3302ee2f162b09e07a55ad5dfbe673a9f01d9f0c19617681024306b56ae", 0, SIGHASH_SINGLE | SIGHASH_ANYONECANPAY, 987654321,
+     "511e8e52ed574121fc1b654970395502128263f62662e076dc6baf05c2e6a99b"},
+};
+
+void test_tx_sighash_witness_v0()
+{
+    bool ok;
+    unsigned int i;
+    for (i = 0; i < (sizeof(sighash_v0_tests) / sizeof(sighash_v0_tests[0])); i++)
+    {
+        const struct sighash_v0_test *test = &sighash_v0_tests[i];
+        uint8_t tx_data[512];
+        uint8_t script_data[512];
+        int outlen;
+        utils_hex_to_bin(test->txhex, tx_data, strlen(test->txhex), &outlen);
+
+        btc_tx *tx = btc_tx_new();
+        ok = btc_tx_deserialize(tx_data, outlen, tx);
+        assert(ok);
+        utils_hex_to_bin(test->script_code, script_data, strlen(test->script_code), &outlen);
+        cstring *script = cstr_new_buf(script_data, outlen);
+
+        uint8_t sighash[32];
+        char hexbuf[65];
+        ok = btc_tx_sighash_witness_v0(tx, script, test->inputindex, test->hashtype, test->amount, sighash);
+        assert(ok);
+        utils_bin_to_hex(sighash, 32, hexbuf);
+        assert(strcmp(hexbuf, test->hashhex) == 0);
+
+        btc_tx_sighash_cache *cache = btc_tx_sighash_cache_new(tx);
+        memset(sighash, 0, 32);
+        ok = btc_tx_sighash_witness_v0_cached(cache, script, test->inputindex, test->hashtype, test->amount, sighash);
+        assert(ok);
+        utils_bin_to_hex(sighash, 32, hexbuf);
+        assert(strcmp(hexbuf, test->hashhex) == 0);
+        ok = btc_tx_sighash_witness_v0_cached(cache, script, tx->vin->len, test->hashtype, test->amount, sighash);
+        assert(!ok);
+        ok = btc_tx_sighash_witness_v0(tx, script, tx->vin->len, test->hashtype, test->amount, sighash);
+        assert(!ok);
+        btc_tx_sighash_cache_free(cache);
+
+        cstr_free(script, true);
+        btc_tx_free(tx);
+    }
+}
+
 void test_script_parse()
 {
     unsigned int i;
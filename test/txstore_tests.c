@@ -0,0 +1,126 @@
+/**********************************************************************
+ * Copyright (c) 2015 Jonas Schnelli                                  *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <btc/txstore.h>
+
+#include "fixtures.h"
+#include "utils.h"
+
+/* copies of the pair of transactions, more than the first capacity of every column */
+#define TXSTORE_TEST_PAIRS 20
+
+void test_txstore()
+{
+    bool ok;
+    size_t res;
+    uint8_t data[TXSTORE_TEST_PAIRS * (FIXTURE_TX_P2WPKH_SIZE + FIXTURE_COINBASE_GENESIS_SIZE)];
+    size_t tx_len[2], len = 0, i, t, in_num = 0, out_num = 0;
+    btc_txstore store;
+    int outlen;
+
+    /* a witness (2 inputs, 2 outputs) and a legacy transaction (1 input, 1 output) */
+    const char *hex[2] = { fixture_tx_p2wpkh_hex, fixture_coinbase_genesis_hex };
+    for (t = 0; t < 2; t++) {
+        utils_hex_to_bin(hex[t], data + len, strlen(hex[t]), &outlen);
+        tx_len[t] = outlen;
+        len += outlen;
+    }
+    for (i = 1; i < TXSTORE_TEST_PAIRS; i++)
+        memcpy(data + i * len, data, len);
+
+    ok = btc_txstore_init(&store);
+    assert(ok);
+    /* one pair, then the rest at once: each column doubles several times */
+    res = btc_txstore_append(&store, data, len, 2);
+    assert(res == len);
+    res = btc_txstore_append(&store, data + len, (TXSTORE_TEST_PAIRS - 1) * len, 2 * (TXSTORE_TEST_PAIRS - 1));
+    assert(res == (TXSTORE_TEST_PAIRS - 1) * len);
+    assert(store.tx_count == 2 * TXSTORE_TEST_PAIRS);
+    assert(store.vin_count == 3 * TXSTORE_TEST_PAIRS && store.vout_count == 3 * TXSTORE_TEST_PAIRS);
+    assert(store.tx_alloc >= store.tx_count && store.vin_alloc >= store.vin_count);
+    assert(store.vout_alloc >= store.vout_count && store.script_alloc >= store.script_start[store.vout_count]);
+    assert(store.script_start[store.vout_count] == TXSTORE_TEST_PAIRS * (25 + 25 + 67));
+
+    /* every column matches the decoded transactions */
+    for (t = 0; t < store.tx_count; t++) {
+        const uint8_t *tx_data = data + (t % 2 ? tx_len[0] : 0);
+        btc_tx *tx = btc_tx_new();
+        uint256 txid;
+        ok = btc_tx_deserialize(tx_data, tx_len[t % 2], tx);
+        assert(ok);
+        btc_tx_hash(tx, txid);
+        assert(memcmp(store.txid[t], txid, sizeof(uint256)) == 0);
+        assert(store.version[t] == tx->version && store.locktime[t] == tx->locktime);
+        assert(store.tx_vin_start[t] == in_num && store.tx_vout_start[t] == out_num);
+
+        for (i = 0; i < tx->vin->len; i++, in_num++) {
+            btc_tx_in *tx_in = vector_idx(tx->vin, i);
+            assert(memcmp(store.prevout_hash[in_num], tx_in->prevout.hash, sizeof(uint256)) == 0);
+            assert(store.prevout_n[in_num] == tx_in->prevout.n);
+            assert(store.sequence[in_num] == tx_in->sequence);
+            assert(btc_txstore_input_tx(&store, in_num) == t);
+        }
+        for (i = 0; i < tx->vout->len; i++, out_num++) {
+            btc_tx_out *tx_out = vector_idx(tx->vout, i);
+            size_t script_len;
+            const uint8_t *script = btc_txstore_script_pubkey(&store, out_num, &script_len);
+            assert(store.value[out_num] == tx_out->value);
+            assert(script_len == tx_out->script_pubkey->len);
+            assert(memcmp(script, tx_out->script_pubkey->str, script_len) == 0);
+            assert(btc_txstore_output_tx(&store, out_num) == t);
+        }
+        btc_tx_free(tx);
+    }
+    assert(store.tx_vin_start[store.tx_count] == in_num);
+    assert(store.tx_vout_start[store.tx_count] == out_num);
+    assert(btc_txstore_script_pubkey(&store, out_num, &i) == NULL);
+
+    /* scans: the 50 BTC coinbase outputs (every third), the first P2PKH script,
+     * the second witness input prevout */
+    for (t = 0, i = btc_txstore_next_value(&store, 5000000000LL, 5000000000LL, 0); i < store.vout_count;
+         t++, i = btc_txstore_next_value(&store, 5000000000LL, 5000000000LL, i + 1))
+        assert(i == 3 * t + 2);
+    assert(t == TXSTORE_TEST_PAIRS);
+    {
+        size_t script_len;
+        const uint8_t *script = btc_txstore_script_pubkey(&store, 0, &script_len);
+        assert(btc_txstore_next_script(&store, script, script_len, 1) == 3);
+        assert(btc_txstore_next_script(&store, script, script_len, 4) == 6);
+        assert(btc_txstore_next_script(&store, script, script_len, store.vout_count - 2) == store.vout_count);
+        assert(btc_txstore_next_script(&store, script, script_len - 1, 0) == store.vout_count);
+    }
+    assert(btc_txstore_next_prevout(&store, store.prevout_hash[1], 1, 0) == 1);
+    assert(btc_txstore_next_prevout(&store, store.prevout_hash[1], 1, 2) == 4);
+    assert(btc_txstore_next_prevout(&store, store.prevout_hash[1], 0, 0) == store.vin_count);
+
+    /* a malformed transaction leaves the store as it was */
+    res = btc_txstore_append(&store, data, len - 1, 2);
+    assert(res == 0);
+    res = btc_txstore_append(&store, data, len, 3);
+    assert(res == 0);
+    assert(store.tx_count == 2 * TXSTORE_TEST_PAIRS);
+    assert(store.vin_count == 3 * TXSTORE_TEST_PAIRS && store.vout_count == 3 * TXSTORE_TEST_PAIRS);
+    res = btc_txstore_append(&store, data + tx_len[0], tx_len[1], 1);
+    assert(res == tx_len[1]);
+    t = 3 * TXSTORE_TEST_PAIRS;
+    assert(store.tx_count == 2 * TXSTORE_TEST_PAIRS + 1 && store.value[t] == 5000000000LL);
+    assert(store.script_start[t + 1] - store.script_start[t] == 67);
+    assert(store.tx_vout_start[store.tx_count] == t + 1);
+
+    btc_txstore_clear(&store);
+    assert(store.tx_count == 0 && store.vout_count == 0);
+    res = btc_txstore_append(&store, data, tx_len[0], 1);
+    assert(res == tx_len[0]);
+    assert(store.vout_count == 2 && store.script_start[2] == 50);
+    btc_txstore_free(&store);
+}
@@ -34,8 +34,11 @@
 
 extern void test_random();
 extern void test_sha_256();
+extern void test_sha_256_many();
+extern void test_sha_256_midstate();
 extern void test_sha_512();
 extern void test_sha_hmac();
+extern void test_ripemd160();
 extern void test_base58check();
 extern void test_bip32();
 extern void test_ecc();
@@ -45,8 +48,19 @@ extern void test_buffer();
 extern void test_utils();
 extern void test_serialize();
 extern void test_tx_serialization();
+extern void test_tx_serialized_size();
 extern void test_tx_sighash();
+extern void test_tx_sighash_witness_v0();
 extern void test_script_parse();
+extern void test_merkle_root();
+extern void test_block_parse();
+extern void test_blockfile();
+extern void test_txstore();
+extern void test_arena();
+extern void test_tx_deserialize_arena();
+extern void test_tx_view();
+extern void test_tx_witness();
+extern void test_tx_hash_cache();
 extern void test_eckey();
 
 
@@ -62,8 +76,11 @@ int main()
 
     test_random();
     test_sha_256();
+    test_sha_256_many();
+    test_sha_256_midstate();
     test_sha_512();
     test_sha_hmac();
+    test_ripemd160();
     test_base58check();
     test_utils();
 
@@ -74,11 +91,22 @@ int main()
     test_buffer();
     test_serialize();
     test_tx_serialization();
+    test_tx_serialized_size();
+    test_arena();
+    test_tx_deserialize_arena();
+    test_tx_view();
+    test_tx_witness();
+    test_tx_hash_cache();
     test_tx_sighash();
+    test_tx_sighash_witness_v0();
     test_script_parse();
+    test_merkle_root();
+    test_block_parse();
+    test_blockfile();
+    test_txstore();
 
     test_eckey();
 
     ecc_stop();
-	return 0;
+	return U_TESTS_FAIL != 0;
 }
@@ -9,8 +9,65 @@
 #include <string.h>
 #include <assert.h>
 
+#include "sha2.h"
 #include "utils.h"
 
+extern void sha2_test_backends(void (*test_fn)(void));
+
+/* hex codec of every length up to 300 bytes (all SIMD block/tail splits) */
+static void test_utils_hex_codec(void)
+{
+    bool ok;
+    static const char digits[] = "0123456789abcdef";
+    uint8_t bin[300], dec[300];
+    char hex[601], ref[601], upper[601];
+    size_t len, i;
+
+    for (i = 0; i < sizeof(bin); i++)
+        bin[i] = (uint8_t)(i * 151 + 17);
+
+    for (len = 0; len <= sizeof(bin); len++) {
+        for (i = 0; i < len; i++) {
+            ref[2 * i] = digits[bin[i] >> 4];
+            ref[2 * i + 1] = digits[bin[i] & 0xf];
+        }
+        ref[2 * len] = '\0';
+        memset(hex, 'x', sizeof(hex));
+        utils_hex_encode(bin, len, hex);
+        assert(strcmp(hex, ref) == 0);
+
+        memset(dec, 0, sizeof(dec));
+        ok = utils_hex_decode(hex, 2 * len, dec);
+        assert(ok);
+        assert(memcmp(dec, bin, len) == 0);
+
+        /* upper case is accepted */
+        for (i = 0; i < 2 * len; i++)
+            upper[i] = (hex[i] >= 'a' && hex[i] <= 'f') ? hex[i] - 'a' + 'A' : hex[i];
+        memset(dec, 0, sizeof(dec));
+        ok = utils_hex_decode(upper, 2 * len, dec);
+        assert(ok);
+        assert(memcmp(dec, bin, len) == 0);
+
+        /* odd lengths and a bad character at any position are rejected */
+        if (len > 0) {
+            ok = utils_hex_decode(hex, 2 * len - 1, dec);
+            assert(!ok);
+            i = (len * 7) % (2 * len);
+            hex[i] = "g/:@G`\x80 "[len % 8];
+            ok = utils_hex_decode(hex, 2 * len, dec);
+            assert(!ok);
+        }
+    }
+
+    /* the old functions keep decoding non hex characters as 0 nibbles */
+    int outlen;
+    utils_hex_to_bin("1g2h00ff", dec, 8, &outlen);
+    assert(outlen == 4);
+    assert(memcmp(dec, "\x10\x20\x00\xff", 4) == 0);
+    assert(memcmp(utils_hex_to_uint8("zz0fAb"), "\x00\x0f\xab", 3) == 0);
+}
+
 void test_utils()
 {
     char hash[] = "28969cdfa74a12c82f3bad960b0b000aca2ac329deea5c2328ebc6f2ba9802c1";
@@ -64,8 +121,19 @@ void test_utils()
     utils_bin_to_hex(data, sizeof(data), hex);
     assert(strcmp(hex, "00ff00aa00ff00aa") == 0);
 
+    char rev[] = "0a1b2c3d4e";
+    utils_reverse_hex(rev, 10);
+    assert(strcmp(rev, "4e3d2c1b0a") == 0);
+    utils_reverse_hex(rev, 8);
+    assert(strcmp(rev, "1b2c3d4e0a") == 0);
+    utils_reverse_hex(rev, 2);
+    assert(strcmp(rev, "1b2c3d4e0a") == 0);
+
     unsigned char data2[sizeof(data)];
     utils_hex_to_bin(hex, data2, strlen(hex), &outlen);
     assert(outlen == 8);
     assert(memcmp(data, data2, outlen) == 0);
+
+    /* the hex codec with the portable/SSE2 code and with each SIMD backend */
+    sha2_test_backends(test_utils_hex_codec);
 }